@@ -0,0 +1,123 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Name Table Microbenchmark */
+
+/* Built once per ZNameTable backend by "make bench":
+ *  bench uses the hash table and bench-sl the skip list.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ztypes.h"
+#include "zerr.h"
+#include "zgc.h"
+
+#include "zatom.h"
+#include "znametable.h"
+
+/* Names in the big table, as in a crowded global namespace. */
+#define NNAMES   20000
+/* Lookups per name in the big table. */
+#define NROUNDS  50
+/* Small tables, as used by node() records. */
+#define NRECORDS 100000
+#define NFIELDS  4
+
+#ifdef ZSKIPLIST
+#define BACKEND "skip list"
+#else
+#define BACKEND "hash table"
+#endif
+
+static ZAtom *atoms[NNAMES];
+static ZNameTable *records[NRECORDS];
+
+static double
+elapsed(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void
+check(ZError err)
+{
+    if (err != ZE_OK)
+        exit(zraiseerr(err));
+}
+
+int
+main(void)
+{
+    ZNameTable *znable;
+    Zob *value;
+    char name[32];
+    clock_t start;
+    unsigned long sum = 0;
+    int i, j;
+
+    for (i = 0; i < NNAMES; i++) {
+        snprintf(name, sizeof(name), "name%d", i);
+        check(zintern(name, &atoms[i]));
+    }
+    printf("backend: %s\n", BACKEND);
+
+    check(znewnable(&znable));
+    start = clock();
+    for (i = 0; i < NNAMES; i++)
+        check(ztsetatom(znable, atoms[i], ZIMM(T_INT, i)));
+    printf("insert %6d names:        %.3fs\n", NNAMES, elapsed(start));
+
+    start = clock();
+    for (j = 0; j < NROUNDS; j++)
+        for (i = 0; i < NNAMES; i++)
+            if (ztgetatom(znable, atoms[(i * 7919) % NNAMES], &value))
+                sum += ZIMMVALUE(value);
+    printf("lookup %6d names x %3d:  %.3fs\n", NNAMES, NROUNDS,
+           elapsed(start));
+
+    start = clock();
+    for (i = 0; i < NNAMES; i += 2)
+        ztremoveatom(znable, atoms[i]);
+    for (i = 0; i < NNAMES; i += 2)
+        check(ztsetatom(znable, atoms[i], ZIMM(T_INT, i)));
+    printf("remove/reinsert half:        %.3fs\n", elapsed(start));
+    zdelnable(&znable);
+
+    start = clock();
+    for (i = 0; i < NRECORDS; i++) {
+        check(znewnable(&records[i]));
+        for (j = 0; j < NFIELDS; j++)
+            check(ztsetatom(records[i], atoms[j], ZIMM(T_INT, j)));
+    }
+    for (i = 0; i < NRECORDS; i++)
+        for (j = 0; j < NFIELDS; j++)
+            if (ztgetatom(records[i], atoms[j], &value))
+                sum += ZIMMVALUE(value);
+    for (i = 0; i < NRECORDS; i++)
+        zdelnable(&records[i]);
+    printf("%d records of %d fields:  %.3fs\n", NRECORDS, NFIELDS,
+           elapsed(start));
+
+    /* Keep the lookups from being optimized away. */
+    printf("checksum: %lu\n", sum);
+    zdelatoms();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Allocators (header) */
+
+/* Every block of runtime memory comes from the current allocator.
+ * The system allocator, current at startup, forwards to malloc().
+ * Atoms are shared by every context and always come from the system
+ *  allocator.
+ */
+typedef struct ZAllocator {
+    /* Return a block of at least 'size' bytes, or NULL. */
+    void *(*alloc)(struct ZAllocator *za, size_t size);
+    /* Return 'ptr' moved to a block of 'size' bytes, or NULL,
+     *  leaving 'ptr' untouched.
+     */
+    void *(*resize)(struct ZAllocator *za, void *ptr, size_t size);
+    void (*release)(struct ZAllocator *za, void *ptr);
+    /* If nonzero, zalloc() passes every object through instead of
+     *  carving it out of a slab, so that each one is seen.
+     */
+    int noslab;
+    /* Slab free lists of zalloc(), kept by zslab.c. */
+    void *slabs;
+    /* Containers tracked by the cycle collector, kept by zgc.c. */
+    void *gc;
+} ZAllocator;
+
+/* Chunks are taken from the system allocator and only given back
+ *  all at once, by zdelarena().
+ */
+typedef struct ZChunk {
+    struct ZChunk *next;
+    size_t size;
+} ZChunk;
+
+typedef struct {
+    ZAllocator base;
+    ZChunk *chunks;
+    char *cursor;
+    char *end;
+    /* Last block handed out, given back if released right away. */
+    char *last;
+} ZArena;
+
+typedef struct {
+    ZAllocator base;
+    /* Where the blocks come from. */
+    ZAllocator *parent;
+    unsigned long allocs;
+    unsigned long frees;
+    size_t total;
+    size_t live;
+    size_t peak;
+} ZCounter;
+
+ZAllocator *zsysalloc();
+ZAllocator *zgetallocator();
+void zsetallocator(ZAllocator *za);
+ZError znewarena(ZAllocator **za);
+void zdelarena(ZAllocator **za);
+ZError znewcounter(ZAllocator *parent, ZAllocator **za);
+void zdelcounter(ZAllocator **za);
+void zcounterstats(ZAllocator *za);
+void *zmalloc(size_t size);
+void *zcalloc(size_t count, size_t size);
+void *zrealloc(void *ptr, size_t size);
+void zmfree(void *ptr);
@@ -34,12 +34,14 @@
 #include "zbytearray.h"
 #include "zbignum.h"
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
 #include "zdict.h"
 #include "zfunc.h"
 
 #include "zobject.h"
 #include "zruntime.h"
+#include "zvm.h"
 #include "zbuiltin.h"
 
 #include "zcpl_expr.h"
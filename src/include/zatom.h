@@ -0,0 +1,35 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Atom Interner (header) */
+
+/* An atom is the unique copy of a name.
+ * Two names are equal if and only if their atoms are the same.
+ */
+typedef struct ZAtom {
+    char *name;
+    /* Order of creation, used to sort name tables. */
+    unsigned int id;
+    struct ZAtom *next;
+} ZAtom;
+
+ZError zinternn(char *name, size_t length, ZAtom **atom);
+ZError zintern(char *name, ZAtom **atom);
+ZAtom *zfindatomn(char *name, size_t length);
+ZAtom *zfindatom(char *name);
+void zdelatoms();
@@ -20,7 +20,7 @@
 
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
     unsigned int length;
     unsigned int *words;
 } ZBigNum;
@@ -33,10 +33,11 @@ void zdelbnum(ZBigNum **zbignum);
 ZError zcpybnum(ZBigNum *source, ZBigNum **dest);
 int ztstbnum(ZBigNum *zbignum);
 int zcmpbnum(ZBigNum *zbignum, ZBigNum *other);
+unsigned int zhashbnum(ZBigNum *zbignum);
 int zrepbnum(char *buffer, size_t size, ZBigNum *zbignum);
 unsigned int znlength(ZBigNum *zbignum);
-ZError znget(ZBigNum *zbignum, int index, ZByte **value);
-ZError znset(ZBigNum *zbignum, int index, ZByte *zbyte);
+ZError znget(ZBigNum *zbignum, int index, Zob **value);
+ZError znset(ZBigNum *zbignum, int index, Zob *zbyte);
 ZError znrst(ZBigNum *zbignum, int index);
 void znlshift(ZBigNum *zbignum, unsigned int shift);
 void znrshift(ZBigNum *zbignum, unsigned int shift);
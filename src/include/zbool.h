@@ -18,15 +18,10 @@
 
 /* ZBool Type (header) */
 
-typedef struct {
-    Zob type;
-    unsigned char refc;
-    int value;
-} ZBool;
+/* Bools are immediate objects. */
+#define ZBOOL(value)      ZIMM(T_BOOL, (value) != 0)
+#define ZBOOLVALUE(zbool) ZIMMVALUE(zbool)
 
-ZError znewbool(ZBool **zbool);
-void zdelbool(ZBool **zbool);
-ZError zcpybool(ZBool *source, ZBool **dest);
-int ztstbool(ZBool *zbool);
-int zcmpbool(ZBool *zbool, ZBool *other);
-int zrepbool(char *buffer, size_t size, ZBool *zbool);
+int ztstbool(Zob *zbool);
+int zcmpbool(Zob *zbool, Zob *other);
+int zrepbool(char *buffer, size_t size, Zob *zbool);
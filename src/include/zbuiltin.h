@@ -26,4 +26,9 @@ ZError regfunc(ZNameTable *nable,
                ZError (*func)(ZList *args, Zob **ret),
                char *name,
                unsigned char arity);
-ZError zbuild(ZNameTable **builtins);
+ZError regvfunc(ZNameTable *nable,
+                ZError (*vfunc)(Zob **argv, int argc, Zob **ret),
+                char *name,
+                unsigned char arity);
+ZError zbuild(ZContext *zcontext);
+int zisrange(Zob *zob);
@@ -18,15 +18,10 @@
 
 /* ZByte Type (header) */
 
-typedef struct {
-    Zob type;
-    unsigned char refc;
-    unsigned char value;
-} ZByte;
+/* Bytes are immediate objects. */
+#define ZBYTE(value)      ZIMM(T_BYTE, (unsigned char) (value))
+#define ZBYTEVALUE(zbyte) ((unsigned char) ZIMMVALUE(zbyte))
 
-ZError znewbyte(ZByte **zbyte);
-void zdelbyte(ZByte **zbyte);
-ZError zcpybyte(ZByte *source, ZByte **dest);
-int ztstbyte(ZByte *zbyte);
-int zcmpbyte(ZByte *zbyte, ZByte *other);
-int zrepbyte(char *buffer, size_t size, ZByte *zbyte);
+int ztstbyte(Zob *zbyte);
+int zcmpbyte(Zob *zbyte, Zob *other);
+int zrepbyte(char *buffer, size_t size, Zob *zbyte);
@@ -20,7 +20,11 @@
 
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
+    /* Nonzero while 'bytes' belong to a literal of the constant pool:
+     *  they are copied before the first change.
+     */
+    unsigned char shared;
     unsigned int length;
     unsigned char *bytes;
 } ZByteArray;
@@ -29,12 +33,14 @@ ZError znewyarr(ZByteArray **zbytearray, unsigned int length);
 ZError zyarrfromstr(ZByteArray **zbytearray, char *s);
 void zdelyarr(ZByteArray **zbytearray);
 ZError zcpyyarr(ZByteArray *source, ZByteArray **dest);
+ZError zshareyarr(ZByteArray *source, ZByteArray **dest);
 int ztstyarr(ZByteArray *zbytearray);
 int zcmpyarr(ZByteArray *zbytearray, ZByteArray *other);
+unsigned int zhashyarr(ZByteArray *zbytearray);
 int zrepyarr(char *buffer, size_t size, ZByteArray *zbytearray);
 int zrepplain(char *buffer, size_t size, ZByteArray *zbytearray);
 unsigned int zalength(ZByteArray *zbytearray);
-ZError zaget(ZByteArray *zbytearray, int index, ZByte **value);
-ZError zaset(ZByteArray *zbytearray, int index, ZByte *zbyte);
+ZError zaget(ZByteArray *zbytearray, int index, Zob **value);
+ZError zaset(ZByteArray *zbytearray, int index, Zob *zbyte);
 ZError zconcatstr(ZByteArray *zbytearray, char *s);
 ZError zconcat(ZByteArray *zbytearray, ZByteArray *other);
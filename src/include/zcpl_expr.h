@@ -18,6 +18,30 @@
 
 /* Expression Compiler (header) */
 
+/* Frame slots are encoded in 7 bits.
+ * The last value stands for all the names past the others.
+ */
+#define MAXLOCALS 127
+
+/* Local names of a function body, in slot order.
+ * Names past MAXLOCALS are local too, but they are kept by name.
+ */
+typedef struct {
+    char **names;
+    int length;
+    int size;
+    /* Slot of "@", or -1 if not used. */
+    int self;
+    /* Nonzero if the body has a \yield statement. */
+    int yields;
+} CplScope;
+
+CplScope *cpl_newscope();
+void cpl_delscope(CplScope *scope);
+int cpl_findname(CplScope *scope, char *name, unsigned int length);
+int cpl_addname(CplScope *scope, char *name, unsigned int length);
+void cpl_setscope(CplScope *scope);
+unsigned int cpl_name(char *name, unsigned int length, char *bin);
 int is_separator(char c);
 void skip_space(char **str);
 unsigned int write_svlv(int n, signed char vlv[]);
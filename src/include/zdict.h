@@ -18,17 +18,48 @@
 
 /* ZDict Type (header) */
 
+/* A ZDict keeps its pairs in insertion order in a dense array.
+ * An index table, probed linearly, maps key hashes to positions
+ *  in that array.
+ * A copy shares both with its source until one of them is changed.
+ */
+
+/* Smallest non-empty index table. Must be a power of two. */
+#define DMINSIZE 8
+
+/* Index slots that do not hold a position. */
+#define DFREE  -1
+#define DDUMMY -2
+
+/* A removed pair has a NULL key until the array is compacted. */
+typedef struct {
+    Zob *key;
+    Zob *value;
+    unsigned int hash;
+} ZPair;
+
 typedef struct {
     Zob type;
-    unsigned char refc;
-    ZList *zlist;
+    unsigned int refc;
+    ZGCLink link;
+    ZShare *share;
+    /* Number of pairs. */
+    unsigned int length;
+    /* Number of positions in use, removed pairs included. */
+    unsigned int npairs;
+    ZPair *pairs;
+    /* Number of index slots: zero or a power of two. */
+    unsigned int size;
+    int *index;
 } ZDict;
 
 ZError znewdict(ZDict **zdict);
 void zdeldict(ZDict **zdict);
 ZError zcpydict(ZDict *source, ZDict **dest);
+ZError zdown(ZDict *zdict);
 int ztstdict(ZDict *zdict);
 int zcmpdict(ZDict *zdict, ZDict *other);
+unsigned int zhashdict(ZDict *zdict);
 int zrepdict(char *buffer, size_t size, ZDict *zdict);
 unsigned int zdlength(ZDict *zdict);
 ZError zdset(ZDict *zdict, Zob *key, Zob *value);
@@ -36,4 +67,5 @@ int zdget(ZDict *zdict, Zob *key, Zob **value);
 ZError zdupdate(ZDict *zdict, ZDict *other);
 int zdremove(ZDict *zdict, Zob *key);
 void zdempty(ZDict *zdict);
+int zddrain(ZDict *zdict, unsigned int *budget);
 int zdhaskey(ZDict *zdict, Zob *key);
@@ -32,7 +32,11 @@ typedef enum {
     ZE_OPEN_FILE_ERROR,
     ZE_INVALID_ARGUMENT,
     ZE_NOT_A_NODE,
-    ZE_DIVISION_BY_ZERO
+    ZE_DIVISION_BY_ZERO,
+    ZE_BYTECODE_VERSION,
+    ZE_YIELD_WITHOUT_GENERATOR,
+    ZE_GENERATOR_RUNNING,
+    ZE_CALL_TOO_DEEP
 } ZError;
 
 void zraise(char *msg);
@@ -22,19 +22,32 @@ typedef int FImp;
 
 typedef struct {
     FImp high; /* 0 */
-    /* Pointer to C function. */
+    /* Pointer to C function taking its arguments in an array.
+     * If NULL, 'func' is called instead.
+     */
+    ZError (*vfunc)(Zob **argv, int argc, Zob **ret);
+    /* Pointer to C function taking its arguments in a ZList.
+     * This convention is kept for external C functions.
+     */
     ZError (*func)(ZList *args, Zob **ret);
 } ZLowFunc;
 
 typedef struct {
     FImp high; /* 1 */
-    /* Pointer to zap function. */
+    /* Pointer to zap function body. */
     char *func;
+    /* Number of local slots and slot of "@" (-1 if not used). */
+    unsigned int nslots;
+    int self;
+    /* Nonzero if the body yields: a call makes a generator. */
+    int generator;
+    /* Pre-decoded body, if translated by the threaded code engine. */
+    struct ZCode *code;
 } ZHighFunc;
 
 typedef struct {
     Zob type; /* T_FUNC */
-    unsigned char refc;
+    unsigned int refc;
     /* Pointer to ZLowFunc or ZHighFunc. */
     FImp *fimp;
     /* Number of arguments that the function takes. */
@@ -43,6 +56,7 @@ typedef struct {
 
 ZError znewlowfunc(ZLowFunc **zlowfunc);
 void zdellowfunc(ZLowFunc **zlowfunc);
+ZError zcall_low(ZLowFunc *zlowfunc, Zob **argv, int argc, Zob **ret);
 ZError znewhighfunc(ZHighFunc **zhighfunc);
 void zdelhighfunc(ZHighFunc **zhighfunc);
 ZError znewfunc(ZFunc **zfunc, FImp *fimp, unsigned char arity);
@@ -50,4 +64,5 @@ void zdelfunc(ZFunc **zfunc);
 ZError zcpyfunc(ZFunc *source, ZFunc **dest);
 int ztstfunc(ZFunc *zfunc);
 int zcmpfunc(ZFunc *zfunc, ZFunc *other);
+unsigned int zhashfunc(ZFunc *zfunc);
 int zrepfunc(char *buffer, size_t size, ZFunc *zfunc);
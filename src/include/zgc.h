@@ -20,8 +20,93 @@
 
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
 } RefC;
 
+/* Reference count of immortal objects, such as builtins and literal
+ *  constants, which zincrefc() and zdecrefc() leave alone.
+ * Their owner deletes them with zdelobj().
+ */
+#define ZIMMORTAL ((unsigned int) -1)
+
+/* Nonzero if 'object' is not reference counted. */
+#define ZUNCOUNTED(object) (ZIMMEDIATE(object)  ||  \
+                            ((RefC *) (object))->refc == ZIMMORTAL)
+
+/* Reference counting alone never frees a cycle, so containers (lists,
+ *  name tables, dicts and generators) are also tracked by a cycle
+ *  collector.
+ * Each allocator keeps the containers allocated through it.
+ */
+typedef struct ZGCLink {
+    struct ZGCLink *prev;
+    struct ZGCLink *next;
+    /* References from outside the tracked containers, while collecting. */
+    int gcrefs;
+} ZGCLink;
+
+/* Copies of a container share its contents until either is changed.
+ * Contents that are not shared have no ZShare.
+ */
+typedef struct {
+    /* Containers sharing the contents. */
+    unsigned int count;
+    /* Last collection that visited the contents. */
+    unsigned long mark;
+} ZShare;
+
+/* Common head of containers. */
+typedef struct {
+    Zob type;
+    unsigned int refc;
+    ZGCLink link;
+    ZShare *share;
+} ZContainer;
+
+/* Nonzero if 'zob' is a container. */
+#define ZISCONTAINER(zob) (!ZIMMEDIATE(zob)  &&  \
+                           (*(zob) == T_LIST  ||  *(zob) == T_NMTB  ||  \
+                            *(zob) == T_DICT  ||  *(zob) == T_GEN))
+
+/* Nonzero if 'zob' can be changed in place, so that a container sharing
+ *  its contents with copies must own them before giving 'zob' away.
+ * Generators are not copied: they are never given away as copies.
+ */
+#define ZISMUTABLE(zob) (!ZIMMEDIATE(zob)  &&  \
+                         (*(zob) == T_LIST  ||  *(zob) == T_NMTB  ||  \
+                          *(zob) == T_DICT  ||  *(zob) == T_YARR))
+
+/* Containers created before the first automatic collection.
+ * Afterwards, as many as survived the last one, if that is more.
+ */
+#define GCTHRESHOLD 1024
+
+/* Items released by each automatic zdrain(). */
+#define DRAINSTEP 1024
+/* Levels of nested lists and dicts that zsharable() looks into. */
+#define SHAREDEPTH 16
+
+/* Budget for zdrain() to empty the queue of dead containers. */
+#define ZDRAINALL ((unsigned int) -1)
+
+typedef struct {
+    /* Containers being tracked. */
+    unsigned int tracked;
+    /* Collections run and containers freed by them. */
+    unsigned long runs;
+    unsigned long freed;
+} ZGCStats;
+
 void zincrefc(Zob *object);
 void zdecrefc(Zob *object);
+void zdisown(Zob *object);
+ZError ztrack(Zob *container);
+void zuntrack(Zob *container);
+void zdrain(unsigned int budget);
+int zsharable(Zob *container);
+ZError zshare(Zob *source, Zob *dest);
+int zunshare(Zob *container);
+unsigned int zcollect();
+void zautocollect();
+void zgcstats(ZGCStats *stats);
+void zdelgc();
@@ -18,15 +18,23 @@
 
 /* ZInt Type (header) */
 
+/* Ints are immediate objects when their value fits in one.
+ * Only the others are allocated as ZInt.
+ */
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
     int value;
 } ZInt;
 
-ZError znewint(ZInt **zint);
+/* Value of 'zint', immediate or not. */
+#define ZINTVALUE(zint) (ZIMMEDIATE(zint) ? ZIMMVALUE(zint) \
+                                          : ((ZInt *) (zint))->value)
+
+ZError zmkint(Zob **zint, int value);
 void zdelint(ZInt **zint);
-ZError zcpyint(ZInt *source, ZInt **dest);
-int ztstint(ZInt *zint);
-int zcmpint(ZInt *zint, ZInt *other);
-int zrepint(char *buffer, size_t size, ZInt *zint);
+ZError zcpyint(Zob *source, Zob **dest);
+int ztstint(Zob *zint);
+int zcmpint(Zob *zint, Zob *other);
+unsigned int zhashint(Zob *zint);
+int zrepint(char *buffer, size_t size, Zob *zint);
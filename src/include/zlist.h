@@ -18,26 +18,40 @@
 
 /* ZList Type (header) */
 
-typedef struct ZNode {
-    Zob *object;
-    struct ZNode *next;
-} ZNode;
+/* A ZList is a circular buffer of items, so items can be added and
+ *  removed at both ends in constant time.
+ * A copy shares the buffer of its source until one of them is changed,
+ *  or gives away an item that is a container: only then are the items
+ *  copied, containers among them being shared in turn.
+ */
+
+/* Smallest non-empty buffer. Must be a power of two. */
+#define LMINSIZE 4
 
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
+    ZGCLink link;
+    ZShare *share;
     unsigned int length;
-    ZNode *first;
-    ZNode *last;
+    /* Number of slots in 'items': zero or a power of two. */
+    unsigned int size;
+    /* Slot of the first item. */
+    unsigned int head;
+    Zob **items;
 } ZList;
 
-ZError znewnode(Zob *zob, ZNode **znode);
-void zdelnode(ZNode **znode);
+/* The 'index'-th item of 'zlist', with 0 <= 'index' < length. */
+#define ZLITEM(zlist, index) \
+    ((zlist)->items[((zlist)->head + (index)) & ((zlist)->size - 1)])
+
 ZError znewlist(ZList **zlist);
 void zdellist(ZList **zlist);
 ZError zcpylist(ZList *source, ZList **dest);
+ZError zlown(ZList *zlist);
 int ztstlist(ZList *zlist);
 int zcmplist(ZList *zlist, ZList *other);
+unsigned int zhashlist(ZList *zlist);
 int zreplist(char *buffer, size_t size, ZList *zlist);
 unsigned int zllength(ZList *zlist);
 ZError zlpush(ZList *zlist, Zob *zob);
@@ -50,5 +64,6 @@ ZError zlinsert(ZList *zlist, int index, Zob *zob);
 ZError zlextend(ZList *zlist, ZList *other);
 ZError zlremove(ZList *zlist, int index);
 void zlempty(ZList *zlist);
+int zldrain(ZList *zlist, unsigned int *budget);
 int zlhasitem(ZList *zlist, Zob *zob);
 void zlremfirst(ZList *zlist);
@@ -18,6 +18,13 @@
 
 /* ZNameTable Type (header) */
 
+/* Two backends are available. By default, a name table is an
+ *  open-addressing hash table keyed by atom, probed linearly.
+ * Defining ZSKIPLIST at build time selects the original skip list,
+ *  which keeps entries sorted by atom id.
+ */
+#ifdef ZSKIPLIST
+
 /* A skip list with p = 1/b = 1/2 and h = 16, where p is the
  *  probability of a node to be promoted to a higher level
  *  and h is the maximum level of any node, can safely
@@ -26,36 +33,88 @@
 #define SLPROB   0.5
 #define SLHEIGHT 16
 
+/* Entries are sorted by atom id. */
 typedef struct ZEntry {
-    char *name;
+    ZAtom *atom;
     Zob *value;
     struct ZEntry **next;
 } ZEntry;
 
 typedef struct {
     Zob type;
-    unsigned char refc;
+    unsigned int refc;
+    ZGCLink link;
+    ZShare *share;
     int level;
     ZEntry *header;
+    /* Changed whenever an entry is added or removed,
+     *  so pointers to entries can be cached.
+     */
+    unsigned int version;
+    /* State of the generator of entry levels. */
+    unsigned int seed;
+} ZNameTable;
+
+#else
+
+/* Smallest non-empty table. Must be a power of two. */
+#define NTMINSIZE 8
+
+/* A free slot has a NULL atom. A removed entry leaves a tombstone
+ *  behind, so probe sequences passing through it are not cut.
+ */
+typedef struct ZEntry {
+    ZAtom *atom;
+    Zob *value;
+} ZEntry;
+
+typedef struct {
+    Zob type;
+    unsigned int refc;
+    ZGCLink link;
+    ZShare *share;
+    /* Number of slots: zero or a power of two. */
+    unsigned int size;
+    /* Number of entries. */
+    unsigned int count;
+    /* Number of entries and tombstones. */
+    unsigned int used;
+    ZEntry *slots;
+    /* Changed whenever an entry is added or removed,
+     *  so pointers to entries can be cached.
+     */
+    unsigned int version;
 } ZNameTable;
 
+#endif
+
+#ifdef ZSKIPLIST
 /* Internal functions. */
-/* double zrandom(); */
-/* int ztrndlevel(); */
+/* double zrandom(ZNameTable *znable); */
+/* int ztrndlevel(ZNameTable *znable); */
 
-ZError znewentry(int level, char *name, Zob *value, ZEntry **zentry);
+ZError znewentry(int level, ZAtom *atom, Zob *value, ZEntry **zentry);
 void zdelentry(ZEntry **zentry);
+#endif
 ZError znewnable(ZNameTable **znable);
 void zdelnable(ZNameTable **znable);
 ZError zcpynable(ZNameTable *source, ZNameTable **dest);
 int ztstnable(ZNameTable *znable);
 int zcmpnable(ZNameTable *znable, ZNameTable *other);
+unsigned int zhashnable(ZNameTable *znable);
 int zrepnable(char *buffer, size_t size, ZNameTable *znable);
 void zrepnable_detail(ZNameTable *znable);
+ZEntry *ztfirst(ZNameTable *znable);
+ZEntry *ztnext(ZNameTable *znable, ZEntry *zentry);
 unsigned int ztlength(ZNameTable *znable);
+ZError ztsetatom(ZNameTable *znable, ZAtom *atom, Zob *value);
 ZError ztset(ZNameTable *znable, char *name, Zob *value);
+ZEntry *ztfindatom(ZNameTable *znable, ZAtom *atom);
+int ztgetatom(ZNameTable *znable, ZAtom *atom, Zob **value);
 int ztget(ZNameTable *znable, char *name, Zob **value);
 ZError ztupdate(ZNameTable *znable, ZNameTable *other);
+int ztremoveatom(ZNameTable *znable, ZAtom *atom);
 int ztremove(ZNameTable *znable, char *name);
 void ztempty(ZNameTable *znable);
+int ztdrain(ZNameTable *znable, unsigned int *budget);
 int zthasname(ZNameTable *znable, char *name);
@@ -18,14 +18,9 @@
 
 /* ZNone Type (header) */
 
-typedef struct {
-    Zob type;
-    unsigned char refc;
-} ZNone;
+/* NONE is an immediate object. */
+#define ZNONE ZIMM(T_NONE, 0)
 
-ZError znewnone(ZNone **znone);
-void zdelnone(ZNone **znone);
-ZError zcpynone(ZNone *source, ZNone **dest);
-int ztstnone(ZNone *znone);
-int zcmpnone(ZNone *znone, ZNone *other);
-int zrepnone(char *buffer, size_t size, ZNone *znone);
+int ztstnone(Zob *znone);
+int zcmpnone(Zob *znone, Zob *other);
+int zrepnone(char *buffer, size_t size, Zob *znone);
@@ -18,23 +18,49 @@
 
 /* Runtime (header) */
 
+/* Bytecode Header */
+#define ZBC_MAGIC   "ZBC"
+#define ZBC_VERSION (char) 0x06
+#define ZBC_HEADER  4
+
 /* Bytecode Tokens */
 #define CALLSTART   (char) 0xF0
 #define CALLEND     (char) 0xF1
 #define BLOCKEXIT   (char) 0xBE
 #define DELETE      (char) 0xDE
+#define YIELD       (char) 0xEE
 #define BLOCK       (char) 0xB0
 #define IF          (char) 0x01
 #define ELIF        (char) 0x02
 #define ELSE        (char) 0x03
 #define WHILE       (char) 0x04
 #define DEF         (char) 0x05
+#define FOR         (char) 0x06
+#define GEN         (char) 0x07
 #define END         (char) 0x01
 #define BREAK       (char) 0x02
 #define CONTINUE    (char) 0x03
 #define RETURN      (char) 0x04
 #define ASGNOPEN    (char) 0x10
 #define ASGNCLOSE   (char) 0x01
+#define LOCAL       (char) 0xC0
+
+/* Frame slot of a name that starts with LOCAL. */
+#define SLOT(name)  ((unsigned int) ((unsigned char) (name)[1] & 0x7F))
+#define NOSELF      (char) 0xFF
+/* Slot of the local names that did not fit in the frame slots.
+ * They are kept by name, in the frame.
+ */
+#define SPILL       0x7F
+/* Value bound to the first component of a name that starts with LOCAL,
+ *  or NULL if it is not bound yet.
+ */
+#define LOCALHEAD(frame, name)                                  \
+    (SLOT(name) == SPILL ? zgetspilled((frame), (name) + 2) :   \
+                           (frame)->slots[SLOT(name)])
+
+/* Number of values that hold the state of a \for loop. */
+#define FORSTATE    3
 
 /* Block Exit Flags */
 #define BE_END      (char) 0x80
@@ -42,17 +68,163 @@
 #define BE_CONTINUE (char) 0x20
 #define BE_RETURN   (char) 0x10
 
+typedef struct ZFrame {
+    /* Local names of a zap function, resolved to slots by the compiler.
+     * A NULL slot is not bound yet.
+     */
+    Zob **slots;
+    unsigned int nslots;
+    /* Slots allocated: 'nslots' rounded up to FRAMESTEP.
+     * Those past 'nslots' are always NULL.
+     */
+    unsigned int size;
+    /* Local names past the slots, or NULL if none is bound. */
+    ZNameTable *names;
+    /* Number of names the caller destructures the result into,
+     *  or zero: a list of that many items may be returned unbuilt.
+     */
+    unsigned int want;
+    /* Value of the return statement, if any. */
+    Zob *ret;
+    /* Frame of the caller, or next spare frame. */
+    struct ZFrame *prev;
+} ZFrame;
+
+/* Dropped frames are kept for reuse, with their slots cleared,
+ *  in classes of FRAMESTEP slots, up to FRAMEPOOL frames per class.
+ * A function has at most 127 local names.
+ */
+#define FRAMESTEP     8
+#define FRAMEPOOL     32
+#define NFRAMECLASSES (128 / FRAMESTEP + 1)
+
+/* Default maximum number of zap function calls running at once.
+ * Calls of the reference engine and resumed generators also nest on
+ *  the C stack, so they are bounded by its room as well.
+ */
+#define ZMAXDEPTH     100000
+
+/* Bytes of C stack that zap calls may use where its limit is unknown. */
+#define ZCSTACKSIZE   (6 * 1024 * 1024)
+
+/* Constant pool: immutable literals of the running module,
+ *  materialized once and keyed by their address in the bytecode.
+ * The constants are immortal, owned by the context.
+ */
+typedef struct {
+    char **keys;
+    Zob **values;
+    unsigned int size;
+    unsigned int count;
+} ZPool;
+
 typedef struct {
     /* Global namespace. */
     ZNameTable *global;
-    /* A stack of local namespaces. */
-    ZList *local;
+    /* Frame of the running zap function, NULL at module level. */
+    ZFrame *frame;
+    /* Number of zap function calls running, at most 'maxdepth'. */
+    unsigned int depth;
+    unsigned int maxdepth;
+    /* Address in the C stack where the outermost call started,
+     *  and how many bytes beyond it the calls may use.
+     */
+    size_t cstack;
+    size_t cstacksize;
+    /* Callers of the threaded code engine waiting for their callees,
+     *  innermost last.
+     */
+    struct ZCaller *callers;
+    unsigned int callersize;
+    unsigned int ncallers;
+    /* Spare frames, by number of slots allocated. */
+    ZFrame *spare[NFRAMECLASSES];
+    unsigned int nspare[NFRAMECLASSES];
+    /* Operand stack of the threaded code engine. */
+    Zob **stack;
+    unsigned int stacksize;
+    unsigned int stacktop;
+    ZPool pool;
+    /* Nonzero if the bytecode run is not kept in place, as for
+     *  interactive lines: literals are built anew instead of pooled.
+     */
+    int nopool;
+    /* Callee of a pending tail call of the reference engine,
+     *  referenced until it returns.
+     */
+    Zob *tailcall;
+    /* Number of items the last call left on the operand stack instead
+     *  of returning a list, or zero.
+     */
+    unsigned int nret;
+    /* Function bodies of the reference engine translated to threaded
+     *  code, which runs generators and whatever they call.
+     */
+    struct ZCode *bodies;
+    /* Intermediate values of the reference engine, referenced until
+     *  the statement that produced them is done.
+     */
+    Zob **temps;
+    unsigned int tempsize;
+    unsigned int ntemps;
+    /* Immortal objects owned by the context: builtins and constants. */
+    Zob **immortals;
+    unsigned int immortalsize;
+    unsigned int nimmortals;
+    /* Allocator current when the context was created. */
+    ZAllocator *allocator;
+    /* If the context owns its allocator (an arena), the one that was
+     *  current before, to be restored when the context is removed.
+     */
+    ZAllocator *outer;
 } ZContext;
 
+/* A generator is a call to a zap function that yields, suspended between
+ *  its values. While suspended, its frame and the values it left on the
+ *  operand stack are kept here, apart from the context, so that nothing
+ *  depends on the C stack: it can be resumed from anywhere.
+ * Generators are containers of what they keep: the cycle collector
+ *  tracks them, and dead ones are torn down a few values at a time.
+ */
+typedef struct {
+    Zob type; /* T_GEN */
+    unsigned int refc;
+    ZGCLink link;
+    /* Always NULL: generators are not copied. */
+    ZShare *share;
+    /* Context that runs the body, translated into 'code'. */
+    ZContext *zcontext;
+    struct ZCode *code;
+    /* Frame of the call, or NULL once the body has returned. */
+    ZFrame *frame;
+    /* Instruction to resume at. */
+    unsigned int resume;
+    /* Values left on the operand stack, up to the maximum depth
+     *  of 'code'.
+     */
+    Zob **stack;
+    unsigned int depth;
+    /* Nonzero while the body runs. */
+    int running;
+} ZGen;
+
 ZError znewcontext(ZContext **zcontext);
+ZError znewarenacontext(ZContext **zcontext);
+ZError zkeep(ZContext *zcontext, Zob *zob);
 void zdelcontext(ZContext **zcontext);
-ZError zpushlocal(ZContext *zcontext);
-ZError zpoplocal(ZContext *zcontext, Zob **ret);
+ZError zcheckdepth(ZContext *zcontext);
+ZError zpushframe(ZContext *zcontext, unsigned int nslots);
+void zdropframe(ZContext *zcontext);
+ZError zpopframe(ZContext *zcontext, Zob **ret);
+void zsetslot(ZFrame *frame, unsigned int slot, Zob *value);
+Zob *zgetspilled(ZFrame *frame, char *name);
+ZError zsetspilled(ZFrame *frame, char *name, Zob *value);
+ZError zsetpath(Zob *head, ZAtom **path, unsigned int length, Zob *value);
+int zgetpath(Zob *head,
+             ZAtom **path,
+             unsigned int length,
+             ZNameTable **self,
+             Zob **pvalue);
 ZError zsetincontext(ZContext *zcontext, char *name, Zob *value);
 int zgetincontext(ZContext *zcontext,
                   char *name,
@@ -62,18 +234,45 @@ int zremincontext(ZContext *zcontext, char *name);
 int zhasincontext(ZContext *zcontext, char *name);
 unsigned int zreadword(char **entry);
 int zread_svlv(char **entry);
+ZError zliteral(char **entry, Zob **zob);
+ZError zconstant(ZContext *zcontext, char **entry, Zob **zob);
 void zskip_svlv(char **entry);
 void zskip_expr(char **entry);
-ZError zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob);
+ZError zeval(ZContext *zcontext, char **entry, Zob **pzob);
 ZError znameval(ZContext *zcontext, char **entry, Zob **pzob);
-ZError zfeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pret);
+ZError zreserve(ZContext *zcontext, unsigned int size);
+ZError ztemp(ZContext *zcontext, Zob *zob);
+void zrelease(ZContext *zcontext, unsigned int mark);
+ZError zbindargs(ZContext *zcontext,
+                 ZHighFunc *zhighfunc,
+                 ZNameTable *self,
+                 Zob **argv,
+                 int argc);
+ZError zreframe(ZContext *zcontext, ZFunc *zfunc, ZNameTable *self, int argc);
+ZError zfeval(ZContext *zcontext, char **entry, Zob **pret);
 void zskip_assign(char **entry);
 ZError zassign(ZContext *zcontext, Zob *value, char **entry);
-ZError zdeepassign(ZContext *zcontext, ZNode *node, char **entry);
-ZError zrunstatement(ZContext *zcontext, ZList *tmp, char **entry);
+ZError zdeepassign(ZContext *zcontext, ZList *zlist, char **entry);
+ZError zforstart(Zob *source, Zob **state);
+ZError zforrange(Zob **argv, Zob **state);
+ZError zfornext(Zob **state, Zob **pitem);
+void zforend(Zob **state);
+ZError znewgen(ZContext *zcontext,
+               ZHighFunc *zhighfunc,
+               ZNameTable *self,
+               Zob **argv,
+               int argc,
+               ZGen **zgen);
+void zdelgen(ZGen **zgen);
+void zgempty(ZGen *zgen);
+int zgdrain(ZGen *zgen, unsigned int *budget);
+int zrepgen(char *buffer, size_t size, ZGen *zgen);
+ZError zresume(ZGen *zgen, Zob **pitem);
+int zunpackable(char *expr, char *target);
+ZError zbindpattern(ZContext *zcontext, char *target, Zob **values);
+ZError zrunstatement(ZContext *zcontext, char **entry);
 void zskip_block(char **entry);
 ZError zrun_block(ZContext *zcontext,
-                  ZList *tmp,
                   char looplev,
                   char **entry,
                   unsigned char *be);
@@ -0,0 +1,37 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Slab Allocator (header) */
+
+/* Small runtime objects are carved out of slabs, one free list per
+ *  size class: multiples of SLABGRAIN bytes, up to SLABMAX.
+ * Freed objects are reused by the next allocation of their class.
+ * Each allocator has its own free lists, and its slabs come from it.
+ * Larger requests, and every request when built with -DZNOSLAB
+ *  (e.g. for memory checkers), go straight to the current allocator.
+ */
+#define SLABGRAIN   16
+#define SLABMAX     128
+#define SLABCLASSES (SLABMAX / SLABGRAIN)
+#define SLABSIZE    8192
+
+void *zalloc(size_t size);
+void zfree(void *ptr, size_t size);
+void zslabstats();
+void zdelslabs();
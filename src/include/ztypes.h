@@ -18,6 +18,8 @@
 
 /* Types (header) */
 
+#include <stdint.h>
+
 /* int length */
 #define WL (8 * sizeof(unsigned int))
 
@@ -34,5 +36,24 @@
 #define T_NMTB  8  /* Name Table */
 #define T_DICT  9
 #define T_FUNC 10
+#define T_GEN  11  /* Generator  */
 
 typedef unsigned char Zob;
+
+/* Immediate Objects
+ * NONE, Bools, Bytes and Ints that fit are not allocated:
+ *  they are encoded in the Zob pointer itself, which is then odd.
+ * Bit 0 is set, bits 1 to 3 hold the type sign
+ *  and the remaining bits hold the value.
+ * Immediate objects have no reference count.
+ */
+#define ZIMMEDIATE(zob)   (((uintptr_t) (zob)) & 1)
+#define ZIMM(type, value) ((Zob *) ((((uintptr_t) (intptr_t) (value)) << 4) | \
+                                    ((type) << 1) | 1))
+#define ZIMMVALUE(zob)    ((int) (((intptr_t) (zob)) >> 4))
+#define ZIMMMIN           (INTPTR_MIN >> 4)
+#define ZIMMMAX           (INTPTR_MAX >> 4)
+
+/* Type sign of 'zob', immediate or not. */
+#define ZTYPE(zob) (ZIMMEDIATE(zob) ? (Zob) ((((uintptr_t) (zob)) >> 1) & 7) \
+                                    : *(zob))
@@ -0,0 +1,117 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Threaded Code Engine (header) */
+
+/* Execution Engines */
+#define ZENGINE_TREE     0  /* Walk the bytecode (reference engine). */
+#define ZENGINE_THREADED 1  /* Run pre-decoded instructions. */
+
+/* Instruction Opcodes */
+#define ZOP_NONE      0
+#define ZOP_BOOL      1
+#define ZOP_BYTE      2
+#define ZOP_CONST     3
+#define ZOP_LIST      4
+#define ZOP_DICT      5
+#define ZOP_NAME      6
+#define ZOP_CALL      7
+#define ZOP_POP       8
+#define ZOP_SETNAME   9
+#define ZOP_ASSIGN   10
+#define ZOP_DELETE   11
+#define ZOP_JUMP     12
+#define ZOP_JUMPIFNOT 13
+#define ZOP_DEF      14
+#define ZOP_RETURN   15
+#define ZOP_ERROR    16
+#define ZOP_END      17
+#define ZOP_LOCAL    18
+#define ZOP_SETLOCAL 19
+#define ZOP_TAILCALL 20
+#define ZOP_UNPACK   21
+#define ZOP_RECEIVE  22
+#define ZOP_RETLIST  23
+#define ZOP_ITER     24
+#define ZOP_RANGE    25
+#define ZOP_NEXT     26
+#define ZOP_DROP     27
+#define ZOP_YIELD    28
+#define ZOP_YARR     29
+
+typedef struct {
+    /* Address of the handler, filled when the code is threaded. */
+    const void *label;
+    int op;
+    /* Integer operand: value, length, argument count or jump target. */
+    int n;
+    /* Bytecode operand: name or literal data. */
+    char *s;
+    /* Constant operand, immortal and owned by the context. */
+    Zob *zob;
+    /* Atom of a name, or of the first component of a dotted name,
+     *  interned at translation.
+     */
+    ZAtom *atom;
+    /* Atoms of the remaining components of a dotted name. */
+    ZAtom **path;
+    unsigned int npath;
+    /* Inline cache: global entry of 'atom', valid while the global
+     *  table is at 'version'.
+     */
+    ZEntry *entry;
+    unsigned int version;
+    /* Body of a function definition. */
+    struct ZCode *code;
+} ZInstr;
+
+typedef struct ZCode {
+    ZInstr *instrs;
+    unsigned int length;
+    unsigned int size;
+    /* Maximum depth reached by the operand stack. */
+    unsigned int maxstack;
+    /* Frame layout of a function body. */
+    unsigned int nslots;
+    int self;
+    /* Nonzero for the body of a generator. */
+    int generator;
+    int threaded;
+    /* Next function body translated from the same module. */
+    struct ZCode *next;
+} ZCode;
+
+/* A zap function waiting for the one it called to return.
+ * Calls between zap functions do not nest on the C stack: the engine
+ *  saves the caller here and runs the callee in the same loop.
+ */
+typedef struct ZCaller {
+    ZCode *zcode;
+    /* Index of the call instruction. */
+    unsigned int pc;
+    /* Start of its values on the operand stack. */
+    unsigned int bottom;
+    /* Callee of its last tail call, referenced, or NULL. */
+    Zob *callee;
+} ZCaller;
+
+ZError znewcode(ZContext *zcontext, ZCode **zcode, char *entry);
+void zdelcode(ZCode **zcode);
+ZError zbodycode(ZContext *zcontext, ZHighFunc *zhighfunc);
+ZError zrun_code(ZContext *zcontext, ZCode *zcode, Zob **pret);
+ZError zrun_gen(ZContext *zcontext, ZGen *zgen, Zob **pret);
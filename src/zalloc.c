@@ -0,0 +1,377 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Allocators */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "zerr.h"
+
+#include "zalloc.h"
+
+/* Bytes of arena taken from the system at a time.
+ * Bigger blocks get a chunk of their own.
+ */
+#define ARENACHUNK 65536
+/* Alignment of every block, as malloc() gives. */
+#define ALIGNMENT  16
+#define ALIGN(size) (((size) + ALIGNMENT - 1) & ~((size_t) ALIGNMENT - 1))
+/* Marks the blocks of a counter, to catch stray frees. */
+#define ZMAGIC     0x5A4150UL
+
+/* Arena and counter blocks are preceded by their size. */
+typedef union {
+    struct {
+        size_t size;
+        unsigned long magic;
+    } h;
+    char pad[ALIGNMENT];
+} ZHeader;
+
+#define HEADER(ptr) ((ZHeader *) (ptr) - 1)
+
+static void *
+sysalloc(ZAllocator *za, size_t size)
+{
+    (void) za;
+    return malloc(size);
+}
+
+static void *
+sysresize(ZAllocator *za, void *ptr, size_t size)
+{
+    (void) za;
+    return realloc(ptr, size);
+}
+
+static void
+sysrelease(ZAllocator *za, void *ptr)
+{
+    (void) za;
+    free(ptr);
+}
+
+static ZAllocator zsystem = {sysalloc, sysresize, sysrelease, 0, NULL, NULL};
+static ZAllocator *current = &zsystem;
+
+/* Return the allocator that forwards to malloc(). */
+ZAllocator *
+zsysalloc()
+{
+    return &zsystem;
+}
+
+/* Return the allocator used by zmalloc() and friends. */
+ZAllocator *
+zgetallocator()
+{
+    return current;
+}
+
+/* Make 'za' the allocator of the runtime.
+ * Blocks must be released while the allocator they came from is
+ *  current.
+ */
+void
+zsetallocator(ZAllocator *za)
+{
+    current = za;
+}
+
+/* Bump 'size' bytes off the arena's current chunk,
+ *  taking a new chunk if it is exhausted.
+ */
+static void *
+arenaalloc(ZAllocator *za, size_t size)
+{
+    ZArena *arena = (ZArena *) za;
+    ZChunk *chunk;
+    ZHeader *header;
+    size_t need, csize;
+
+    need = sizeof(ZHeader) + ALIGN(size);
+    if (need > (size_t) (arena->end - arena->cursor)) {
+        csize = ALIGN(sizeof(ZChunk)) + need;
+        if (need <= ARENACHUNK / 4)
+            csize = ARENACHUNK;
+        chunk = (ZChunk *) malloc(csize);
+        if (chunk == NULL)
+            return NULL;
+        chunk->next = arena->chunks;
+        chunk->size = csize;
+        arena->chunks = chunk;
+        if (need > ARENACHUNK / 4) {
+            /* Keep carving from the current chunk afterwards. */
+            header = (ZHeader *) ((char *) chunk + ALIGN(sizeof(ZChunk)));
+            header->h.size = size;
+            return header + 1;
+        }
+        arena->cursor = (char *) chunk + ALIGN(sizeof(ZChunk));
+        arena->end = (char *) chunk + csize;
+    }
+    header = (ZHeader *) arena->cursor;
+    header->h.size = size;
+    arena->last = arena->cursor;
+    arena->cursor += need;
+    return header + 1;
+}
+
+/* Blocks are kept until the arena is removed,
+ *  except for the last one, which is given back.
+ */
+static void
+arenarelease(ZAllocator *za, void *ptr)
+{
+    ZArena *arena = (ZArena *) za;
+
+    if ((char *) HEADER(ptr) == arena->last) {
+        arena->cursor = arena->last;
+        arena->last = NULL;
+    }
+}
+
+static void *
+arenaresize(ZAllocator *za, void *ptr, size_t size)
+{
+    ZArena *arena = (ZArena *) za;
+    ZHeader *header = HEADER(ptr);
+    void *moved;
+
+    /* The last block grows in place while the chunk lasts. */
+    if ((char *) header == arena->last  &&
+        sizeof(ZHeader) + ALIGN(size) <=
+        (size_t) (arena->end - arena->last)) {
+        header->h.size = size;
+        arena->cursor = arena->last + sizeof(ZHeader) + ALIGN(size);
+        return ptr;
+    }
+    moved = arenaalloc(za, size);
+    if (moved == NULL)
+        return NULL;
+    memcpy(moved, ptr, header->h.size < size ? header->h.size : size);
+    return moved;
+}
+
+/* Create a new arena allocator in 'za'.
+ * Its blocks are only freed, all together, by zdelarena().
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewarena(ZAllocator **za)
+{
+    ZArena *arena;
+
+    arena = (ZArena *) malloc(sizeof(ZArena));
+    if (arena == NULL)
+        return ZE_OUT_OF_MEMORY;
+    arena->base.alloc = arenaalloc;
+    arena->base.resize = arenaresize;
+    arena->base.release = arenarelease;
+    arena->base.noslab = 0;
+    arena->base.slabs = NULL;
+    arena->base.gc = NULL;
+    arena->chunks = NULL;
+    arena->cursor = NULL;
+    arena->end = NULL;
+    arena->last = NULL;
+    *za = (ZAllocator *) arena;
+    return ZE_OK;
+}
+
+/* Remove the arena 'za' and every block it handed out from memory.
+ * 'za' must not be the current allocator.
+ */
+void
+zdelarena(ZAllocator **za)
+{
+    ZArena *arena = (ZArena *) *za;
+    ZChunk *next;
+
+    while (arena->chunks != NULL) {
+        next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena);
+    *za = NULL;
+}
+
+/* Report a block that the counter did not hand out, and stop. */
+static void
+counterfault(void *ptr)
+{
+    fprintf(stderr, "zap: release of unknown block %p\n", ptr);
+    abort();
+}
+
+static void *
+counteralloc(ZAllocator *za, size_t size)
+{
+    ZCounter *counter = (ZCounter *) za;
+    ZHeader *header;
+
+    header = (ZHeader *) counter->parent->alloc(counter->parent,
+                                                sizeof(ZHeader) + size);
+    if (header == NULL)
+        return NULL;
+    header->h.size = size;
+    header->h.magic = ZMAGIC;
+    counter->allocs++;
+    counter->total += size;
+    counter->live += size;
+    if (counter->live > counter->peak)
+        counter->peak = counter->live;
+    return header + 1;
+}
+
+static void *
+counterresize(ZAllocator *za, void *ptr, size_t size)
+{
+    ZCounter *counter = (ZCounter *) za;
+    ZHeader *header = HEADER(ptr);
+    size_t old;
+
+    if (header->h.magic != ZMAGIC)
+        counterfault(ptr);
+    old = header->h.size;
+    header = (ZHeader *) counter->parent->resize(counter->parent, header,
+                                                 sizeof(ZHeader) + size);
+    if (header == NULL)
+        return NULL;
+    header->h.size = size;
+    /* A resize counts as a new allocation of 'size' bytes. */
+    counter->allocs++;
+    counter->frees++;
+    counter->total += size;
+    counter->live += size - old;
+    if (counter->live > counter->peak)
+        counter->peak = counter->live;
+    return header + 1;
+}
+
+static void
+counterrelease(ZAllocator *za, void *ptr)
+{
+    ZCounter *counter = (ZCounter *) za;
+    ZHeader *header = HEADER(ptr);
+
+    if (header->h.magic != ZMAGIC)
+        counterfault(ptr);
+    header->h.magic = 0;
+    counter->frees++;
+    counter->live -= header->h.size;
+    counter->parent->release(counter->parent, header);
+}
+
+/* Create a new counting allocator in 'za', taking its blocks from
+ *  'parent' and keeping track of every byte.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewcounter(ZAllocator *parent, ZAllocator **za)
+{
+    ZCounter *counter;
+
+    counter = (ZCounter *) malloc(sizeof(ZCounter));
+    if (counter == NULL)
+        return ZE_OUT_OF_MEMORY;
+    counter->base.alloc = counteralloc;
+    counter->base.resize = counterresize;
+    counter->base.release = counterrelease;
+    counter->base.noslab = 1;
+    counter->base.slabs = NULL;
+    counter->base.gc = NULL;
+    counter->parent = parent;
+    counter->allocs = 0;
+    counter->frees = 0;
+    counter->total = 0;
+    counter->live = 0;
+    counter->peak = 0;
+    *za = (ZAllocator *) counter;
+    return ZE_OK;
+}
+
+/* Remove the counter 'za' from memory.
+ * Blocks still live stay with its parent.
+ */
+void
+zdelcounter(ZAllocator **za)
+{
+    free(*za);
+    *za = NULL;
+}
+
+/* Print the allocation counts of the counter 'za' on stderr. */
+void
+zcounterstats(ZAllocator *za)
+{
+    ZCounter *counter = (ZCounter *) za;
+
+    fprintf(stderr, "%lu allocation(s), %lu release(s)\n",
+            counter->allocs, counter->frees);
+    fprintf(stderr, "%lu byte(s) allocated, %lu at peak, %lu live\n",
+            (unsigned long) counter->total,
+            (unsigned long) counter->peak,
+            (unsigned long) counter->live);
+}
+
+/* Return a block of 'size' bytes from the current allocator,
+ *  or NULL if there is not enough memory.
+ */
+void *
+zmalloc(size_t size)
+{
+    return current->alloc(current, size);
+}
+
+/* Return a zeroed block of 'count' items of 'size' bytes,
+ *  or NULL if there is not enough memory.
+ */
+void *
+zcalloc(size_t count, size_t size)
+{
+    void *ptr;
+
+    ptr = current->alloc(current, count * size);
+    if (ptr != NULL)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+/* Return 'ptr' resized to 'size' bytes, or NULL if there is not
+ *  enough memory, in which case 'ptr' is left untouched.
+ */
+void *
+zrealloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+        return current->alloc(current, size);
+    return current->resize(current, ptr, size);
+}
+
+/* Give 'ptr' back to the current allocator. */
+void
+zmfree(void *ptr)
+{
+    if (ptr != NULL)
+        current->release(current, ptr);
+}
@@ -24,13 +24,19 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zgc.h"
+#include "zalloc.h"
+#include "zslab.h"
 
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
+#include "zfunc.h"
 #include "zdict.h"
 
 #include "zobject.h"
 #include "zruntime.h"
+#include "zvm.h"
 #include "zbuiltin.h"
 
 #include "zcpl_expr.h"
@@ -58,7 +64,6 @@ zinteractive()
     char *stt_entry, *bin_entry;
     Zob *result;
     ZContext *zcontext;
-    ZList *tmp;
 #if DEBUG > 0
     unsigned int length;
 #endif
@@ -69,21 +74,13 @@ zinteractive()
     err = znewcontext(&zcontext);
     if (err != ZE_OK)
         return err;
-    err = zbuild(&zcontext->global);
-    if (err != ZE_OK) {
-        zdelcontext(&zcontext);
-        return err;
-    }
-    err = znewlist(&zcontext->local);
-    if (err != ZE_OK) {
-        zdelcontext(&zcontext);
-        return err;
-    }
-    err = znewlist(&tmp);
+    err = zbuild(zcontext);
     if (err != ZE_OK) {
         zdelcontext(&zcontext);
         return err;
     }
+    /* Every line is compiled to the same buffer. */
+    zcontext->nopool = 1;
 
     while (1) {
         printf("> ");
@@ -98,99 +95,115 @@ zinteractive()
             (void) cpl_stt(&stt_entry, bin);
 #endif
             bin_entry = bin;
-            err = zeval(zcontext, tmp, &bin_entry, &result);
+            err = zeval(zcontext, &bin_entry, &result);
             if (err != ZE_OK) {
                 zdelcontext(&zcontext);
-                zdellist(&tmp);
                 return err;
             }
             zassign(zcontext, result, &bin_entry);
             zrepobj(buffer, 1024, result);
             printf("%s\n", buffer);
-            zlempty(tmp);
+            zrelease(zcontext, 0);
         }
         else
             break;
     }
 
-    zdellist(&tmp);
     zdelcontext(&zcontext);
     return ZE_OK;
 }
 
+/* Run the module in 'binname' with 'engine'
+ *  (ZENGINE_TREE or ZENGINE_THREADED).
+ * If 'arena' is nonzero, its context is allocated from an arena.
+ * If 'maxdepth' is nonzero, at most that many zap function calls
+ *  may run at once, instead of ZMAXDEPTH. Calls that nest on the
+ *  C stack stop short of its limit in any case.
+ */
 ZError
-zrun_mod(char *binname, ZContext **endcontext)
+zrun_mod(char *binname,
+         int engine,
+         int arena,
+         unsigned int maxdepth,
+         ZContext **endcontext)
 {
     FILE *fzbc;
     int size;
     char *szbc, *entry;
     ZContext *zcontext;
-    ZList *tmp;
     unsigned char be;
     ZError err;
 
-    err = znewlist(&tmp);
-    if (err != ZE_OK)
-        return err;
     fzbc = fopen(binname, "rb");
-    if (fzbc == NULL) {
-        zdellist(&tmp);
+    if (fzbc == NULL)
         return ZE_OPEN_FILE_ERROR;
-    }
     fseek(fzbc, 0L, SEEK_END);
     size = ftell(fzbc);
     fseek(fzbc, 0L, SEEK_SET);
     szbc = (char *) malloc(size * sizeof(char));
     if (szbc == NULL) {
-        zdellist(&tmp);
         fclose(fzbc);
         return ZE_OUT_OF_MEMORY;
     }
     if (fread(szbc, (size_t) size, 1, fzbc) == 0) {
-        zdellist(&tmp);
         fclose(fzbc);
         free(szbc);
         szbc = NULL;
         return ZE_OPEN_FILE_ERROR;
     }
     fclose(fzbc);
-
-    err = znewcontext(&zcontext);
-    if (err != ZE_OK) {
-        zdellist(&tmp);
+    if (size < ZBC_HEADER  ||
+        memcmp(szbc, ZBC_MAGIC, ZBC_HEADER - 1) != 0  ||
+        szbc[ZBC_HEADER - 1] != ZBC_VERSION) {
+        /* Not a module, or compiled for another version. */
         free(szbc);
         szbc = NULL;
-        return err;
+        return ZE_BYTECODE_VERSION;
     }
-    *endcontext = zcontext;
-    err = zbuild(&zcontext->global);
+
+    if (arena)
+        err = znewarenacontext(&zcontext);
+    else
+        err = znewcontext(&zcontext);
     if (err != ZE_OK) {
-        zdellist(&tmp);
         free(szbc);
         szbc = NULL;
-        zdelcontext(&zcontext);
         return err;
     }
-    err = znewlist(&zcontext->local);
+    *endcontext = zcontext;
+    if (maxdepth > 0)
+        zcontext->maxdepth = maxdepth;
+    err = zbuild(zcontext);
     if (err != ZE_OK) {
-        zdellist(&tmp);
         free(szbc);
         szbc = NULL;
         zdelcontext(&zcontext);
         return err;
     }
 
-    entry = szbc;
-    be = 0;
-    err = zrun_block(zcontext, tmp, 0, &entry, &be);
+    entry = szbc + ZBC_HEADER;
+    if (engine == ZENGINE_THREADED) {
+        ZCode *zcode;
+        Zob *ret;
+
+        err = znewcode(zcontext, &zcode, entry);
+        if (err == ZE_OK) {
+            err = zrun_code(zcontext, zcode, &ret);
+            if (err == ZE_OK)
+                zdecrefc(ret);
+            zdelcode(&zcode);
+        }
+    }
+    else {
+        be = 0;
+        err = zrun_block(zcontext, 0, &entry, &be);
+    }
     if (err != ZE_OK) {
-        zdellist(&tmp);
         free(szbc);
         szbc = NULL;
         return err;
     }
 
-    zdellist(&tmp);
     free(szbc);
     szbc = NULL;
 
@@ -202,9 +215,58 @@ main(int argc, char *argv[])
 {
     char *binname, *ext;
     int compile = 0;
+    int engine = ZENGINE_TREE;
+    int slabstats = 0;
+    int arena = 0;
+    unsigned int maxdepth = 0;
+    ZAllocator *counter = NULL;
     ZContext *endcontext = NULL;
     ZError err = ZE_OK;
 
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+        if (strncmp(argv[1], "--engine=", 9) == 0) {
+            if (strcmp(argv[1] + 9, "threaded") == 0)
+                engine = ZENGINE_THREADED;
+            else if (strcmp(argv[1] + 9, "tree") != 0) {
+                fprintf(stderr, "unknown engine: %s\n", argv[1] + 9);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[1], "--alloc=", 8) == 0) {
+            if (strcmp(argv[1] + 8, "arena") == 0)
+                arena = 1;
+            else if (strcmp(argv[1] + 8, "count") == 0) {
+                if (counter == NULL  &&
+                    znewcounter(zsysalloc(), &counter) != ZE_OK) {
+                    zraiseOutOfMemory("main");
+                    return EXIT_FAILURE;
+                }
+            }
+            else if (strcmp(argv[1] + 8, "system") != 0) {
+                fprintf(stderr, "unknown allocator: %s\n", argv[1] + 8);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[1], "--max-depth=", 12) == 0) {
+            char *end;
+
+            maxdepth = (unsigned int) strtoul(argv[1] + 12, &end, 10);
+            if (maxdepth == 0  ||  *end != '\0') {
+                fprintf(stderr, "invalid depth: %s\n", argv[1] + 12);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[1], "--slab-stats") == 0)
+            slabstats = 1;
+        else {
+            fprintf(stderr, "unknown option: %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+        argv++;
+        argc--;
+    }
+    if (counter != NULL)
+        zsetallocator(counter);
     if (argc == 2) {
         ext = strrchr(argv[1], '.');
         if (ext != NULL) {
@@ -223,7 +285,8 @@ main(int argc, char *argv[])
                 if (ext != NULL)
                     *ext = '\0';
                 strcat(binname, ".zbc");
-                err = zrun_mod(binname, &endcontext);
+                err = zrun_mod(binname, engine, arena, maxdepth,
+                               &endcontext);
                 if (endcontext != NULL)
                     zdelcontext(&endcontext);
                 free(binname);
@@ -231,7 +294,8 @@ main(int argc, char *argv[])
             }
         }
         else {
-            err = zrun_mod(argv[1], &endcontext);
+            err = zrun_mod(argv[1], engine, arena, maxdepth,
+                           &endcontext);
             if (endcontext != NULL)
                 zdelcontext(&endcontext);
         }
@@ -247,5 +311,16 @@ main(int argc, char *argv[])
         }
     }
 
+    if (slabstats)
+        zslabstats();
+    zdelgc();
+    zdelslabs();
+    if (counter != NULL) {
+        /* Whatever is still live was never released. */
+        zsetallocator(zsysalloc());
+        zcounterstats(counter);
+        zdelcounter(&counter);
+    }
+    zdelatoms();
     return zraiseerr(err);
 }
@@ -0,0 +1,179 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Atom Interner */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zerr.h"
+#include "zalloc.h"
+
+#include "zatom.h"
+
+/* Atoms outlive every context, so they always come from the system
+ *  allocator.
+ */
+
+/* Initial number of buckets, a power of two. */
+#define ZATOMBUCKETS 256
+
+static ZAtom **buckets = NULL;
+static unsigned int nbuckets = 0;
+static unsigned int natoms = 0;
+
+/* Return the FNV-1a hash of the first 'length' characters of 'name'. */
+static unsigned int
+zhashname(char *name, size_t length)
+{
+    unsigned int hash = 2166136261U;
+
+    for (; length > 0; length--) {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619U;
+        name++;
+    }
+    return hash;
+}
+
+/* Double the number of buckets.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zgrowatoms()
+{
+    ZAllocator *sys = zsysalloc();
+    ZAtom **newbuckets, *atom, *next;
+    unsigned int newsize, i, h;
+
+    newsize = (nbuckets == 0) ? ZATOMBUCKETS : 2 * nbuckets;
+    newbuckets = (ZAtom **) sys->alloc(sys, newsize * sizeof(ZAtom *));
+    if (newbuckets == NULL)
+        return ZE_OUT_OF_MEMORY;
+    memset(newbuckets, 0, newsize * sizeof(ZAtom *));
+    for (i = 0; i < nbuckets; i++) {
+        for (atom = buckets[i]; atom != NULL; atom = next) {
+            next = atom->next;
+            h = zhashname(atom->name, strlen(atom->name)) & (newsize - 1);
+            atom->next = newbuckets[h];
+            newbuckets[h] = atom;
+        }
+    }
+    if (buckets != NULL)
+        sys->release(sys, buckets);
+    buckets = newbuckets;
+    nbuckets = newsize;
+    return ZE_OK;
+}
+
+/* If the first 'length' characters of 'name' were interned,
+ *  return their atom.
+ * Otherwise, return NULL.
+ */
+ZAtom *
+zfindatomn(char *name, size_t length)
+{
+    ZAtom *atom;
+
+    if (nbuckets == 0)
+        return NULL;
+    atom = buckets[zhashname(name, length) & (nbuckets - 1)];
+    while (atom != NULL) {
+        if (strncmp(atom->name, name, length) == 0  &&
+            atom->name[length] == '\0')
+            return atom;
+        atom = atom->next;
+    }
+    return NULL;
+}
+
+/* If 'name' was interned, return its atom.
+ * Otherwise, return NULL.
+ */
+ZAtom *
+zfindatom(char *name)
+{
+    return zfindatomn(name, strlen(name));
+}
+
+/* Save the atom of the first 'length' characters of 'name' in 'atom',
+ *  creating it if needed.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zinternn(char *name, size_t length, ZAtom **atom)
+{
+    ZAllocator *sys = zsysalloc();
+    unsigned int h;
+    ZError err;
+
+    *atom = zfindatomn(name, length);
+    if (*atom != NULL)
+        return ZE_OK;
+    if (natoms >= nbuckets) {
+        err = zgrowatoms();
+        if (err != ZE_OK)
+            return err;
+    }
+    /* The name is stored along with its atom. */
+    *atom = (ZAtom *) sys->alloc(sys, sizeof(ZAtom) + length + 1);
+    if (*atom == NULL)
+        return ZE_OUT_OF_MEMORY;
+    (*atom)->name = (char *) (*atom + 1);
+    memcpy((*atom)->name, name, length);
+    (*atom)->name[length] = '\0';
+    (*atom)->id = natoms;
+    h = zhashname(name, length) & (nbuckets - 1);
+    (*atom)->next = buckets[h];
+    buckets[h] = *atom;
+    natoms++;
+    return ZE_OK;
+}
+
+/* Save the atom of 'name' in 'atom', creating it if needed.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zintern(char *name, ZAtom **atom)
+{
+    return zinternn(name, strlen(name), atom);
+}
+
+/* Remove all atoms from memory. */
+void
+zdelatoms()
+{
+    ZAllocator *sys = zsysalloc();
+    ZAtom *atom, *next;
+    unsigned int i;
+
+    for (i = 0; i < nbuckets; i++) {
+        for (atom = buckets[i]; atom != NULL; atom = next) {
+            next = atom->next;
+            sys->release(sys, atom);
+        }
+    }
+    if (buckets != NULL)
+        sys->release(sys, buckets);
+    buckets = NULL;
+    nbuckets = 0;
+    natoms = 0;
+}
@@ -29,6 +29,8 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zalloc.h"
+#include "zslab.h"
 
 #include "zbyte.h"
 #include "zbignum.h"
@@ -77,7 +79,7 @@ zstrbitlen(char *s, unsigned int *bitlen)
     char *tmpstr;
 
     strlength = strlen(s);
-    tmpstr = (char *) malloc(strlength + 1);
+    tmpstr = (char *) zmalloc(strlength + 1);
     if (tmpstr == NULL)
         return ZE_OUT_OF_MEMORY;
     memcpy(tmpstr, s, strlength + 1);
@@ -86,7 +88,7 @@ zstrbitlen(char *s, unsigned int *bitlen)
         (void) zhalfstr(tmpstr);
         (*bitlen)++;
     }
-    free(tmpstr);
+    zmfree(tmpstr);
     tmpstr = NULL;
     return ZE_OK;
 }
@@ -103,13 +105,13 @@ znewbnum(ZBigNum **zbignum, unsigned int length)
 
     if (length < 32)
         length = 32;
-    *zbignum = (ZBigNum *) malloc(sizeof(ZBigNum));
+    *zbignum = (ZBigNum *) zalloc(sizeof(ZBigNum));
     if (*zbignum == NULL)
         return ZE_OUT_OF_MEMORY;
     wordlen = (int) (length / WL);
     if (length % WL)
         wordlen++;
-    array = (unsigned int *) calloc((size_t) wordlen, sizeof(unsigned int));
+    array = (unsigned int *) zcalloc((size_t) wordlen, sizeof(unsigned int));
     if (array == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zbignum)->type = T_BNUM;
@@ -152,9 +154,9 @@ zbnumfromstr(ZBigNum **zbignum, char *s)
 void
 zdelbnum(ZBigNum **zbignum)
 {
-    free((*zbignum)->words);
+    zmfree((*zbignum)->words);
     (*zbignum)->words = NULL;
-    free(*zbignum);
+    zfree(*zbignum, sizeof(ZBigNum));
     *zbignum = NULL;
 }
 
@@ -219,6 +221,27 @@ zcmpbnum(ZBigNum *zbignum, ZBigNum *other)
     }
 }
 
+/* Return the hash of 'zbignum'.
+ * Only the bits compared by zcmpbnum() are hashed.
+ */
+unsigned int
+zhashbnum(ZBigNum *zbignum)
+{
+    unsigned int hash = zbignum->length;
+    unsigned int mask;
+    int index, wordlen;
+
+    wordlen = (int) (zbignum->length / WL);
+    if (zbignum->length % WL)
+        wordlen++;
+    if (wordlen == 0)
+        return hash;
+    for (index = 0; index < wordlen - 1; index++)
+        hash = hash * 31 + zbignum->words[index];
+    mask = (1 << (zbignum->length % WL)) - 1;
+    return hash * 31 + (zbignum->words[index] & mask);
+}
+
 /* Print the textual representation of 'zbignum' on 'buffer'.
  * Return the number of bytes writen.
  */
@@ -250,23 +273,22 @@ znlength(ZBigNum *zbignum)
 }
 
 /* Copy the 'index'-th bit of 'zbignum' to 'value'.
- * 'value' must be preallocated with znewbyte().
  * If 'index' is negative, use znlength('zbytearray') + 'index'.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
  * Otherwise, return ZE_OK.
  */
 ZError
-znget(ZBigNum *zbignum, int index, ZByte **value)
+znget(ZBigNum *zbignum, int index, Zob **value)
 {
     if (index < 0)
         index += zbignum->length;
     if (index < 0 || index >= (int) zbignum->length)
         return ZE_INDEX_OUT_OF_RANGE;
     if (zbignum->words[index / WL] & (1 << (index % WL))) {
-        (*value)->value = 1;
+        *value = ZBYTE(1);
         return ZE_OK;
     }
-    (*value)->value = 0;
+    *value = ZBYTE(0);
     return ZE_OK;
 }
 
@@ -276,7 +298,7 @@ znget(ZBigNum *zbignum, int index, ZByte **value)
  * Otherwise, return ZE_OK.
  */
 ZError
-znset(ZBigNum *zbignum, int index, ZByte *zbyte)
+znset(ZBigNum *zbignum, int index, Zob *zbyte)
 {
     if (index < 0)
         index += zbignum->length;
@@ -26,52 +26,13 @@
 
 #include "zbool.h"
 
-/* Create a new ZBool in 'zbool'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-znewbool(ZBool **zbool)
-{
-    *zbool = (ZBool *) malloc(sizeof(ZBool));
-    if (*zbool == NULL)
-        return ZE_OUT_OF_MEMORY;
-    (*zbool)->type = T_BOOL;
-    (*zbool)->refc = 0;
-    return ZE_OK;
-}
-
-/* Remove 'zdict' from memory. */
-void
-zdelbool(ZBool **zbool)
-{
-    free(*zbool);
-    *zbool = NULL;
-}
-
-/* Create a new copy of 'source' in 'dest'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-zcpybool(ZBool *source, ZBool **dest)
-{
-    ZError err;
-
-    err = znewbool(dest);
-    if (err != ZE_OK)
-        return err;
-    (*dest)->value = source->value;
-    return ZE_OK;
-}
-
 /* Test the truth value of 'zbool'.
- * Return 'zbool->value'.
+ * Return its value.
  */
 int
-ztstbool(ZBool *zbool)
+ztstbool(Zob *zbool)
 {
-    return (int) zbool->value;
+    return ZBOOLVALUE(zbool);
 }
 
 /* Compare 'zbool' and 'other'.
@@ -79,29 +40,21 @@ ztstbool(ZBool *zbool)
  * Otherwise, return nonzero.
  */
 int
-zcmpbool(ZBool *zbool, ZBool *other)
+zcmpbool(Zob *zbool, Zob *other)
 {
-    if (other->value) {
-        if (zbool->value)
-            return 0;
-        else
-            return 1;
-    }
-    else {
-        if (!zbool->value)
-            return 0;
-        else
-            return 1;
-    }
+    if (ZBOOLVALUE(other) == ZBOOLVALUE(zbool))
+        return 0;
+    else
+        return 1;
 }
 
 /* Print the textual representation of 'zbool' on 'buffer'.
  * Return the number of bytes writen.
  */
 int
-zrepbool(char *buffer, size_t size, ZBool *zbool)
+zrepbool(char *buffer, size_t size, Zob *zbool)
 {
-    if (zbool->value)
+    if (ZBOOLVALUE(zbool))
         return snprintf(buffer, size, "TRUE");
     else
         return snprintf(buffer, size, "FALSE");
@@ -28,6 +28,7 @@
 #include "ztypes.h"
 #include "zerr.h"
 #include "zgc.h"
+#include "zalloc.h"
 
 #include "znone.h"
 #include "zbool.h"
@@ -36,218 +37,200 @@
 #include "zbytearray.h"
 #include "zbignum.h"
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
 #include "zdict.h"
 #include "zfunc.h"
 
 #include "zobject.h"
+#include "zruntime.h"
 
 #include "zbuiltin.h"
 
 /* $(o) */
 ZError
-z_copy(ZList *args, Zob **ret)
+z_copy(Zob **argv, int argc, Zob **ret)
 {
-    return zcpyobj(args->first->object, ret);
+    return zcpyobj(argv[0], ret);
 }
 
 /* tname(o) */
 ZError
-z_tname(ZList *args, Zob **ret)
+z_tname(Zob **argv, int argc, Zob **ret)
 {
-    return ztypename(args->first->object, ret);
+    return ztypename(argv[0], ret);
 }
 
 /* refc(o) */
 ZError
-z_refc(ZList *args, Zob **ret)
+z_refc(Zob **argv, int argc, Zob **ret)
 {
-    ZError err;
-
-    err = znewbyte((ZByte **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZByte *) *ret)->value = ((RefC *) args->first->object)->refc;
-    return ZE_OK;
+    /* Immediate and immortal objects are not counted. */
+    if (ZUNCOUNTED(argv[0]))
+        return zmkint(ret, 0);
+    return zmkint(ret, (int) ((RefC *) argv[0])->refc);
 }
 
 /* print(s) */
 ZError
-z_print(ZList *args, Zob **ret)
+z_print(Zob **argv, int argc, Zob **ret)
 {
     char buffer[1024];
-    ZError err;
+    int blen;
 
-    if (*args->first->object != T_YARR)
+    if (ZTYPE(argv[0]) != T_YARR)
         return ZE_INVALID_ARGUMENT;
-    err = znewint((ZInt **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZInt *) *ret)->value = zrepplain(buffer,
-                                       1024,
-                             (ZByteArray *) args->first->object);
+    blen = zrepplain(buffer, 1024, (ZByteArray *) argv[0]);
     printf("%s", buffer);
-    return ZE_OK;
+    return zmkint(ret, blen);
 }
 
 /* printx([s1 o1 s2 o2 ... sn on]) */
 ZError
-z_printx(ZList *args, Zob **ret)
+z_printx(Zob **argv, int argc, Zob **ret)
 {
     char buffer[1024];
-    ZNode *node;
+    ZList *zlist;
+    unsigned int i;
     int plain = 1;
     int blen = 0;
-    ZError err;
 
-    if (*args->first->object != T_LIST)
+    if (ZTYPE(argv[0]) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     *buffer = '\0';
-    node = ((ZList *) args->first->object)->first;
-    while (node != NULL) {
+    zlist = (ZList *) argv[0];
+    for (i = 0; i < zlist->length; i++) {
         if (plain)
-            blen += zrepplain(buffer + blen, 1024, (ZByteArray *) node->object);
+            blen += zrepplain(buffer + blen, 1024,
+                              (ZByteArray *) ZLITEM(zlist, i));
         else
-            blen += zrepobj(buffer + blen, 1024, node->object);
+            blen += zrepobj(buffer + blen, 1024, ZLITEM(zlist, i));
         plain = !plain;
-        node = node->next;
     }
-    err = znewint((ZInt **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZInt *) *ret)->value = blen;
     printf("%s", buffer);
-    return ZE_OK;
+    return zmkint(ret, blen);
 }
 
 /* repr(o) */
 ZError
-z_repr(ZList *args, Zob **ret)
+z_repr(Zob **argv, int argc, Zob **ret)
 {
     char buffer[1024];
 
-    zrepobj(buffer, 1024, args->first->object);
+    zrepobj(buffer, 1024, argv[0]);
     return zyarrfromstr((ZByteArray **) ret, buffer);
 }
 
 /* len(x) */
 ZError
-z_len(ZList *args, Zob **ret)
+z_len(Zob **argv, int argc, Zob **ret)
 {
-    Zob *obj = args->first->object;
-    ZError err;
+    Zob *obj = argv[0];
 
-    err = znewint((ZInt **) ret);
-    if (err != ZE_OK)
-        return err;
-    switch (*obj) {
+    switch (ZTYPE(obj)) {
         case T_YARR:
-            ((ZInt *) *ret)->value = (int) zalength((ZByteArray *) obj);
-            break;
+            return zmkint(ret, (int) zalength((ZByteArray *) obj));
         case T_LIST:
-            ((ZInt *) *ret)->value = (int) zllength((ZList *) obj);
-            break;
+            return zmkint(ret, (int) zllength((ZList *) obj));
         case T_NMTB:
-            ((ZInt *) *ret)->value = (int) ztlength((ZNameTable *) obj);
-            break;
+            return zmkint(ret, (int) ztlength((ZNameTable *) obj));
         case T_DICT:
-            ((ZInt *) *ret)->value = (int) zdlength((ZDict *) obj);
-            break;
+            return zmkint(ret, (int) zdlength((ZDict *) obj));
         default:
             return ZE_INVALID_ARGUMENT;
     }
-    return ZE_OK;
 }
 
 /* arr(c) */
 ZError
-z_arr(ZList *args, Zob **ret)
+z_arr(Zob **argv, int argc, Zob **ret)
 {
     Zob *i;
     ZError err;
 
-    if (*args->first->object != T_BYTE)
+    if (ZTYPE(argv[0]) != T_BYTE)
         return ZE_INVALID_ARGUMENT;
-    i = args->first->object;
+    i = argv[0];
     err = znewyarr((ZByteArray **) ret, 1);
     if (err != ZE_OK)
         return err;
-    ((ZByteArray *) *ret)->bytes[0] = ((ZByte *) i)->value;
+    ((ZByteArray *) *ret)->bytes[0] = ZBYTEVALUE(i);
     return ZE_OK;
 }
 
 /* concat(s1 s2) */
 ZError
-z_concat(ZList *args, Zob **ret)
+z_concat(Zob **argv, int argc, Zob **ret)
 {
     Zob *s2;
     ZError err;
 
-    if (*args->first->object != T_YARR ||
-        *args->first->next->object != T_YARR)
+    if (ZTYPE(argv[0]) != T_YARR ||
+        ZTYPE(argv[1]) != T_YARR)
         return ZE_INVALID_ARGUMENT;
-    *ret = args->first->object;
-    s2 = args->first->next->object;
+    *ret = argv[0];
+    s2 = argv[1];
     err = zconcat((ZByteArray *) *ret, (ZByteArray *) s2);
     return err;
 }
 
 /* join([s1 s2 ... sn] sep) */
 ZError
-z_join(ZList *args, Zob **ret)
+z_join(Zob **argv, int argc, Zob **ret)
 {
-    ZNode *sub;
+    ZList *subs;
     ZByteArray *sep;
+    unsigned int i;
     ZError err;
 
-    if (*args->first->object != T_LIST ||
-        *args->first->next->object != T_YARR)
+    if (ZTYPE(argv[0]) != T_LIST ||
+        ZTYPE(argv[1]) != T_YARR)
         return ZE_INVALID_ARGUMENT;
-    if (((ZList *) args->first->object)->length == 0)
+    subs = (ZList *) argv[0];
+    if (subs->length == 0)
         return zyarrfromstr((ZByteArray **) ret, "");
-    sub = ((ZList *) args->first->object)->first;
-    sep = (ZByteArray *) args->first->next->object;
-    err = zcpyobj(sub->object, ret);
+    sep = (ZByteArray *) argv[1];
+    err = zcpyobj(ZLITEM(subs, 0), ret);
     if (err != ZE_OK)
         return err;
-    sub = sub->next;
-    while (sub != NULL) {
+    for (i = 1; i < subs->length; i++) {
         err = zconcat((ZByteArray *) *ret, sep);
         if (err != ZE_OK)
             return err;
-        err = zconcat((ZByteArray *) *ret, (ZByteArray *) sub->object);
+        err = zconcat((ZByteArray *) *ret, (ZByteArray *) ZLITEM(subs, i));
         if (err != ZE_OK)
             return err;
-        sub = sub->next;
     }
     return ZE_OK;
 }
 
 /* push(list item) */
 ZError
-z_push(ZList *args, Zob **ret)
+z_push(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist, *item;
 
-    zlist = args->first->object;
-    if (*zlist != T_LIST)
+    zlist = argv[0];
+    if (ZTYPE(zlist) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    item = args->first->next->object;
+    item = argv[1];
     *ret = zlist;
     return zlpush((ZList *) zlist, item);
 }
 
 /* peek(list) */
 ZError
-z_peek(ZList *args, Zob **ret)
+z_peek(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist;
 
-    zlist = args->first->object;
-    if (*zlist != T_LIST)
+    zlist = argv[0];
+    if (ZTYPE(zlist) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     *ret = zlpeek((ZList *) zlist);
-    if (**ret == EMPTY)
+    if (*ret == NULL)
+        return ZE_OUT_OF_MEMORY;
+    if (ZTYPE(*ret) == EMPTY)
         return ZE_INDEX_OUT_OF_RANGE;
     else
         return ZE_OK;
@@ -255,96 +238,99 @@ z_peek(ZList *args, Zob **ret)
 
 /* pop(list) */
 ZError
-z_pop(ZList *args, Zob **ret)
+z_pop(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist;
 
-    zlist = args->first->object;
-    if (*zlist != T_LIST)
+    zlist = argv[0];
+    if (ZTYPE(zlist) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     *ret = zlpop((ZList *) zlist);
-    if (**ret == EMPTY)
+    if (*ret == NULL)
+        return ZE_OUT_OF_MEMORY;
+    if (ZTYPE(*ret) == EMPTY)
         return ZE_INDEX_OUT_OF_RANGE;
-    else
-        return ZE_OK;
+    /* Results are not referenced by the callee, as with new objects. */
+    zdisown(*ret);
+    return ZE_OK;
 }
 
 /* append(list item) */
 ZError
-z_append(ZList *args, Zob **ret)
+z_append(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist, *item;
 
-    zlist = args->first->object;
-    if (*zlist != T_LIST)
+    zlist = argv[0];
+    if (ZTYPE(zlist) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    item = args->first->next->object;
+    item = argv[1];
     *ret = zlist;
     return zlappend((ZList *) zlist, item);
 }
 
 /* set(list index item) */
 ZError
-z_set(ZList *args, Zob **ret)
+z_set(Zob **argv, int argc, Zob **ret)
 {
     ZList *zlist;
     Zob *index, *item;
 
-    *ret = args->first->object;
-    if (**ret != T_LIST)
+    *ret = argv[0];
+    if (ZTYPE(*ret) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     zlist = (ZList *) *ret;
-    index = args->first->next->object;
-    if (*index != T_INT)
+    index = argv[1];
+    if (ZTYPE(index) != T_INT)
         return ZE_INVALID_ARGUMENT;
-    item = args->first->next->next->object;
-    return zlset(zlist, ((ZInt *) index)->value, item);
+    item = argv[2];
+    return zlset(zlist, ZINTVALUE(index), item);
 }
 
 /* get(list index) */
 ZError
-z_get(ZList *args, Zob **ret)
+z_get(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist, *index;
 
-    zlist = args->first->object;
-    if (*zlist != T_LIST)
+    zlist = argv[0];
+    if (ZTYPE(zlist) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    index = args->first->next->object;
-    if (*index != T_INT)
+    index = argv[1];
+    if (ZTYPE(index) != T_INT)
         return ZE_INVALID_ARGUMENT;
-    return zlget((ZList *) zlist, ((ZInt *) index)->value, ret);
+    return zlget((ZList *) zlist, ZINTVALUE(index), ret);
 }
 
 /* ins(list index item) */
 ZError
-z_ins(ZList *args, Zob **ret)
+z_ins(Zob **argv, int argc, Zob **ret)
 {
     ZList *zlist;
     Zob *index, *item;
 
-    *ret = args->first->object;
-    if (**ret != T_LIST)
+    *ret = argv[0];
+    if (ZTYPE(*ret) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     zlist = (ZList *) *ret;
-    index = args->first->next->object;
-    if (*index != T_INT)
+    index = argv[1];
+    if (ZTYPE(index) != T_INT)
         return ZE_INVALID_ARGUMENT;
-    item = args->first->next->next->object;
-    return zlinsert(zlist, ((ZInt *) index)->value, item);
+    item = argv[2];
+    return zlinsert(zlist, ZINTVALUE(index), item);
 }
 
 /* ext(lista listb) */
 ZError
-z_ext(ZList *args, Zob **ret)
+z_ext(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlista, *zlistb;
 
-    zlista = args->first->object;
-    if (*zlista != T_LIST)
+    zlista = argv[0];
+    if (ZTYPE(zlista) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    zlistb = args->first->next->object;
-    if (*zlistb != T_LIST)
+    zlistb = argv[1];
+    if (ZTYPE(zlistb) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     *ret = zlista;
     return zlextend((ZList *) zlista, (ZList *) zlistb);
@@ -352,67 +338,63 @@ z_ext(ZList *args, Zob **ret)
 
 /* rem(list index) */
 ZError
-z_rem(ZList *args, Zob **ret)
+z_rem(Zob **argv, int argc, Zob **ret)
 {
     ZList *zlist;
     Zob *index;
 
-    *ret = args->first->object;
-    if (**ret != T_LIST)
+    *ret = argv[0];
+    if (ZTYPE(*ret) != T_LIST)
         return ZE_INVALID_ARGUMENT;
     zlist = (ZList *) *ret;
-    index = args->first->next->object;
-    if (*index != T_INT)
+    index = argv[1];
+    if (ZTYPE(index) != T_INT)
         return ZE_INVALID_ARGUMENT;
-    return zlremove(zlist, ((ZInt *) index)->value);
+    return zlremove(zlist, ZINTVALUE(index));
 }
 
 /* has(list item) */
 ZError
-z_has(ZList *args, Zob **ret)
+z_has(Zob **argv, int argc, Zob **ret)
 {
     Zob *zlist, *item;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    if (*args->first->object != T_LIST)
+    if (ZTYPE(argv[0]) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    zlist = args->first->object;
-    item = args->first->next->object;
-    ((ZBool *) *ret)->value = zlhasitem((ZList *) zlist, item);
+    zlist = argv[0];
+    item = argv[1];
+    *ret = ZBOOL(zlhasitem((ZList *) zlist, item));
     return ZE_OK;
 }
 
 /* setkey(dict key value) */
 ZError
-z_setkey(ZList *args, Zob **ret)
+z_setkey(Zob **argv, int argc, Zob **ret)
 {
     ZDict *zdict;
     Zob *key, *value;
 
-    *ret = args->first->object;
-    if (**ret != T_DICT)
+    *ret = argv[0];
+    if (ZTYPE(*ret) != T_DICT)
         return ZE_INVALID_ARGUMENT;
     zdict = (ZDict *) *ret;
-    key = args->first->next->object;
-    value = args->first->next->next->object;
+    key = argv[1];
+    value = argv[2];
     return zdset(zdict, key, value);
 }
 
 /* getkey(dict key defval) */
 ZError
-z_getkey(ZList *args, Zob **ret)
+z_getkey(Zob **argv, int argc, Zob **ret)
 {
     Zob *zdict, *key, *defval;
     ZError err;
 
-    zdict = args->first->object;
-    if (*zdict != T_DICT)
+    zdict = argv[0];
+    if (ZTYPE(zdict) != T_DICT)
         return ZE_INVALID_ARGUMENT;
-    key = args->first->next->object;
-    defval = args->first->next->next->object;
+    key = argv[1];
+    defval = argv[2];
     err = zcpyobj(defval, ret);
     if (err != ZE_OK)
         return err;
@@ -422,339 +404,238 @@ z_getkey(ZList *args, Zob **ret)
 
 /* +(a b) */
 ZError
-z_sum(ZList *args, Zob **ret)
+z_sum(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value +
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) + ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value +
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) + ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* -(a b) */
 ZError
-z_sub(ZList *args, Zob **ret)
+z_sub(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value -
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) - ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value -
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) - ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* *(a b) */
 ZError
-z_mul(ZList *args, Zob **ret)
+z_mul(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value *
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) * ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value *
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) * ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* /(a b) */
 ZError
-z_div(ZList *args, Zob **ret)
+z_div(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            if (((ZByte *) b)->value == 0)
+            if (ZBYTEVALUE(b) == 0)
                 return ZE_DIVISION_BY_ZERO;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value /
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) / ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            if (((ZInt *) b)->value == 0)
+            if (ZINTVALUE(b) == 0)
                 return ZE_DIVISION_BY_ZERO;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value /
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) / ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* %(a b) */
 ZError
-z_mod(ZList *args, Zob **ret)
+z_mod(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            if (((ZByte *) b)->value == 0)
+            if (ZBYTEVALUE(b) == 0)
                 return ZE_DIVISION_BY_ZERO;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value %
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) % ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            if (((ZInt *) b)->value == 0)
+            if (ZINTVALUE(b) == 0)
                 return ZE_DIVISION_BY_ZERO;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value %
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) % ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* <<(a b) */
 ZError
-z_lshift(ZList *args, Zob **ret)
+z_lshift(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value <<
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) << ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value <<
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) << ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* >>(a b) */
 ZError
-z_rshift(ZList *args, Zob **ret)
+z_rshift(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            err = znewbyte((ZByte **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZByte *) *ret)->value = ((ZByte *) a)->value >>
-                                      ((ZByte *) b)->value;
+            *ret = ZBYTE(ZBYTEVALUE(a) >> ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            err = znewint((ZInt **) ret);
-            if (err != ZE_OK)
-                return err;
-            ((ZInt *) *ret)->value = ((ZInt *) a)->value >>
-                                     ((ZInt *) b)->value;
-            return ZE_OK;
+            return zmkint(ret, ZINTVALUE(a) >> ZINTVALUE(b));
     }
     return ZE_INVALID_ARGUMENT;
 }
 
 /* ?(o) */
 ZError
-z_tst(ZList *args, Zob **ret)
+z_tst(Zob **argv, int argc, Zob **ret)
 {
     Zob *o;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    o = args->first->object;
-    ((ZBool *) *ret)->value = ztstobj(o);
+    o = argv[0];
+    *ret = ZBOOL(ztstobj(o));
     return ZE_OK;
 }
 
 /* not(o) */
 ZError
-z_not(ZList *args, Zob **ret)
+z_not(Zob **argv, int argc, Zob **ret)
 {
     Zob *o;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    o = args->first->object;
-    ((ZBool *) *ret)->value = !ztstobj(o);
+    o = argv[0];
+    *ret = ZBOOL(!ztstobj(o));
     return ZE_OK;
 }
 
 /* or(a b) */
 ZError
-z_or(ZList *args, Zob **ret)
+z_or(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    a = args->first->object;
-    b = args->first->next->object;
-    ((ZBool *) *ret)->value = ztstobj(a) || ztstobj(b);
+    a = argv[0];
+    b = argv[1];
+    *ret = ZBOOL(ztstobj(a) || ztstobj(b));
     return ZE_OK;
 }
 
 /* and(a b) */
 ZError
-z_and(ZList *args, Zob **ret)
+z_and(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    a = args->first->object;
-    b = args->first->next->object;
-    ((ZBool *) *ret)->value = ztstobj(a) && ztstobj(b);
+    a = argv[0];
+    b = argv[1];
+    *ret = ZBOOL(ztstobj(a) && ztstobj(b));
     return ZE_OK;
 }
 
 /* ==(a b) */
 ZError
-z_eq(ZList *args, Zob **ret)
+z_eq(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    a = args->first->object;
-    b = args->first->next->object;
-    ((ZBool *) *ret)->value = !zcmpobj(a, b);
+    a = argv[0];
+    b = argv[1];
+    *ret = ZBOOL(!zcmpobj(a, b));
     return ZE_OK;
 }
 
 /* !=(a b) */
 ZError
-z_neq(ZList *args, Zob **ret)
+z_neq(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    a = args->first->object;
-    b = args->first->next->object;
-    ((ZBool *) *ret)->value = zcmpobj(a, b);
+    a = argv[0];
+    b = argv[1];
+    *ret = ZBOOL(zcmpobj(a, b));
     return ZE_OK;
 }
 
 /* <(a b) */
 ZError
-z_lt(ZList *args, Zob **ret)
+z_lt(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZBool *) *ret)->value = 1;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            ((ZBool *) *ret)->value = ((ZByte *) a)->value <
-                                      ((ZByte *) b)->value;
+            *ret = ZBOOL(ZBYTEVALUE(a) < ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            ((ZBool *) *ret)->value = ((ZInt *) a)->value <
-                                      ((ZInt *) b)->value;
+            *ret = ZBOOL(ZINTVALUE(a) < ZINTVALUE(b));
             return ZE_OK;
     }
     return ZE_INVALID_ARGUMENT;
@@ -762,27 +643,20 @@ z_lt(ZList *args, Zob **ret)
 
 /* >(a b) */
 ZError
-z_gt(ZList *args, Zob **ret)
+z_gt(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZBool *) *ret)->value = 1;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            ((ZBool *) *ret)->value = ((ZByte *) a)->value >
-                                      ((ZByte *) b)->value;
+            *ret = ZBOOL(ZBYTEVALUE(a) > ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            ((ZBool *) *ret)->value = ((ZInt *) a)->value >
-                                      ((ZInt *) b)->value;
+            *ret = ZBOOL(ZINTVALUE(a) > ZINTVALUE(b));
             return ZE_OK;
     }
     return ZE_INVALID_ARGUMENT;
@@ -790,27 +664,20 @@ z_gt(ZList *args, Zob **ret)
 
 /* <=(a b) */
 ZError
-z_leq(ZList *args, Zob **ret)
+z_leq(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZBool *) *ret)->value = 1;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            ((ZBool *) *ret)->value = ((ZByte *) a)->value <=
-                                      ((ZByte *) b)->value;
+            *ret = ZBOOL(ZBYTEVALUE(a) <= ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            ((ZBool *) *ret)->value = ((ZInt *) a)->value <=
-                                      ((ZInt *) b)->value;
+            *ret = ZBOOL(ZINTVALUE(a) <= ZINTVALUE(b));
             return ZE_OK;
     }
     return ZE_INVALID_ARGUMENT;
@@ -818,27 +685,20 @@ z_leq(ZList *args, Zob **ret)
 
 /* >=(a b) */
 ZError
-z_geq(ZList *args, Zob **ret)
+z_geq(Zob **argv, int argc, Zob **ret)
 {
     Zob *a, *b;
-    ZError err;
 
-    a = args->first->object;
-    b = args->first->next->object;
-    if (*a != *b)
+    a = argv[0];
+    b = argv[1];
+    if (ZTYPE(a) != ZTYPE(b))
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    ((ZBool *) *ret)->value = 1;
-    switch (*a) {
+    switch (ZTYPE(a)) {
         case T_BYTE:
-            ((ZBool *) *ret)->value = ((ZByte *) a)->value >=
-                                      ((ZByte *) b)->value;
+            *ret = ZBOOL(ZBYTEVALUE(a) >= ZBYTEVALUE(b));
             return ZE_OK;
         case T_INT:
-            ((ZBool *) *ret)->value = ((ZInt *) a)->value >=
-                                      ((ZInt *) b)->value;
+            *ret = ZBOOL(ZINTVALUE(a) >= ZINTVALUE(b));
             return ZE_OK;
     }
     return ZE_INVALID_ARGUMENT;
@@ -846,107 +706,93 @@ z_geq(ZList *args, Zob **ret)
 
 /* node() */
 ZError
-z_node(ZList *args, Zob **ret)
+z_node(Zob **argv, int argc, Zob **ret)
 {
     return znewnable((ZNameTable **) ret);
 }
 
 /* any(list) */
 ZError
-z_any(ZList *args, Zob **ret)
+z_any(Zob **argv, int argc, Zob **ret)
 {
-    ZNode *node;
-    ZError err;
+    ZList *zlist;
+    unsigned int i;
 
-    if (*args->first->object != T_LIST)
+    if (ZTYPE(argv[0]) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    node = ((ZList *) args->first->object)->first;
-    while (node != NULL) {
-        if (ztstobj(node->object)) {
-            ((ZBool *) *ret)->value = 1;
+    zlist = (ZList *) argv[0];
+    for (i = 0; i < zlist->length; i++) {
+        if (ztstobj(ZLITEM(zlist, i))) {
+            *ret = ZBOOL(1);
             return ZE_OK;
         }
-        node = node->next;
     }
-    ((ZBool *) *ret)->value = 0;
+    *ret = ZBOOL(0);
     return ZE_OK;
 }
 
 /* all(list) */
 ZError
-z_all(ZList *args, Zob **ret)
+z_all(Zob **argv, int argc, Zob **ret)
 {
-    ZNode *node;
-    ZError err;
+    ZList *zlist;
+    unsigned int i;
 
-    if (*args->first->object != T_LIST)
+    if (ZTYPE(argv[0]) != T_LIST)
         return ZE_INVALID_ARGUMENT;
-    err = znewbool((ZBool **) ret);
-    if (err != ZE_OK)
-        return err;
-    node = ((ZList *) args->first->object)->first;
-    while (node != NULL) {
-        if (!ztstobj(node->object)) {
-            ((ZBool *) *ret)->value = 0;
+    zlist = (ZList *) argv[0];
+    for (i = 0; i < zlist->length; i++) {
+        if (!ztstobj(ZLITEM(zlist, i))) {
+            *ret = ZBOOL(0);
             return ZE_OK;
         }
-        node = node->next;
     }
-    ((ZBool *) *ret)->value = 1;
+    *ret = ZBOOL(1);
     return ZE_OK;
 }
 
 /* range(start stop step) */
 ZError
-z_range(ZList *args, Zob **ret)
+z_range(Zob **argv, int argc, Zob **ret)
 {
     Zob *zstart, *zend, *zstep;
     int counter, end, step, stepsign;
     ZError err;
 
-    zstart = args->first->object;
-    zend = args->first->next->object;
-    zstep = args->first->next->next->object;
-    if (*zstart != *zend  ||  *zstart != *zstep)
+    zstart = argv[0];
+    zend = argv[1];
+    zstep = argv[2];
+    if (ZTYPE(zstart) != ZTYPE(zend)  ||
+        ZTYPE(zstart) != ZTYPE(zstep))
         return ZE_INVALID_ARGUMENT;
     err = znewlist((ZList **) ret);
     if (err != ZE_OK)
         return err;
-    switch (*zstart) {
+    switch (ZTYPE(zstart)) {
         case T_BYTE:
-            counter = (int) ((ZByte *) zstart)->value;
-            end = (int) ((ZByte *) zend)->value;
-            step = (int) ((ZByte *) zstep)->value;
+            counter = (int) ZBYTEVALUE(zstart);
+            end = (int) ZBYTEVALUE(zend);
+            step = (int) ZBYTEVALUE(zstep);
             /* A Byte can only store positive values. */
             stepsign = 1;
             for (; counter * stepsign < end * stepsign; counter += step) {
-                ZByte *zcounter;
-
-                err = znewbyte(&zcounter);
-                if (err != ZE_OK)
-                    return err;
-                zcounter->value = (unsigned char) counter;
-                err = zlappend((ZList *) *ret, (Zob *) zcounter);
+                err = zlappend((ZList *) *ret, ZBYTE(counter));
                 if (err != ZE_OK)
                     return err;
             }
             return ZE_OK;
         case T_INT:
-            counter = ((ZInt *) zstart)->value;
-            end = ((ZInt *) zend)->value;
-            step = ((ZInt *) zstep)->value;
-            stepsign = ((ZInt *) zstep)->value < 0 ? -1 : 1;
+            counter = ZINTVALUE(zstart);
+            end = ZINTVALUE(zend);
+            step = ZINTVALUE(zstep);
+            stepsign = step < 0 ? -1 : 1;
             for (; counter * stepsign < end * stepsign; counter += step) {
-                ZInt *zcounter;
+                Zob *zcounter;
 
-                err = znewint(&zcounter);
+                err = zmkint(&zcounter, counter);
                 if (err != ZE_OK)
                     return err;
-                zcounter->value = counter;
-                err = zlappend((ZList *) *ret, (Zob *) zcounter);
+                err = zlappend((ZList *) *ret, zcounter);
                 if (err != ZE_OK)
                     return err;
             }
@@ -955,39 +801,95 @@ z_range(ZList *args, Zob **ret)
     return ZE_INVALID_ARGUMENT;
 }
 
+/* gc() */
+ZError
+z_gc(Zob **argv, int argc, Zob **ret)
+{
+    struct {
+        char *name;
+        unsigned long value;
+    } fields[4];
+    ZNameTable *stats;
+    ZGCStats gcstats;
+    Zob *value;
+    int i;
+    ZError err;
+
+    /* Dead containers may hold the last references to cycles. */
+    zdrain(ZDRAINALL);
+    fields[0].name = "freed";
+    fields[0].value = zcollect();
+    zdrain(ZDRAINALL);
+    zgcstats(&gcstats);
+    fields[1].name = "tracked";
+    fields[1].value = gcstats.tracked;
+    fields[2].name = "runs";
+    fields[2].value = gcstats.runs;
+    fields[3].name = "total";
+    fields[3].value = gcstats.freed;
+    err = znewnable(&stats);
+    if (err != ZE_OK)
+        return err;
+    for (i = 0; i < 4; i++) {
+        err = zmkint(&value, (int) fields[i].value);
+        if (err == ZE_OK)
+            err = ztset(stats, fields[i].name, value);
+        if (err != ZE_OK) {
+            zdelnable(&stats);
+            return err;
+        }
+    }
+    *ret = (Zob *) stats;
+    return ZE_OK;
+}
+
 /* arity(func) */
 ZError
-z_arity(ZList *args, Zob **ret)
+z_arity(Zob **argv, int argc, Zob **ret)
 {
+    if (ZTYPE(argv[0]) != T_FUNC)
+        return ZE_INVALID_ARGUMENT;
+    return zmkint(ret, (int) ((ZFunc *) argv[0])->arity);
+}
+
+/* next(generator defval) */
+ZError
+z_next(Zob **argv, int argc, Zob **ret)
+{
+    /* The body may move the operand stack that holds 'argv'. */
+    Zob *zgen = argv[0], *defval = argv[1];
+    Zob *item;
     ZError err;
 
-    if (*args->first->object != T_FUNC)
+    if (ZTYPE(zgen) != T_GEN)
         return ZE_INVALID_ARGUMENT;
-    err = znewint((ZInt **) ret);
+    err = zresume((ZGen *) zgen, &item);
     if (err != ZE_OK)
         return err;
-    ((ZInt *) *ret)->value = (int) ((ZFunc *) args->first->object)->arity;
+    if (item == NULL) {
+        /* The generator is done. */
+        *ret = defval;
+        return ZE_OK;
+    }
+    /* Results are not referenced by the callee, as with new objects. */
+    zdisown(item);
+    *ret = item;
     return ZE_OK;
 }
 
-/* Register 'func' in 'nable'.
+/* Register 'zlowfunc' in 'nable'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
-ZError
-regfunc(ZNameTable *nable,
-        ZError (*func)(ZList *args, Zob **ret),
-        char *name,
-        unsigned char arity)
+static ZError
+reglowfunc(ZNameTable *nable,
+           ZLowFunc *zlowfunc,
+           char *name,
+           unsigned char arity)
 {
     ZFunc *zfunc;
-    ZLowFunc *zlowfunc;
     ZError err;
 
-    err = znewlowfunc(&zlowfunc);
-    if (err != ZE_OK)
-        return err;
-    zlowfunc->func = func;
     err = znewfunc(&zfunc, (FImp *) zlowfunc, arity);
     if (err != ZE_OK) {
         zdellowfunc(&zlowfunc);
@@ -995,22 +897,73 @@ regfunc(ZNameTable *nable,
     }
     err = ztset(nable, name, (Zob *) zfunc);
     if (err != ZE_OK) {
-        zdellowfunc(&zlowfunc);
         zdelfunc(&zfunc);
         return err;
     }
     return ZE_OK;
 }
 
-/* Create a new ZNameTable with builtins names in 'builtins'.
+/* Register 'func', which takes its arguments in a ZList, in 'nable'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+regfunc(ZNameTable *nable,
+        ZError (*func)(ZList *args, Zob **ret),
+        char *name,
+        unsigned char arity)
+{
+    ZLowFunc *zlowfunc;
+    ZError err;
+
+    err = znewlowfunc(&zlowfunc);
+    if (err != ZE_OK)
+        return err;
+    zlowfunc->func = func;
+    return reglowfunc(nable, zlowfunc, name, arity);
+}
+
+/* Register 'vfunc', which takes its arguments in an array, in 'nable'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-zbuild(ZNameTable **builtins)
+regvfunc(ZNameTable *nable,
+         ZError (*vfunc)(Zob **argv, int argc, Zob **ret),
+         char *name,
+         unsigned char arity)
+{
+    ZLowFunc *zlowfunc;
+    ZError err;
+
+    err = znewlowfunc(&zlowfunc);
+    if (err != ZE_OK)
+        return err;
+    zlowfunc->vfunc = vfunc;
+    return reglowfunc(nable, zlowfunc, name, arity);
+}
+
+/* Return nonzero if 'zob' is the builtin range(),
+ *  whose values a \for loop counts instead of building them.
+ */
+int
+zisrange(Zob *zob)
+{
+    return ZTYPE(zob) == T_FUNC  &&
+           !*((ZFunc *) zob)->fimp  &&
+           ((ZLowFunc *) ((ZFunc *) zob)->fimp)->vfunc == z_range;
+}
+
+/* Create the global ZNameTable of 'zcontext' with builtins names.
+ * The builtins are immortal, owned by 'zcontext'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zbuild(ZContext *zcontext)
 {
     struct wrap {
-        ZError (*func)(ZList *args, Zob **ret);
+        ZError (*func)(Zob **argv, int argc, Zob **ret);
         char *name;
         unsigned char arity;
     } wraps[] = {
@@ -1058,21 +1011,33 @@ zbuild(ZNameTable **builtins)
       {z_all, "all", 1},
       {z_range, "range", 3},
       {z_arity, "arity", 1},
+      {z_next, "next", 2},
+      {z_gc, "gc", 0},
       {NULL, "", 0}
     };
+    ZNameTable *builtins;
+    ZEntry *zentry;
     int i;
     ZError err;
 
-    err = znewnable(builtins);
+    err = znewnable(&zcontext->global);
     if (err != ZE_OK)
         return err;
+    builtins = zcontext->global;
     for (i = 0; wraps[i].func != NULL; i++) {
-        err = regfunc(*builtins,
-                      wraps[i].func,
-                      wraps[i].name,
-                      wraps[i].arity);
+        err = regvfunc(builtins,
+                       wraps[i].func,
+                       wraps[i].name,
+                       wraps[i].arity);
+        if (err != ZE_OK)
+            return err;
+    }
+    zentry = ztfirst(builtins);
+    while (zentry != NULL) {
+        err = zkeep(zcontext, zentry->value);
         if (err != ZE_OK)
             return err;
+        zentry = ztnext(builtins, zentry);
     }
 
     return ZE_OK;
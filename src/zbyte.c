@@ -26,52 +26,13 @@
 
 #include "zbyte.h"
 
-/* Create a new ZByte in 'zbyte'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-znewbyte(ZByte **zbyte)
-{
-    *zbyte = (ZByte *) malloc(sizeof(ZByte));
-    if (*zbyte == NULL)
-        return ZE_OUT_OF_MEMORY;
-    (*zbyte)->type = T_BYTE;
-    (*zbyte)->refc = 0;
-    return ZE_OK;
-}
-
-/* Remove 'zbyte' from memory. */
-void
-zdelbyte(ZByte **zbyte)
-{
-    free(*zbyte);
-    *zbyte = NULL;
-}
-
-/* Create a new copy of 'source' in 'dest'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-zcpybyte(ZByte *source, ZByte **dest)
-{
-    ZError err;
-
-    err = znewbyte(dest);
-    if (err != ZE_OK)
-        return err;
-    (*dest)->value = source->value;
-    return ZE_OK;
-}
-
 /* Test the truth value of 'zbyte'.
- * Return 'zbyte->value'.
+ * Return its value.
  */
 int
-ztstbyte(ZByte *zbyte)
+ztstbyte(Zob *zbyte)
 {
-    return (int) zbyte->value;
+    return (int) ZBYTEVALUE(zbyte);
 }
 
 /* Compare 'zbyte' and 'other'.
@@ -79,9 +40,9 @@ ztstbyte(ZByte *zbyte)
  * Otherwise, return nonzero.
  */
 int
-zcmpbyte(ZByte *zbyte, ZByte *other)
+zcmpbyte(Zob *zbyte, Zob *other)
 {
-    if (other->value == zbyte->value)
+    if (ZBYTEVALUE(other) == ZBYTEVALUE(zbyte))
         return 0;
     else
         return 1;
@@ -91,7 +52,7 @@ zcmpbyte(ZByte *zbyte, ZByte *other)
  * Return the number of bytes writen.
  */
 int
-zrepbyte(char *buffer, size_t size, ZByte *zbyte)
+zrepbyte(char *buffer, size_t size, Zob *zbyte)
 {
-    return snprintf(buffer, size, "0x%02X", zbyte->value);
+    return snprintf(buffer, size, "0x%02X", ZBYTEVALUE(zbyte));
 }
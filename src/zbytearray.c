@@ -25,6 +25,8 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zalloc.h"
+#include "zslab.h"
 
 #include "zbyte.h"
 #include "zbytearray.h"
@@ -38,19 +40,20 @@ znewyarr(ZByteArray **zbytearray, unsigned int length)
 {
     unsigned char *array;
 
-    *zbytearray = (ZByteArray *) malloc(sizeof(ZByteArray));
+    *zbytearray = (ZByteArray *) zalloc(sizeof(ZByteArray));
     if (*zbytearray == NULL)
         return ZE_OUT_OF_MEMORY;
     if (length > 0)
-        array = (unsigned char *) malloc(length * sizeof(char));
+        array = (unsigned char *) zmalloc(length * sizeof(char));
     else
-        array = (unsigned char *) malloc(1);
+        array = (unsigned char *) zmalloc(1);
     if (array == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zbytearray)->type = T_YARR;
     (*zbytearray)->length = length;
     (*zbytearray)->bytes = array;
     (*zbytearray)->refc = 0;
+    (*zbytearray)->shared = 0;
     return ZE_OK;
 }
 
@@ -66,10 +69,10 @@ zyarrfromstr(ZByteArray **zbytearray, char *s)
     size_t length;
 
     length = strlen(s);
-    *zbytearray = (ZByteArray *) malloc(sizeof(ZByteArray));
+    *zbytearray = (ZByteArray *) zalloc(sizeof(ZByteArray));
     if (*zbytearray == NULL)
         return ZE_OUT_OF_MEMORY;
-    array = (unsigned char *) malloc((length + 1) * sizeof(char));
+    array = (unsigned char *) zmalloc((length + 1) * sizeof(char));
     if (array == NULL)
         return ZE_OUT_OF_MEMORY;
     strcpy((char *) array, s);
@@ -77,6 +80,7 @@ zyarrfromstr(ZByteArray **zbytearray, char *s)
     (*zbytearray)->length = (unsigned int) length;
     (*zbytearray)->bytes = array;
     (*zbytearray)->refc = 0;
+    (*zbytearray)->shared = 0;
     return ZE_OK;
 }
 
@@ -84,9 +88,10 @@ zyarrfromstr(ZByteArray **zbytearray, char *s)
 void
 zdelyarr(ZByteArray **zbytearray)
 {
-    free((*zbytearray)->bytes);
+    if (!(*zbytearray)->shared)
+        zmfree((*zbytearray)->bytes);
     (*zbytearray)->bytes = NULL;
-    free(*zbytearray);
+    zfree(*zbytearray, sizeof(ZByteArray));
     *zbytearray = NULL;
 }
 
@@ -108,6 +113,54 @@ zcpyyarr(ZByteArray *source, ZByteArray **dest)
     return ZE_OK;
 }
 
+/* Create in 'dest' a new ZByteArray with the bytes of 'source',
+ *  which must outlive it, until either is changed.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zshareyarr(ZByteArray *source, ZByteArray **dest)
+{
+    *dest = (ZByteArray *) zalloc(sizeof(ZByteArray));
+    if (*dest == NULL)
+        return ZE_OUT_OF_MEMORY;
+    (*dest)->type = T_YARR;
+    (*dest)->length = source->length;
+    (*dest)->bytes = source->bytes;
+    (*dest)->refc = 0;
+    (*dest)->shared = 1;
+    return ZE_OK;
+}
+
+/* Make room for 'extra' more bytes in 'zbytearray', taking a copy
+ *  of its bytes if they are shared.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zownyarr(ZByteArray *zbytearray, unsigned int extra)
+{
+    unsigned char *array;
+
+    if (zbytearray->shared) {
+        array = (unsigned char *) zmalloc(zbytearray->length + extra + 1);
+        if (array == NULL)
+            return ZE_OUT_OF_MEMORY;
+        memcpy(array, zbytearray->bytes, zbytearray->length);
+        zbytearray->shared = 0;
+    }
+    else if (extra > 0) {
+        array = (unsigned char *) zrealloc(zbytearray->bytes,
+                                           zbytearray->length + extra);
+        if (array == NULL)
+            return ZE_OUT_OF_MEMORY;
+    }
+    else
+        return ZE_OK;
+    zbytearray->bytes = array;
+    return ZE_OK;
+}
+
 /* Test the truth value of 'zbytearray'.
  * If 'zbytearray' is empty, return zero.
  * Otherwise, return nonzero.
@@ -140,6 +193,20 @@ zcmpyarr(ZByteArray *zbytearray, ZByteArray *other)
     }
 }
 
+/* Return the FNV-1a hash of the bytes of 'zbytearray'. */
+unsigned int
+zhashyarr(ZByteArray *zbytearray)
+{
+    unsigned int hash = 2166136261U;
+    unsigned int index;
+
+    for (index = 0; index < zbytearray->length; index++) {
+        hash ^= zbytearray->bytes[index];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
 /* Print the textual representation of 'zbytearray' on 'buffer'.
  * Return the number of bytes writen.
  */
@@ -201,35 +268,37 @@ zalength(ZByteArray *zbytearray)
 }
 
 /* Copy the 'index'-th ZByte of 'zbytearray' to 'value'.
- * 'value' must be preallocated with znewbyte().
  * If 'index' is negative, use zalength('zbytearray') + 'index'.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
  * Otherwise, return ZE_OK.
  */
 ZError
-zaget(ZByteArray *zbytearray, int index, ZByte **value)
+zaget(ZByteArray *zbytearray, int index, Zob **value)
 {
     if (index < 0)
         index += zbytearray->length;
     if (index < 0 || index >= (int) zbytearray->length)
         return ZE_INDEX_OUT_OF_RANGE;
-    (*value)->value = zbytearray->bytes[index];
+    *value = ZBYTE(zbytearray->bytes[index]);
     return ZE_OK;
 }
 
 /* Copy 'zbyte' to the 'index'-th ZByte of 'zbytearray'.
  * If 'index' is negative, use zalength('zbytearray') + 'index'.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-zaset(ZByteArray *zbytearray, int index, ZByte *zbyte)
+zaset(ZByteArray *zbytearray, int index, Zob *zbyte)
 {
     if (index < 0)
         index += zbytearray->length;
     if (index < 0 || index >= (int) zbytearray->length)
         return ZE_INDEX_OUT_OF_RANGE;
-    zbytearray->bytes[index] = zbyte->value;
+    if (zownyarr(zbytearray, 0) != ZE_OK)
+        return ZE_OUT_OF_MEMORY;
+    zbytearray->bytes[index] = ZBYTEVALUE(zbyte);
     return ZE_OK;
 }
 
@@ -245,9 +314,7 @@ zconcatstr(ZByteArray *zbytearray, char *s)
     length = strlen(s);
     if (length == 0)
         return ZE_OK;
-    zbytearray->bytes = realloc(zbytearray->bytes,
-                                zbytearray->length + length);
-    if (zbytearray->bytes == NULL)
+    if (zownyarr(zbytearray, (unsigned int) length) != ZE_OK)
         return ZE_OUT_OF_MEMORY;
     memcpy(zbytearray->bytes + zbytearray->length, s, length);
     zbytearray->length += (unsigned int) length;
@@ -263,9 +330,7 @@ zconcat(ZByteArray *zbytearray, ZByteArray *other)
 {
     if (other->length == 0)
         return ZE_OK;
-    zbytearray->bytes = realloc(zbytearray->bytes,
-                                zbytearray->length + other->length);
-    if (zbytearray->bytes == NULL)
+    if (zownyarr(zbytearray, other->length) != ZE_OK)
         return ZE_OUT_OF_MEMORY;
     memcpy(zbytearray->bytes + zbytearray->length,
            other->bytes,
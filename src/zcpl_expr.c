@@ -25,12 +25,16 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zgc.h"
+#include "zalloc.h"
 
 #include "zbyte.h"
 #include "zbignum.h"
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
 #include "zdict.h"
+#include "zfunc.h"
 
 #include "zruntime.h"
 
@@ -41,6 +45,122 @@
  * -Hex char (\xhh) in cpl_asciibyte() and cpl_bytearray().
  */
 
+/* Local names of the function being compiled, NULL at module level. */
+static CplScope *curscope = NULL;
+
+/* Create a new scope without names.
+ * If there is not enough memory, return NULL.
+ */
+CplScope *
+cpl_newscope()
+{
+    CplScope *scope;
+
+    scope = (CplScope *) malloc(sizeof(CplScope));
+    if (scope == NULL)
+        return NULL;
+    scope->names = NULL;
+    scope->length = 0;
+    scope->size = 0;
+    scope->self = -1;
+    scope->yields = 0;
+    return scope;
+}
+
+/* Remove 'scope' from memory. */
+void
+cpl_delscope(CplScope *scope)
+{
+    int i;
+
+    for (i = 0; i < scope->length; i++)
+        free(scope->names[i]);
+    free(scope->names);
+    free(scope);
+}
+
+/* Return the slot of the first 'length' characters of 'name' in 'scope',
+ *  or -1 if they are not a local name.
+ */
+int
+cpl_findname(CplScope *scope, char *name, unsigned int length)
+{
+    int i;
+
+    for (i = 0; i < scope->length; i++)
+        if (strlen(scope->names[i]) == length  &&
+            strncmp(scope->names[i], name, length) == 0)
+            return i;
+    return -1;
+}
+
+/* Give the first 'length' characters of 'name' a slot in 'scope'.
+ * If there is not enough memory, return zero.
+ * Otherwise, return nonzero.
+ */
+int
+cpl_addname(CplScope *scope, char *name, unsigned int length)
+{
+    char *copy;
+
+    if (cpl_findname(scope, name, length) >= 0)
+        return 1;
+    if (scope->length == scope->size) {
+        int size = scope->size == 0 ? 16 : scope->size * 2;
+        char **names;
+
+        names = (char **) realloc(scope->names, size * sizeof(char *));
+        if (names == NULL)
+            return 0;
+        scope->names = names;
+        scope->size = size;
+    }
+    copy = (char *) malloc(length + 1);
+    if (copy == NULL)
+        return 0;
+    strncpy(copy, name, length);
+    copy[length] = '\0';
+    if (strcmp(copy, "@") == 0)
+        scope->self = scope->length;
+    scope->names[scope->length] = copy;
+    scope->length++;
+    return 1;
+}
+
+/* Compile names against 'scope' from now on. */
+void
+cpl_setscope(CplScope *scope)
+{
+    curscope = scope;
+}
+
+/* Compile the first 'length' characters of 'name' to 'bin'.
+ * A name whose first component is local is prefixed by its slot,
+ *  or by MAXLOCALS if it has none.
+ */
+unsigned int
+cpl_name(char *name, unsigned int length, char *bin)
+{
+    unsigned int head, total = 0;
+    int slot;
+
+    if (curscope != NULL) {
+        for (head = 0; head < length && name[head] != '.'; head++);
+        slot = cpl_findname(curscope, name, head);
+        if (slot >= 0) {
+            if (slot > MAXLOCALS)
+                slot = MAXLOCALS;
+            bin[0] = LOCAL;
+            bin[1] = (char) (0x80 | slot);
+            bin += 2;
+            total += 2;
+        }
+    }
+    memcpy(bin, name, length);
+    bin[length] = '\0';
+    return total + length + 1;
+}
+
 int
 is_separator(char c)
 {
@@ -246,13 +366,9 @@ cpl_func(char **expr, char *bin)
 
     *bin = '\xF0';
     args = strchr(*expr, '(');
-    total = (int) (args - *expr);
-    strncpy(bin + 1, *expr, total);
-    bin += total + 1;
-    *expr += total;
-    *bin = '\x00';
-    bin++;
-    (*expr)++;
+    total = cpl_name(*expr, (unsigned int) (args - *expr), bin + 1) + 1;
+    bin += total;
+    *expr = args + 1;
     while (**expr != ')') {
         length = cpl_expr(expr, bin);
         skip_space(expr);
@@ -261,7 +377,7 @@ cpl_func(char **expr, char *bin)
     }
     (*expr)++;
     *bin = '\xF1';
-    return total + 3;
+    return total + 1;
 }
 
 unsigned int
@@ -333,10 +449,9 @@ cpl_expr(char **expr, char *bin)
                         c++;
                         length++;
                     }
-                    strncpy(bin, *expr, length);
+                    c = *expr;
                     *expr += length;
-                    bin[length] = '\x00';
-                    return (unsigned int) length + 1;
+                    return cpl_name(c, length, bin);
                 }
             }
     }
@@ -454,7 +569,7 @@ cpl_stt(char **pstt, char *bin)
             }
         }
         else {
-            strncpy(bin, assign, strlen(assign) + 1);
+            memcpy(bin, assign, strlen(assign) + 1);
             bin += strlen(assign) + 1;
             total += strlen(assign) + 1;
         }
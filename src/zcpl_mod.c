@@ -27,6 +27,9 @@
 
 #include "zcpl_expr.h"
 
+/* Lines are read in 256-byte chunks, so blocks cannot nest deeper. */
+#define MAXDEPTH 256
+
 void
 hidequoted(char *str, char *quoted)
 {
@@ -109,16 +112,216 @@ remtail(char *str)
     showquoted(str, quoted);
 }
 
+/* Write a placeholder for the length of the block just opened
+ *  and save its position in 'lenpos'.
+ */
+void
+openblock(FILE *fbin, long *lenpos)
+{
+    *lenpos = ftell(fbin);
+    fwrite("\0\0\0\0", 1, 4, fbin);
+}
+
+/* Compile the end of the block opened at 'lenpos'
+ *  and fill in its length.
+ */
+void
+closeblock(FILE *fbin, long lenpos)
+{
+    long endpos;
+    unsigned long length;
+    unsigned char word[4];
+
+    fwrite("\xBE\x01", 1, 2, fbin);
+    endpos = ftell(fbin);
+    length = (unsigned long) (endpos - lenpos - 4);
+    word[0] = (unsigned char) (length >> 24);
+    word[1] = (unsigned char) (length >> 16);
+    word[2] = (unsigned char) (length >> 8);
+    word[3] = (unsigned char) length;
+    fseek(fbin, lenpos, SEEK_SET);
+    fwrite(word, 1, 4, fbin);
+    fseek(fbin, endpos, SEEK_SET);
+}
+
+/* Compile the assignment 'assign', a name or a list pattern. */
+void
+cplassign(FILE *fbin, char *assign)
+{
+    char bin[256];
+    unsigned int length;
+
+    if (*assign == '(') {
+        int depth = 1;
+        int namelen;
+        char *namechar;
+
+        fwrite("\x10", 1, 1, fbin);
+        assign++;
+        while (depth > 0) {
+            skip_space(&assign);
+            if (*assign == '(') {
+                fwrite("\x10", 1, 1, fbin);
+                depth++;
+                assign++;
+                continue;
+            }
+            namechar = assign;
+            namelen = 0;
+            while (!isspace(*namechar) && *namechar != ')') {
+                namechar++;
+                namelen++;
+            }
+            length = cpl_name(assign, namelen, bin);
+            fwrite(bin, 1, length, fbin);
+            assign += namelen;
+            skip_space(&assign);
+            while (*assign == ')') {
+                fwrite("\x01", 1, 1, fbin);
+                depth--;
+                assign++;
+                skip_space(&assign);
+            }
+        }
+    }
+    else {
+        length = cpl_name(assign, strlen(assign), bin);
+        fwrite(bin, 1, length, fbin);
+    }
+}
+
+/* Add the names assigned by 'assign' to 'scope'.
+ * If there is not enough memory, return zero.
+ * Otherwise, return nonzero.
+ */
+int
+scanassign(CplScope *scope, char *assign)
+{
+    char *name;
+
+    while (*assign != '\0') {
+        if (*assign == '(' || *assign == ')' || isspace(*assign)) {
+            assign++;
+            continue;
+        }
+        name = assign;
+        while (*assign != '\0' && *assign != '(' && *assign != ')' &&
+               !isspace(*assign))
+            assign++;
+        /* Dotted names are stored in nodes. */
+        if (memchr(name, '.', assign - name) == NULL)
+            if (!cpl_addname(scope, name, assign - name))
+                return 0;
+    }
+    return 1;
+}
+
+/* Collect the local names of a function body, which starts at the
+ *  current position of 'fsrc'.
+ * 'ident' is the identation of the function header
+ *  and 'params' points to its parameters.
+ * If there is not enough memory, return NULL.
+ * Otherwise, return the new scope.
+ */
+CplScope *
+scanscope(FILE *fsrc, int ident, char *params)
+{
+    CplScope *scope;
+    char line[256], hidden[256], quoted[256], splitbuffer[256];
+    char *parts[16];
+    char *stt, *name;
+    long pos;
+    int lident, splitlen, i;
+    int inner = -1, ok = 1;
+
+    scope = cpl_newscope();
+    if (scope == NULL)
+        return NULL;
+    /* Parameters take the first slots. */
+    while (ok && *params != ')') {
+        skip_space(&params);
+        name = params;
+        while (!is_separator(*params))
+            params++;
+        if (params > name)
+            ok = cpl_addname(scope, name, params - name);
+        skip_space(&params);
+    }
+    pos = ftell(fsrc);
+    while (ok && fgets(line, 256, fsrc) != NULL) {
+        remtail(line);
+        if (strlen(line) == 0)
+            continue;
+        lident = 0;
+        stt = line;
+        while (isspace(*stt)) {
+            stt++;
+            lident++;
+        }
+        if (lident <= ident)
+            /* End of function body. */
+            break;
+        if (inner >= 0) {
+            if (lident > inner)
+                /* Body of a nested function. */
+                continue;
+            inner = -1;
+        }
+        strcpy(hidden, stt);
+        hidequoted(hidden, quoted);
+        if (strchr(hidden, '@') != NULL)
+            ok = cpl_addname(scope, "@", 1);
+        if (strncmp(stt, "\\def", 4) == 0) {
+            name = stt + 4;
+            skip_space(&name);
+            for (i = 0; name[i] != '(' && name[i] != '\0'; i++);
+            if (ok && memchr(name, '.', i) == NULL)
+                ok = cpl_addname(scope, name, i);
+            inner = lident;
+        }
+        else if (strncmp(stt, "\\yield", 6) == 0)
+            scope->yields = 1;
+        else if (strncmp(stt, "\\for", 4) == 0) {
+            /* Loop names sit between the keyword and the source. */
+            splitlen = splitstt(stt, splitbuffer, parts);
+            for (i = 1; ok && i < splitlen - 1; i++)
+                ok = scanassign(scope, parts[i]);
+        }
+        else if (*stt != '\\') {
+            splitlen = splitstt(stt, splitbuffer, parts);
+            for (i = 0; ok && i < splitlen - 1; i++)
+                ok = scanassign(scope, parts[i]);
+        }
+    }
+    fseek(fsrc, pos, SEEK_SET);
+    if (!ok) {
+        cpl_delscope(scope);
+        return NULL;
+    }
+    return scope;
+}
+
+/* Remove the scope of the block at 'level', if the block has its own. */
+void
+dropscope(CplScope *scopes[], int level)
+{
+    if (scopes[level] != scopes[level - 1])
+        cpl_delscope(scopes[level]);
+}
+
 int
 cpl_mod(char *srcname)
 {
     FILE *fsrc, *fbin;
     char *binname, *expr_entry, *def, *ext;
-    char *assign, *stt;
+    char *stt;
     char line[256], bin[256], splitbuffer[256];
     char *parts[16];
+    long blocks[MAXDEPTH + 1];
+    CplScope *scopes[MAXDEPTH + 2];
     unsigned int length, linum;
-    int identlevel, identwidth, ident, splitlen;
+    int identlevel, identwidth, ident, splitlen, slots, self;
+    int failed = 0;
 
     fsrc = fopen(srcname, "r");
     if (fsrc == NULL) {
@@ -145,6 +348,11 @@ cpl_mod(char *srcname)
         binname = NULL;
         return 0;
     }
+    /* Compile header: magic and version. */
+    fwrite("ZBC\x06", 1, 4, fbin);
+    /* Module level names are global. */
+    scopes[0] = NULL;
+    cpl_setscope(NULL);
     identlevel = 0;
     identwidth = 0;
     for (linum = 1; fgets(line, 256, fsrc) != NULL; linum++) {
@@ -164,25 +372,33 @@ cpl_mod(char *srcname)
             level = ident / identwidth;
             if (ident % identwidth != 0) {
                 zraisecpl("Incorrect identation.", srcname, linum);
+                failed = 1;
                 break;
             }
             if (level > identlevel) {
                 zraisecpl("Incorrect identation.", srcname, linum);
+                failed = 1;
                 break;
             }
-            for (; level < identlevel; identlevel--)
+            for (; level < identlevel; identlevel--) {
                 /* Compile end of block. */
-                fwrite("\xBE\x01", 1, 2, fbin);
+                closeblock(fbin, blocks[identlevel]);
+                dropscope(scopes, identlevel);
+            }
+            cpl_setscope(scopes[identlevel]);
         }
         else if (identlevel > 0) {
             /* Define identation width. */
             if (ident == 0) {
                 zraisecpl("Incorrect identation.", srcname, linum);
+                failed = 1;
                 break;
             }
             else
                 identwidth = ident;
         }
+        /* A new block shares the scope, unless it is a function. */
+        scopes[identlevel + 1] = scopes[identlevel];
         splitlen = splitstt(stt, splitbuffer, parts);
         expr_entry = parts[splitlen - 1];
         if (*parts[0] == '\\') {
@@ -192,7 +408,8 @@ cpl_mod(char *srcname)
                 for (splitlen -= 1; splitlen > 0; splitlen--) {
                     char *name = parts[splitlen];
 
-                    fwrite(name, 1, strlen(name) + 1, fbin);
+                    length = cpl_name(name, strlen(name), bin);
+                    fwrite(bin, 1, length, fbin);
                 }
                 fwrite("\0", 1, 1, fbin);
             }
@@ -236,17 +453,50 @@ cpl_mod(char *srcname)
                     fwrite(bin, 1, length, fbin);
                 }
             }
+            else if (strcmp(parts[0], "\\yield") == 0) {
+                if (scopes[identlevel] == NULL) {
+                    zraisecpl("Yield outside of function.", srcname,
+                              linum);
+                    failed = 1;
+                    break;
+                }
+                if (splitlen == 1) {
+                    /* Compile yield NONE. */
+                    fwrite("\xEE\x01", 1, 2, fbin);
+                }
+                else {
+                    /* Compile yield statement. */
+                    fwrite("\xEE", 1, 1, fbin);
+                    length = cpl_expr(&expr_entry, bin);
+                    fwrite(bin, 1, length, fbin);
+                }
+            }
             else if (strcmp(parts[0], "\\while") == 0) {
                 /* Compile while block header. */
                 identlevel++;
                 fwrite("\xB0\x04", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
                 length = cpl_expr(&expr_entry, bin);
                 fwrite(bin, 1, length, fbin);
             }
+            else if (strcmp(parts[0], "\\for") == 0) {
+                /* Compile for block header: the source, then the
+                 *  assignments of each item, as in a statement.
+                 */
+                identlevel++;
+                fwrite("\xB0\x06", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
+                length = cpl_expr(&expr_entry, bin);
+                fwrite(bin, 1, length, fbin);
+                for (splitlen -= 1; splitlen > 1; splitlen--)
+                    cplassign(fbin, parts[splitlen - 1]);
+                fwrite("\0", 1, 1, fbin);
+            }
             else if (strcmp(parts[0], "\\if") == 0) {
                 /* Compile if block header. */
                 identlevel++;
                 fwrite("\xB0\x01", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
                 length = cpl_expr(&expr_entry, bin);
                 fwrite(bin, 1, length, fbin);
             }
@@ -254,6 +504,7 @@ cpl_mod(char *srcname)
                 /* Compile elif block header. */
                 identlevel++;
                 fwrite("\xB0\x02", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
                 length = cpl_expr(&expr_entry, bin);
                 fwrite(bin, 1, length, fbin);
             }
@@ -261,18 +512,28 @@ cpl_mod(char *srcname)
                 /* Compile else block header. */
                 identlevel++;
                 fwrite("\xB0\x03", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
             }
             else if (strcmp(parts[0], "\\def") == 0) {
-                /* Compile function definition header. */
+                /* Compile function definition header.
+                 * A body that yields makes a generator function.
+                 */
                 identlevel++;
-                fwrite("\xB0\x05", 1, 2, fbin);
-                def = parts[1];
-                while (*def != '(') {
-                    fwrite(def, 1, 1, fbin);
-                    def++;
+                def = strchr(parts[1], '(') + 1;
+                scopes[identlevel] = scanscope(fsrc, ident, def);
+                if (scopes[identlevel] == NULL) {
+                    zraiseOutOfMemory("cpl_mod");
+                    identlevel--;
+                    failed = 1;
+                    break;
                 }
-                fwrite("\0", 1, 1, fbin);
-                def++;
+                if (scopes[identlevel]->yields)
+                    fwrite("\xB0\x07", 1, 2, fbin);
+                else
+                    fwrite("\xB0\x05", 1, 2, fbin);
+                openblock(fbin, &blocks[identlevel]);
+                length = cpl_name(parts[1], def - 1 - parts[1], bin);
+                fwrite(bin, 1, length, fbin);
                 while (*def != ')') {
                     skip_space(&def);
                     while (!is_separator(*def)) {
@@ -283,66 +544,47 @@ cpl_mod(char *srcname)
                     skip_space(&def);
                 }
                 fwrite("\0", 1, 1, fbin);
+                /* Compile frame size and slot of "@" (0xFF if unused).
+                 * Names past the frame slots share the last slot value.
+                 */
+                slots = scopes[identlevel]->length;
+                self = scopes[identlevel]->self;
+                bin[0] = (char) (slots > MAXLOCALS ? MAXLOCALS : slots);
+                bin[1] = (char) (self > MAXLOCALS ? MAXLOCALS : self);
+                fwrite(bin, 1, 2, fbin);
+                cpl_setscope(scopes[identlevel]);
             }
             else {
                 zraisecpl("Unknown instruction.", srcname, linum);
+                failed = 1;
                 break;
             }
         }
         else {
             length = cpl_expr(&expr_entry, bin);
             fwrite(bin, 1, length, fbin);
-            for (splitlen -= 1; splitlen > 0; splitlen--) {
+            for (splitlen -= 1; splitlen > 0; splitlen--)
                 /* Compile Assignments. */
-                assign = parts[splitlen - 1];
-                if (*assign == '(') {
-                    int depth = 1;
-                    int namelen;
-                    char *namechar;
-
-                    fwrite("\x10", 1, 1, fbin);
-                    assign++;
-                    while (depth > 0) {
-                        skip_space(&assign);
-                        if (*assign == '(') {
-                            fwrite("\x10", 1, 1, fbin);
-                            depth++;
-                            assign++;
-                            continue;
-                        }
-                        namechar = assign;
-                        namelen = 0;
-                        while (!isspace(*namechar) && *namechar != ')') {
-                            namechar++;
-                            namelen++;
-                        }
-                        fwrite(assign, 1, namelen, fbin);
-                        fwrite("\0", 1, 1, fbin);
-                        assign += namelen;
-                        skip_space(&assign);
-                        while (*assign == ')') {
-                            fwrite("\x01", 1, 1, fbin);
-                            depth--;
-                            assign++;
-                            skip_space(&assign);
-                        }
-                    }
-                }
-                else
-                    fwrite(assign, 1, strlen(assign) + 1, fbin);
-            }
+                cplassign(fbin, parts[splitlen - 1]);
             fwrite("\0", 1, 1, fbin);
         }
     }
     fclose(fsrc);
     /* Block End. */
-    while (identlevel >= 0) {
-        fwrite("\xBE\x01", 1, 2, fbin);
-        identlevel--;
+    for (; identlevel > 0; identlevel--) {
+        if (!failed)
+            closeblock(fbin, blocks[identlevel]);
+        dropscope(scopes, identlevel);
     }
+    if (!failed)
+        fwrite("\xBE\x01", 1, 2, fbin);
+    cpl_setscope(NULL);
     fclose(fbin);
+    /* A partial program must not be run later. */
+    if (failed)
+        remove(binname);
     free(binname);
     binname = NULL;
 
-    return 1;
+    return !failed;
 }
@@ -20,37 +20,115 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ztypes.h"
 #include "zerr.h"
 #include "zgc.h"
+#include "zalloc.h"
+#include "zslab.h"
 
-#include "zlist.h"
 #include "zdict.h"
 
 #include "zobject.h"
 
-/* A ZDict object holds a zlist where each pair of items is a
- * key-value pair (i.e. ["a", 1, "b", 2] -> {"a": 1, "b": 2}).
+/* Return the position of the index slot of 'key' in 'zdict',
+ *  or -1 if 'key' is not in 'zdict'.
+ * 'hash' must be zdhash('key').
  */
+static int
+zdslot(ZDict *zdict, Zob *key, unsigned int hash)
+{
+    unsigned int mask = zdict->size - 1;
+    unsigned int i;
+    int pos;
+
+    if (zdict->size == 0)
+        return -1;
+    i = hash & mask;
+    while ((pos = zdict->index[i]) != DFREE) {
+        if (pos != DDUMMY  &&
+            zdict->pairs[pos].hash == hash  &&
+            zcmpobj(zdict->pairs[pos].key, key) == 0)
+            return (int) i;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+/* Return the hash of 'key', scrambled for the index table. */
+static unsigned int
+zdhash(Zob *key)
+{
+    unsigned int hash = zhashobj(key) * 2654435769U;
+
+    return hash ^ (hash >> 16);
+}
+
+/* Rebuild 'zdict' with an index table of 'size' slots,
+ *  dropping removed pairs. The order of pairs is kept.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zdresize(ZDict *zdict, unsigned int size)
+{
+    ZPair *pairs;
+    int *index;
+    unsigned int i, j, n = 0;
+
+    pairs = (ZPair *) zmalloc(size / 4 * 3 * sizeof(ZPair));
+    if (pairs == NULL)
+        return ZE_OUT_OF_MEMORY;
+    index = (int *) zmalloc(size * sizeof(int));
+    if (index == NULL) {
+        zmfree(pairs);
+        return ZE_OUT_OF_MEMORY;
+    }
+    for (j = 0; j < size; j++)
+        index[j] = DFREE;
+    for (i = 0; i < zdict->npairs; i++) {
+        if (zdict->pairs[i].key == NULL)
+            continue;
+        pairs[n] = zdict->pairs[i];
+        j = pairs[n].hash & (size - 1);
+        while (index[j] != DFREE)
+            j = (j + 1) & (size - 1);
+        index[j] = (int) n++;
+    }
+    zmfree(zdict->pairs);
+    zmfree(zdict->index);
+    zdict->pairs = pairs;
+    zdict->index = index;
+    zdict->size = size;
+    zdict->npairs = n;
+    return ZE_OK;
+}
 
 /* Create a new ZDict in 'zdict'.
+ * Storage is only allocated on the first definition.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 znewdict(ZDict **zdict)
 {
-    ZError err;
-
-    *zdict = (ZDict *) malloc(sizeof(ZDict));
+    *zdict = (ZDict *) zalloc(sizeof(ZDict));
     if (*zdict == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zdict)->type = T_DICT;
-    err = znewlist(&(*zdict)->zlist);
-    if (err != ZE_OK)
-        return err;
     (*zdict)->refc = 0;
+    (*zdict)->length = 0;
+    (*zdict)->npairs = 0;
+    (*zdict)->pairs = NULL;
+    (*zdict)->size = 0;
+    (*zdict)->index = NULL;
+    (*zdict)->share = NULL;
+    if (ztrack((Zob *) *zdict) != ZE_OK) {
+        zfree(*zdict, sizeof(ZDict));
+        *zdict = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
     return ZE_OK;
 }
 
@@ -58,12 +136,66 @@ znewdict(ZDict **zdict)
 void
 zdeldict(ZDict **zdict)
 {
-    zdellist(&(*zdict)->zlist);
-    free(*zdict);
+    zuntrack((Zob *) *zdict);
+    zdempty(*zdict);
+    zmfree((*zdict)->pairs);
+    zmfree((*zdict)->index);
+    zfree(*zdict, sizeof(ZDict));
     *zdict = NULL;
 }
 
+/* Copy the pairs of 'zdict' in memory to new 'pairs' and 'index'
+ *  of the same sizes.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zdcopypairs(ZDict *zdict, ZPair **pairs, int **index)
+{
+    unsigned int i;
+    ZError err;
+
+    *pairs = (ZPair *) zmalloc(zdict->size / 4 * 3 * sizeof(ZPair));
+    if (*pairs == NULL)
+        return ZE_OUT_OF_MEMORY;
+    *index = (int *) zmalloc(zdict->size * sizeof(int));
+    if (*index == NULL) {
+        zmfree(*pairs);
+        return ZE_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < zdict->npairs; i++) {
+        (*pairs)[i] = zdict->pairs[i];
+        if (zdict->pairs[i].key == NULL)
+            continue;
+        err = zcpyobj(zdict->pairs[i].key, &(*pairs)[i].key);
+        if (err == ZE_OK) {
+            zincrefc((*pairs)[i].key);
+            err = zcpyobj(zdict->pairs[i].value, &(*pairs)[i].value);
+            if (err != ZE_OK)
+                zdecrefc((*pairs)[i].key);
+        }
+        if (err != ZE_OK) {
+            while (i > 0) {
+                if ((*pairs)[--i].key == NULL)
+                    continue;
+                zdecrefc((*pairs)[i].key);
+                zdecrefc((*pairs)[i].value);
+            }
+            zmfree(*pairs);
+            zmfree(*index);
+            return err;
+        }
+        zincrefc((*pairs)[i].value);
+    }
+    memcpy(*index, zdict->index, zdict->size * sizeof(int));
+    return ZE_OK;
+}
+
 /* Create a new copy of 'source' in 'dest'.
+ * Keys and values are duplicated in memory, i.e.,
+ * pairs in 'dest' do not share reference with pairs in 'source'.
+ * That is only done by zdown(), when needed: until then, 'dest' shares
+ *  the pairs and index of 'source', unless zsharable() does not allow it.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
@@ -72,14 +204,53 @@ zcpydict(ZDict *source, ZDict **dest)
 {
     ZError err;
 
-    *dest = (ZDict *) malloc(sizeof(ZDict));
-    if (*dest == NULL)
-        return ZE_OUT_OF_MEMORY;
-    (*dest)->type = T_DICT;
-    err = zcpylist(source->zlist, &(*dest)->zlist);
+    err = znewdict(dest);
+    if (err != ZE_OK  ||  source->length == 0)
+        return err;
+    if (zsharable((Zob *) source)) {
+        err = zshare((Zob *) source, (Zob *) *dest);
+        (*dest)->pairs = source->pairs;
+        (*dest)->index = source->index;
+    }
+    else
+        err = zdcopypairs(source, &(*dest)->pairs, &(*dest)->index);
+    if (err != ZE_OK) {
+        (*dest)->pairs = NULL;
+        (*dest)->index = NULL;
+        zdeldict(dest);
+        return err;
+    }
+    (*dest)->length = source->length;
+    (*dest)->npairs = source->npairs;
+    (*dest)->size = source->size;
+    return ZE_OK;
+}
+
+/* Give 'zdict' pairs and index of its own, if it shares them with copies,
+ *  duplicating the keys and values in memory as zcpydict() promises.
+ * Call it before changing 'zdict' or giving away one of its keys or values.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zdown(ZDict *zdict)
+{
+    ZPair *pairs;
+    int *index;
+    ZError err;
+
+    if (zdict->share == NULL)
+        return ZE_OK;
+    if (zdict->share->count == 1) {
+        (void) zunshare((Zob *) zdict);
+        return ZE_OK;
+    }
+    err = zdcopypairs(zdict, &pairs, &index);
     if (err != ZE_OK)
         return err;
-    (*dest)->refc = 0;
+    (void) zunshare((Zob *) zdict);
+    zdict->pairs = pairs;
+    zdict->index = index;
     return ZE_OK;
 }
 
@@ -90,20 +261,53 @@ zcpydict(ZDict *source, ZDict **dest)
 int
 ztstdict(ZDict *zdict)
 {
-    if (zdict->zlist->length)
+    if (zdict->length)
         return 1;
     else
         return 0;
 }
 
 /* Compare 'zdict' and 'other'.
+ * Pairs are compared in insertion order.
  * If they are equal, return zero.
  * Otherwise, return nonzero.
  */
 int
 zcmpdict(ZDict *zdict, ZDict *other)
 {
-    return zcmplist(zdict->zlist, other->zlist);
+    unsigned int i = 0, j = 0;
+
+    if (zdict->length != other->length)
+        return 1;
+    while (1) {
+        while (i < zdict->npairs && zdict->pairs[i].key == NULL)
+            i++;
+        while (j < other->npairs && other->pairs[j].key == NULL)
+            j++;
+        if (i == zdict->npairs || j == other->npairs)
+            return 0;
+        if (zcmpobj(zdict->pairs[i].key, other->pairs[j].key) ||
+            zcmpobj(zdict->pairs[i].value, other->pairs[j].value))
+            return 1;
+        i++;
+        j++;
+    }
+}
+
+/* Return the hash of 'zdict', combining its pairs in insertion order. */
+unsigned int
+zhashdict(ZDict *zdict)
+{
+    unsigned int hash = zdict->length;
+    unsigned int i;
+
+    for (i = 0; i < zdict->npairs; i++) {
+        if (zdict->pairs[i].key == NULL)
+            continue;
+        hash = hash * 31 + zhashobj(zdict->pairs[i].key);
+        hash = hash * 31 + zhashobj(zdict->pairs[i].value);
+    }
+    return hash;
 }
 
 /* Print the textual representation of 'zdict' on 'buffer'.
@@ -112,40 +316,30 @@ zcmpdict(ZDict *zdict, ZDict *other)
 int
 zrepdict(char *buffer, size_t size, ZDict *zdict)
 {
-    if (zdict->zlist->first == NULL)
+    if (zdict->length == 0)
         return snprintf(buffer, size, "<Empty Dict>");
     else {
         char nodebff[256];
-        ZNode *cur = zdict->zlist->first;
+        ZPair *pair;
+        unsigned int i, left = zdict->length;
         /* buffer length to return */
         int blen = 1;
 
         *buffer = '{';
-        while (1) {
-            if (cur->next->next == NULL) {
-                zrepobj(nodebff, 256, cur->object);
-                blen += snprintf(buffer + blen,
-                                 size,
-                                 "%s:",
-                                 nodebff);
-                zrepobj(nodebff, 256, cur->next->object);
-                blen += snprintf(buffer + blen,
-                                 size,
-                                 "%s}",
-                                 nodebff);
-                break;
-            }
-            zrepobj(nodebff, 256, cur->object);
+        for (i = 0; i < zdict->npairs; i++) {
+            pair = &zdict->pairs[i];
+            if (pair->key == NULL)
+                continue;
+            zrepobj(nodebff, 256, pair->key);
             blen += snprintf(buffer + blen,
                              size,
                              "%s:",
                              nodebff);
-            zrepobj(nodebff, 256, cur->next->object);
+            zrepobj(nodebff, 256, pair->value);
             blen += snprintf(buffer + blen,
                              size,
-                             "%s ",
+                             (--left == 0) ? "%s}" : "%s ",
                              nodebff);
-            cur = cur->next->next;
         }
         return blen;
     }
@@ -155,7 +349,7 @@ zrepdict(char *buffer, size_t size, ZDict *zdict)
 unsigned int
 zdlength(ZDict *zdict)
 {
-    return zdict->zlist->length / 2;
+    return zdict->length;
 }
 
 /* Define or redefine 'key' in 'zdict'.
@@ -165,54 +359,74 @@ zdlength(ZDict *zdict)
 ZError
 zdset(ZDict *zdict, Zob *key, Zob *value)
 {
-    /* Seek key. */
-    ZNode *item;
+    unsigned int hash = zdhash(key);
+    unsigned int i;
+    int slot;
+    ZPair *pair;
     ZError err;
 
-    item = zdict->zlist->first;
-    while (item != NULL) {
-        if (zcmpobj(item->object, key) == 0) {
-            /* Set value. */
-            zdecrefc(item->next->object);
-            item->next->object = value;
-            zincrefc(value);
-            return ZE_OK;
-        }
-        item = item->next->next;
+    err = zdown(zdict);
+    if (err != ZE_OK)
+        return err;
+    slot = zdslot(zdict, key, hash);
+    if (slot >= 0) {
+        /* Set value. */
+        pair = &zdict->pairs[zdict->index[slot]];
+        zincrefc(value);
+        zdecrefc(pair->value);
+        pair->value = value;
+        return ZE_OK;
     }
 
     /* Key not found. */
-    /* New key. */
-    err = zlappend(zdict->zlist, key);
-    if (err != ZE_OK)
-        return err;
-    err = zlappend(zdict->zlist, value);
-    if (err != ZE_OK)
-        return err;
+    /* New key. Positions (removed pairs included) fill at most 3/4
+     *  of the index table.
+     */
+    if (zdict->npairs == zdict->size / 4 * 3) {
+        unsigned int size = DMINSIZE;
+
+        while ((zdict->length + 1) * 2 > size)
+            size *= 2;
+        err = zdresize(zdict, size);
+        if (err != ZE_OK)
+            return err;
+    }
+    if (ZISMUTABLE(key)) {
+        /* The key is kept under its hash: it must not change. */
+        err = zcpyobj(key, &key);
+        if (err != ZE_OK)
+            return err;
+    }
+    pair = &zdict->pairs[zdict->npairs];
+    pair->key = key;
+    pair->value = value;
+    pair->hash = hash;
+    zincrefc(key);
+    zincrefc(value);
+    i = hash & (zdict->size - 1);
+    while (zdict->index[i] >= 0)
+        i = (i + 1) & (zdict->size - 1);
+    zdict->index[i] = (int) zdict->npairs++;
+    zdict->length++;
     return ZE_OK;
 }
 
 /* If 'key' is in 'zdict', copy its value to 'value' and return nonzero.
- * Otherwise, return zero.
+ * Otherwise, or if there is not enough memory to give the value away,
+ *  return zero.
  */
 int
 zdget(ZDict *zdict, Zob *key, Zob **value)
 {
-    /* Seek key. */
-    ZNode *item;
-
-    item = zdict->zlist->first;
-    while (item != NULL) {
-        if (zcmpobj(item->object, key) == 0) {
-            /* Get value. */
-            *value = item->next->object;
-            return 1;
-        }
-        item = item->next->next;
-    }
+    int slot = zdslot(zdict, key, zdhash(key));
 
-    /* Key not found. */
-    return 0;
+    if (slot < 0)
+        return 0;
+    if (ZISMUTABLE(zdict->pairs[zdict->index[slot]].value)  &&
+        zdown(zdict) != ZE_OK)
+        return 0;
+    *value = zdict->pairs[zdict->index[slot]].value;
+    return 1;
 }
 
 /* Define or redefine all items from 'other' to 'zdict'.
@@ -222,50 +436,92 @@ zdget(ZDict *zdict, Zob *key, Zob **value)
 ZError
 zdupdate(ZDict *zdict, ZDict *other)
 {
-    ZNode *key, *value;
+    unsigned int i;
     ZError err;
 
-    key = other->zlist->first;
-    while (key != NULL) {
-        value = key->next;
-        err = zdset(zdict, key->object, value->object);
+    for (i = 0; i < other->npairs; i++) {
+        if (other->pairs[i].key == NULL)
+            continue;
+        err = zdset(zdict, other->pairs[i].key, other->pairs[i].value);
         if (err != ZE_OK)
             return err;
-        key = value->next;
     }
     return ZE_OK;
 }
 
 /* If 'key' is in 'zdict', remove its pair from 'zdict' and return nonzero.
- * Otherwise, return zero.
+ * Otherwise, or if there is not enough memory to do it, return zero.
  */
 int
 zdremove(ZDict *zdict, Zob *key)
 {
-    /* Seek key. */
-    ZNode *item;
-    int index = 0;
-
-    item = zdict->zlist->first;
-    while (item != NULL) {
-        if (!zcmpobj(item->object, key)) {
-            (void) zlremove(zdict->zlist, index);
-            (void) zlremove(zdict->zlist, index);
-            return 1;
-        }
-        item = item->next->next;
-        index += 2;
-    }
+    int slot = zdslot(zdict, key, zdhash(key));
+    ZPair *pair;
 
-    /* Key not found. */
-    return 0;
+    if (slot < 0  ||  zdown(zdict) != ZE_OK)
+        return 0;
+    pair = &zdict->pairs[zdict->index[slot]];
+    zdict->index[slot] = DDUMMY;
+    zdict->length--;
+    zdecrefc(pair->key);
+    zdecrefc(pair->value);
+    pair->key = NULL;
+    pair->value = NULL;
+    return 1;
 }
 
-/* Delete all key-value pairs in 'zdict'. */
+/* Delete all key-value pairs in 'zdict'.
+ * Shared pairs are left to the copies.
+ */
 void
 zdempty(ZDict *zdict)
 {
-    zlempty(zdict->zlist);
+    unsigned int i;
+
+    if (zunshare((Zob *) zdict)) {
+        zdict->pairs = NULL;
+        zdict->index = NULL;
+        zdict->size = 0;
+        zdict->npairs = 0;
+    }
+    for (i = 0; i < zdict->npairs; i++) {
+        if (zdict->pairs[i].key == NULL)
+            continue;
+        zdecrefc(zdict->pairs[i].key);
+        zdecrefc(zdict->pairs[i].value);
+    }
+    for (i = 0; i < zdict->size; i++)
+        zdict->index[i] = DFREE;
+    zdict->npairs = 0;
+    zdict->length = 0;
+}
+
+/* Release the pairs of 'zdict', from the last one, while '*budget'
+ *  lasts, and decrease it by the number of positions visited.
+ * Only meant for a dict that is being deleted: its index is left stale.
+ * Return nonzero once 'zdict' is empty.
+ */
+int
+zddrain(ZDict *zdict, unsigned int *budget)
+{
+    ZPair *pair;
+
+    if (zunshare((Zob *) zdict)) {
+        zdict->pairs = NULL;
+        zdict->index = NULL;
+        zdict->size = 0;
+        zdict->npairs = 0;
+    }
+    while (zdict->npairs > 0  &&  *budget > 0) {
+        pair = &zdict->pairs[--zdict->npairs];
+        if (pair->key != NULL) {
+            zdecrefc(pair->key);
+            zdecrefc(pair->value);
+            zdict->length--;
+        }
+        (*budget)--;
+    }
+    return zdict->npairs == 0;
 }
 
 /* If 'key' is in 'zdict', return nonzero.
@@ -274,13 +530,5 @@ zdempty(ZDict *zdict)
 int
 zdhaskey(ZDict *zdict, Zob *key)
 {
-    ZNode *item;
-
-    item = zdict->zlist->first;
-    while (item != NULL) {
-        if (zcmpobj(item->object, key) == 0)
-            return 1;
-        item = item->next->next;
-    }
-    return 0;
+    return zdslot(zdict, key, zdhash(key)) >= 0;
 }
@@ -132,6 +132,18 @@ zraiseerr(ZError err)
         case ZE_DIVISION_BY_ZERO:
             puts("ZE_DIVISION_BY_ZERO");
             return EXIT_FAILURE;
+        case ZE_BYTECODE_VERSION:
+            puts("ZE_BYTECODE_VERSION");
+            return EXIT_FAILURE;
+        case ZE_YIELD_WITHOUT_GENERATOR:
+            puts("ZE_YIELD_WITHOUT_GENERATOR");
+            return EXIT_FAILURE;
+        case ZE_GENERATOR_RUNNING:
+            puts("ZE_GENERATOR_RUNNING");
+            return EXIT_FAILURE;
+        case ZE_CALL_TOO_DEEP:
+            puts("ZE_CALL_TOO_DEEP");
+            return EXIT_FAILURE;
         default:
             puts("Unexpected error.");
             return EXIT_FAILURE;
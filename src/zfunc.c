@@ -24,6 +24,8 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zgc.h"
+#include "zslab.h"
 
 #include "zlist.h"
 #include "zfunc.h"
@@ -35,10 +37,12 @@
 ZError
 znewlowfunc(ZLowFunc **zlowfunc)
 {
-    *zlowfunc = (ZLowFunc *) malloc(sizeof(ZLowFunc));
+    *zlowfunc = (ZLowFunc *) zalloc(sizeof(ZLowFunc));
     if (*zlowfunc == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zlowfunc)->high = 0;
+    (*zlowfunc)->vfunc = NULL;
+    (*zlowfunc)->func = NULL;
     return ZE_OK;
 }
 
@@ -46,21 +50,54 @@ znewlowfunc(ZLowFunc **zlowfunc)
 void
 zdellowfunc(ZLowFunc **zlowfunc)
 {
-    free(*zlowfunc);
+    zfree(*zlowfunc, sizeof(ZLowFunc));
     *zlowfunc = NULL;
 }
 
-/* Create a new ZLowFunc in 'zlowfunc'.
+/* Call 'zlowfunc' with the 'argc' arguments in 'argv'.
+ * Functions registered with a ZList signature get their arguments
+ *  copied to a new ZList; the caller must hold references to them.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by the function or ZE_OK.
+ */
+ZError
+zcall_low(ZLowFunc *zlowfunc, Zob **argv, int argc, Zob **ret)
+{
+    ZList *args;
+    int i;
+    ZError err;
+
+    if (zlowfunc->vfunc != NULL)
+        return zlowfunc->vfunc(argv, argc, ret);
+    err = znewlist(&args);
+    if (err != ZE_OK)
+        return err;
+    for (i = 0; i < argc; i++) {
+        err = zlappend(args, argv[i]);
+        if (err != ZE_OK) {
+            zdellist(&args);
+            return err;
+        }
+    }
+    err = zlowfunc->func(args, ret);
+    /* The caller still holds the arguments, so none is removed here. */
+    zdellist(&args);
+    return err;
+}
+
+/* Create a new ZHighFunc in 'zhighfunc'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 znewhighfunc(ZHighFunc **zhighfunc)
 {
-    *zhighfunc = (ZHighFunc *) malloc(sizeof(ZHighFunc));
+    *zhighfunc = (ZHighFunc *) zalloc(sizeof(ZHighFunc));
     if (*zhighfunc == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zhighfunc)->high = 1;
+    (*zhighfunc)->generator = 0;
+    (*zhighfunc)->code = NULL;
     return ZE_OK;
 }
 
@@ -68,7 +105,7 @@ znewhighfunc(ZHighFunc **zhighfunc)
 void
 zdelhighfunc(ZHighFunc **zhighfunc)
 {
-    free(*zhighfunc);
+    zfree(*zhighfunc, sizeof(ZHighFunc));
     *zhighfunc = NULL;
 }
 
@@ -79,7 +116,7 @@ zdelhighfunc(ZHighFunc **zhighfunc)
 ZError
 znewfunc(ZFunc **zfunc, FImp *fimp, unsigned char arity)
 {
-    *zfunc = (ZFunc *) malloc(sizeof(ZFunc));
+    *zfunc = (ZFunc *) zalloc(sizeof(ZFunc));
     if (*zfunc == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zfunc)->type = T_FUNC;
@@ -93,13 +130,16 @@ znewfunc(ZFunc **zfunc, FImp *fimp, unsigned char arity)
 void
 zdelfunc(ZFunc **zfunc)
 {
-    free((*zfunc)->fimp);
-    (*zfunc)->fimp = NULL;
-    free(*zfunc);
+    if (*(*zfunc)->fimp)
+        zdelhighfunc((ZHighFunc **) &(*zfunc)->fimp);
+    else
+        zdellowfunc((ZLowFunc **) &(*zfunc)->fimp);
+    zfree(*zfunc, sizeof(ZFunc));
     *zfunc = NULL;
 }
 
 /* Create a new copy of 'source' in 'dest'.
+ * The implementation is copied too, since each ZFunc frees its own.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
@@ -108,10 +148,29 @@ zcpyfunc(ZFunc *source, ZFunc **dest)
 {
     ZError err;
 
-    err = znewfunc(dest, source->fimp, source->arity);
-    if (err != ZE_OK)
-        return err;
-    return ZE_OK;
+    if (*source->fimp) {
+        ZHighFunc *zhighfunc;
+
+        err = znewhighfunc(&zhighfunc);
+        if (err != ZE_OK)
+            return err;
+        *zhighfunc = *(ZHighFunc *) source->fimp;
+        err = znewfunc(dest, (FImp *) zhighfunc, source->arity);
+        if (err != ZE_OK)
+            zdelhighfunc(&zhighfunc);
+    }
+    else {
+        ZLowFunc *zlowfunc;
+
+        err = znewlowfunc(&zlowfunc);
+        if (err != ZE_OK)
+            return err;
+        *zlowfunc = *(ZLowFunc *) source->fimp;
+        err = znewfunc(dest, (FImp *) zlowfunc, source->arity);
+        if (err != ZE_OK)
+            zdellowfunc(&zlowfunc);
+    }
+    return err;
 }
 
 /* Test the truth value of 'zfunc'.
@@ -140,6 +199,13 @@ zcmpfunc(ZFunc *zfunc, ZFunc *other)
         return 1;
 }
 
+/* Return the hash of 'zfunc': the address of its implementation. */
+unsigned int
+zhashfunc(ZFunc *zfunc)
+{
+    return (unsigned int) (uintptr_t) zfunc->fimp;
+}
+
 /* Print the textual representation of 'zfunc' on 'buffer'.
  * Return the number of bytes writen.
  */
@@ -18,28 +18,551 @@
 
 /* Garbage Collector */
 
-/* Garbage collection is done by simple reference counting. */
+/* Garbage collection is done by simple reference counting,
+ *  backed by a trial deletion collector for cycles of containers.
+ * Containers that die are not deleted at once: they are queued and
+ *  torn down a few items at a time, from safe points, so that dropping
+ *  a large or deeply nested structure neither stalls the program nor
+ *  recurses once per level.
+ */
 
 #include <stddef.h>
+#include <limits.h>
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zalloc.h"
+#include "zslab.h"
+#include "zgc.h"
+
+#include "zlist.h"
+#include "zatom.h"
+#include "znametable.h"
+#include "zdict.h"
+#include "zfunc.h"
 
 #include "zobject.h"
+#include "zruntime.h"
 
-#include "zgc.h"
+/* 'gcrefs' of containers that are referenced from outside for sure:
+ *  new objects not referenced yet, like the global namespace,
+ *  and immortal ones.
+ */
+#define GCROOT INT_MAX
+
+/* Collector state of one allocator. */
+typedef struct {
+    /* Circular list of tracked containers. */
+    ZGCLink tracked;
+    unsigned int count;
+    /* Containers created since the last collection. */
+    unsigned int created;
+    unsigned int threshold;
+    unsigned long runs;
+    unsigned long freed;
+    /* Dead containers waiting to be torn down, linked through 'next',
+     *  the last one queued first.
+     */
+    ZGCLink *queue;
+} ZGCState;
+
+#define LINK(container) (&((ZContainer *) (container))->link)
+#define OBJECT(gclink)  ((Zob *) ((char *) (gclink) - \
+                                  offsetof(ZContainer, link)))
 
 void
 zincrefc(Zob *object)
 {
+    if (ZUNCOUNTED(object))
+        return;
     ((RefC *) object)->refc++;
 }
 
+static void zdefer(Zob *container);
+
 void
 zdecrefc(Zob *object)
 {
-    if (((RefC *) object)->refc <= 1)
-        zdelobj(&object);
-    else
+    if (ZUNCOUNTED(object))
+        return;
+    if (((RefC *) object)->refc > 1)
         ((RefC *) object)->refc--;
+    else if (ZISCONTAINER(object))
+        zdefer(object);
+    else
+        zdelobj(&object);
+}
+
+/* Drop a reference to 'object' without deleting it, so that it can be
+ *  handed to a caller like a new object.
+ */
+void
+zdisown(Zob *object)
+{
+    if (ZUNCOUNTED(object))
+        return;
+    ((RefC *) object)->refc--;
+}
+
+/* Return the collector state of the current allocator,
+ *  creating it on first use, or NULL if there is not enough memory.
+ */
+static ZGCState *
+zgcstate()
+{
+    ZAllocator *za = zgetallocator();
+    ZGCState *state;
+
+    if (za->gc == NULL) {
+        state = (ZGCState *) za->alloc(za, sizeof(ZGCState));
+        if (state == NULL)
+            return NULL;
+        state->tracked.prev = state->tracked.next = &state->tracked;
+        state->count = 0;
+        state->created = 0;
+        state->threshold = GCTHRESHOLD;
+        state->runs = 0;
+        state->freed = 0;
+        state->queue = NULL;
+        za->gc = state;
+    }
+    return (ZGCState *) za->gc;
+}
+
+/* Move 'link' to the end of the list headed by 'head'. */
+static void
+zgcmove(ZGCLink *link, ZGCLink *head)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+/* Start tracking 'container', which was just created.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+ztrack(Zob *container)
+{
+    ZGCState *state = zgcstate();
+    ZGCLink *link = LINK(container);
+
+    if (state == NULL)
+        return ZE_OUT_OF_MEMORY;
+    link->prev = link->next = link;
+    zgcmove(link, &state->tracked);
+    state->count++;
+    state->created++;
+    return ZE_OK;
+}
+
+/* Stop tracking 'container', which is being deleted.
+ * Nothing is done if it is not tracked anymore.
+ */
+void
+zuntrack(Zob *container)
+{
+    ZGCLink *link = LINK(container);
+
+    if (link->prev == NULL)
+        return;
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = NULL;
+    ((ZGCState *) zgetallocator()->gc)->count--;
+}
+
+/* Queue 'container', whose last reference was just dropped,
+ *  to be torn down by zdrain().
+ */
+static void
+zdefer(Zob *container)
+{
+    ZGCState *state = (ZGCState *) zgetallocator()->gc;
+    ZGCLink *link = LINK(container);
+
+    zuntrack(container);
+    ((ZContainer *) container)->refc = 0;
+    link->next = state->queue;
+    state->queue = link;
+}
+
+/* Tear down dead containers of the current allocator, releasing about
+ *  'budget' items and containers in all.
+ * The items released may queue more containers, which are torn down
+ *  before the rest of the queue, so that nesting never deepens the C
+ *  stack and the queue holds little more than the containers being
+ *  taken apart.
+ * With ZDRAINALL, the queue is emptied.
+ */
+void
+zdrain(unsigned int budget)
+{
+    ZGCState *state = (ZGCState *) zgetallocator()->gc;
+    ZGCLink *link, *above;
+    Zob *container;
+    int all = budget == ZDRAINALL, empty;
+
+    if (state == NULL)
+        return;
+    while (state->queue != NULL  &&  budget > 0) {
+        link = state->queue;
+        container = OBJECT(link);
+        if (*container == T_LIST)
+            empty = zldrain((ZList *) container, &budget);
+        else if (*container == T_NMTB)
+            empty = ztdrain((ZNameTable *) container, &budget);
+        else if (*container == T_DICT)
+            empty = zddrain((ZDict *) container, &budget);
+        else
+            empty = zgdrain((ZGen *) container, &budget);
+        if (!empty)
+            break;
+        /* Containers queued meanwhile are above 'link': as many as the
+         *  items just released, at most.
+         */
+        if (state->queue == link)
+            state->queue = link->next;
+        else {
+            for (above = state->queue; above->next != link;
+                 above = above->next)
+                ;
+            above->next = link->next;
+        }
+        zdelobj(&container);
+        if (all)
+            budget = ZDRAINALL;
+        else if (budget > 0)
+            budget--;
+    }
+}
+
+static int zgcunique(Zob *container, unsigned int depth);
+
+/* Return nonzero if 'item' can be changed in place only through the
+ *  container holding it, down to 'depth' more levels.
+ */
+static int
+zgcsole(Zob *item, unsigned int depth)
+{
+    if (!ZISMUTABLE(item))
+        return 1;
+    if (((RefC *) item)->refc != 1)
+        return 0;
+    if (*item == T_YARR)
+        return 1;
+    if (depth == 0)
+        return 0;
+    return zgcunique(item, depth - 1);
+}
+
+/* Return nonzero if every item of 'container' that can be changed in
+ *  place is referenced by 'container' alone, down to 'depth' more levels.
+ * The values of name tables are not looked into: copies of name tables
+ *  always referenced the same values.
+ */
+static int
+zgcunique(Zob *container, unsigned int depth)
+{
+    unsigned int i;
+
+    switch (*container) {
+        case T_LIST:
+            {
+                ZList *zlist = (ZList *) container;
+
+                for (i = 0; i < zlist->length; i++)
+                    if (!zgcsole(ZLITEM(zlist, i), depth))
+                        return 0;
+            }
+            break;
+        case T_DICT:
+            {
+                ZDict *zdict = (ZDict *) container;
+
+                for (i = 0; i < zdict->npairs; i++) {
+                    if (zdict->pairs[i].key == NULL)
+                        continue;
+                    if (!zgcsole(zdict->pairs[i].key, depth)  ||
+                        !zgcsole(zdict->pairs[i].value, depth))
+                        return 0;
+                }
+            }
+            break;
+    }
+    return 1;
+}
+
+/* Return nonzero if a copy of 'container', a list or a dict, may share
+ *  its contents until either is changed.
+ * It may not if some item that can be changed in place, at any of
+ *  SHAREDEPTH levels, is also referenced from elsewhere: changes made
+ *  through that reference would reach the copy, which must be deep.
+ */
+int
+zsharable(Zob *container)
+{
+    return zgcunique(container, SHAREDEPTH);
+}
+
+/* Make 'dest', a new container, share the contents of 'source'.
+ * The caller then copies the fields describing them.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zshare(Zob *source, Zob *dest)
+{
+    ZShare *share = ((ZContainer *) source)->share;
+
+    if (share == NULL) {
+        share = (ZShare *) zalloc(sizeof(ZShare));
+        if (share == NULL)
+            return ZE_OUT_OF_MEMORY;
+        share->count = 1;
+        share->mark = 0;
+        ((ZContainer *) source)->share = share;
+    }
+    share->count++;
+    ((ZContainer *) dest)->share = share;
+    return ZE_OK;
+}
+
+/* Stop sharing the contents of 'container'.
+ * If other containers still share them, return nonzero:
+ *  'container' must then forget them without releasing anything.
+ * Otherwise, return zero: they belong to 'container' alone.
+ */
+int
+zunshare(Zob *container)
+{
+    ZShare *share = ((ZContainer *) container)->share;
+
+    if (share == NULL)
+        return 0;
+    ((ZContainer *) container)->share = NULL;
+    if (--share->count > 0)
+        return 1;
+    zfree(share, sizeof(ZShare));
+    return 0;
+}
+
+/* Call 'visit' on each container referenced by 'container'. */
+static void
+zgcvisit(Zob *container, void (*visit)(Zob *child, ZGCLink *head),
+         ZGCLink *head)
+{
+    unsigned int i;
+
+    switch (*container) {
+        case T_LIST:
+            {
+                ZList *zlist = (ZList *) container;
+
+                for (i = 0; i < zlist->length; i++)
+                    if (ZISCONTAINER(ZLITEM(zlist, i)))
+                        visit(ZLITEM(zlist, i), head);
+            }
+            break;
+        case T_NMTB:
+            {
+                ZNameTable *znable = (ZNameTable *) container;
+                ZEntry *zentry;
+
+                for (zentry = ztfirst(znable); zentry != NULL;
+                     zentry = ztnext(znable, zentry))
+                    if (ZISCONTAINER(zentry->value))
+                        visit(zentry->value, head);
+            }
+            break;
+        case T_DICT:
+            {
+                ZDict *zdict = (ZDict *) container;
+
+                for (i = 0; i < zdict->npairs; i++) {
+                    if (zdict->pairs[i].key == NULL)
+                        continue;
+                    if (ZISCONTAINER(zdict->pairs[i].key))
+                        visit(zdict->pairs[i].key, head);
+                    if (ZISCONTAINER(zdict->pairs[i].value))
+                        visit(zdict->pairs[i].value, head);
+                }
+            }
+            break;
+        case T_GEN:
+            {
+                ZGen *zgen = (ZGen *) container;
+                ZFrame *frame = zgen->frame;
+
+                for (i = 0; i < zgen->depth; i++)
+                    if (ZISCONTAINER(zgen->stack[i]))
+                        visit(zgen->stack[i], head);
+                if (frame == NULL)
+                    break;
+                for (i = 0; i < frame->nslots; i++)
+                    if (frame->slots[i] != NULL  &&
+                        ZISCONTAINER(frame->slots[i]))
+                        visit(frame->slots[i], head);
+                if (frame->names != NULL)
+                    visit((Zob *) frame->names, head);
+                if (frame->ret != NULL  &&  ZISCONTAINER(frame->ret))
+                    visit(frame->ret, head);
+            }
+            break;
+    }
+}
+
+/* Discount a reference held by a tracked container. */
+static void
+zgcsubtract(Zob *child, ZGCLink *head)
+{
+    LINK(child)->gcrefs--;
+}
+
+/* Move a container found unreachable so far back to the reachable. */
+static void
+zgcreach(Zob *child, ZGCLink *head)
+{
+    ZGCLink *link = LINK(child);
+
+    if (link->gcrefs == 0) {
+        link->gcrefs = 1;
+        zgcmove(link, head);
+    }
+}
+
+/* Free the containers of the current allocator that are only
+ *  referenced by each other, and return how many there were.
+ */
+unsigned int
+zcollect()
+{
+    ZGCState *state = (ZGCState *) zgetallocator()->gc;
+    ZGCLink reachable, garbage, *link, *next;
+    unsigned int refc, freed = 0;
+
+    if (state == NULL)
+        return 0;
+    /* Count the references from outside the tracked containers. */
+    for (link = state->tracked.next; link != &state->tracked;
+         link = link->next) {
+        refc = ((ZContainer *) OBJECT(link))->refc;
+        if (refc == 0  ||  refc == ZIMMORTAL  ||  refc >= GCROOT)
+            link->gcrefs = GCROOT;
+        else
+            link->gcrefs = (int) refc;
+    }
+    for (link = state->tracked.next; link != &state->tracked;
+         link = link->next) {
+        ZShare *share = ((ZContainer *) OBJECT(link))->share;
+
+        /* Shared contents hold a single reference to each item. */
+        if (share != NULL) {
+            if (share->mark == state->runs + 1)
+                continue;
+            share->mark = state->runs + 1;
+        }
+        zgcvisit(OBJECT(link), zgcsubtract, NULL);
+    }
+    /* Whatever they reference, directly or not, is reachable. */
+    reachable.prev = reachable.next = &reachable;
+    for (link = state->tracked.next; link != &state->tracked;
+         link = next) {
+        next = link->next;
+        if (link->gcrefs > 0)
+            zgcmove(link, &reachable);
+        else
+            link->gcrefs = 0;
+    }
+    for (link = reachable.next; link != &reachable; link = link->next)
+        zgcvisit(OBJECT(link), zgcreach, &reachable);
+    /* The rest is garbage. */
+    garbage.prev = garbage.next = &garbage;
+    while (state->tracked.next != &state->tracked)
+        zgcmove(state->tracked.next, &garbage);
+    while (reachable.next != &reachable)
+        zgcmove(reachable.next, &state->tracked);
+    /* Break the cycles while holding every garbage container,
+     *  so that none is freed before it is emptied.
+     */
+    for (link = garbage.next; link != &garbage; link = link->next)
+        ((ZContainer *) OBJECT(link))->refc++;
+    for (link = garbage.next; link != &garbage; link = link->next) {
+        Zob *container = OBJECT(link);
+
+        if (*container == T_LIST)
+            zlempty((ZList *) container);
+        else if (*container == T_NMTB)
+            ztempty((ZNameTable *) container);
+        else if (*container == T_DICT)
+            zdempty((ZDict *) container);
+        else
+            zgempty((ZGen *) container);
+    }
+    while (garbage.next != &garbage) {
+        /* Each one is left empty with the reference we hold,
+         *  so it only goes through the queue.
+         */
+        zdecrefc(OBJECT(garbage.next));
+        freed++;
+    }
+    state->runs++;
+    state->freed += freed;
+    state->created = 0;
+    state->threshold = state->count > GCTHRESHOLD ? state->count
+                                                  : GCTHRESHOLD;
+    return freed;
+}
+
+/* Tear down a bounded share of the dead containers, and collect cycles
+ *  if enough containers were created since the last collection.
+ * Only call it where every live object is referenced from a counted
+ *  place, or not referenced at all, e.g. between statements.
+ */
+void
+zautocollect()
+{
+    ZGCState *state = (ZGCState *) zgetallocator()->gc;
+
+    if (state == NULL)
+        return;
+    if (state->queue != NULL)
+        zdrain(DRAINSTEP);
+    if (state->created >= state->threshold)
+        (void) zcollect();
+}
+
+/* Save the collector statistics of the current allocator in 'stats'. */
+void
+zgcstats(ZGCStats *stats)
+{
+    ZGCState *state = (ZGCState *) zgetallocator()->gc;
+
+    if (state == NULL) {
+        stats->tracked = 0;
+        stats->runs = 0;
+        stats->freed = 0;
+        return;
+    }
+    stats->tracked = state->count;
+    stats->runs = state->runs;
+    stats->freed = state->freed;
+}
+
+/* Remove the collector state of the current allocator from memory.
+ * No container allocated through it may be left.
+ */
+void
+zdelgc()
+{
+    ZAllocator *za = zgetallocator();
+
+    if (za->gc != NULL) {
+        za->release(za, za->gc);
+        za->gc = NULL;
+    }
 }
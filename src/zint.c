@@ -23,29 +23,40 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zslab.h"
 
 #include "zint.h"
 
-/* Create a new ZInt in 'zint'.
+/* Make an Int of value 'value' in 'zint'.
+ * The Int is immediate if 'value' fits in one.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-znewint(ZInt **zint)
+zmkint(Zob **zint, int value)
 {
-    *zint = (ZInt *) malloc(sizeof(ZInt));
-    if (*zint == NULL)
+    ZInt *boxed;
+
+    if ((intptr_t) value >= ZIMMMIN  &&
+        (intptr_t) value <= ZIMMMAX) {
+        *zint = ZIMM(T_INT, value);
+        return ZE_OK;
+    }
+    boxed = (ZInt *) zalloc(sizeof(ZInt));
+    if (boxed == NULL)
         return ZE_OUT_OF_MEMORY;
-    (*zint)->type = T_INT;
-    (*zint)->refc = 0;
+    boxed->type = T_INT;
+    boxed->refc = 0;
+    boxed->value = value;
+    *zint = (Zob *) boxed;
     return ZE_OK;
 }
 
-/* Remove 'zint' from memory. */
+/* Remove the allocated 'zint' from memory. */
 void
 zdelint(ZInt **zint)
 {
-    free(*zint);
+    zfree(*zint, sizeof(ZInt));
     *zint = NULL;
 }
 
@@ -54,24 +65,18 @@ zdelint(ZInt **zint)
  * Otherwise, return ZE_OK.
  */
 ZError
-zcpyint(ZInt *source, ZInt **dest)
+zcpyint(Zob *source, Zob **dest)
 {
-    ZError err;
-
-    err = znewint(dest);
-    if (err != ZE_OK)
-        return err;
-    (*dest)->value = source->value;
-    return ZE_OK;
+    return zmkint(dest, ZINTVALUE(source));
 }
 
 /* Test the truth value of 'zint'.
- * Return 'zint->value'.
+ * Return its value.
  */
 int
-ztstint(ZInt *zint)
+ztstint(Zob *zint)
 {
-    return (int) zint->value;
+    return ZINTVALUE(zint);
 }
 
 /* Compare 'zint' and 'other'.
@@ -79,19 +84,26 @@ ztstint(ZInt *zint)
  * Otherwise, return nonzero.
  */
 int
-zcmpint(ZInt *zint, ZInt *other)
+zcmpint(Zob *zint, Zob *other)
 {
-    if (other->value == zint->value)
+    if (ZINTVALUE(other) == ZINTVALUE(zint))
         return 0;
     else
         return 1;
 }
 
+/* Return the hash of 'zint': its value. */
+unsigned int
+zhashint(Zob *zint)
+{
+    return (unsigned int) ZINTVALUE(zint);
+}
+
 /* Print the textual representation of 'zint' on 'buffer'.
  * Return the number of bytes writen.
  */
 int
-zrepint(char *buffer, size_t size, ZInt *zint)
+zrepint(char *buffer, size_t size, Zob *zint)
 {
-    return snprintf(buffer, size, "%d", zint->value);
+    return snprintf(buffer, size, "%d", ZINTVALUE(zint));
 }
@@ -24,36 +24,41 @@
 #include "ztypes.h"
 #include "zerr.h"
 #include "zgc.h"
+#include "zalloc.h"
+#include "zslab.h"
 
 #include "zlist.h"
 
 #include "zobject.h"
 
-/* Create a new ZNode in 'znode', referencing 'zob'.
+/* Make room in 'zlist' for at least 'length' items.
+ * Items are moved to the start of the new buffer.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
-ZError
-znewnode(Zob *zob, ZNode **znode)
+static ZError
+zlreserve(ZList *zlist, unsigned int length)
 {
-    *znode = (ZNode *) malloc(sizeof(ZNode));
-    if (*znode == NULL)
+    Zob **items;
+    unsigned int size, i;
+
+    if (length <= zlist->size)
+        return ZE_OK;
+    size = zlist->size ? zlist->size : LMINSIZE;
+    while (size < length)
+        size *= 2;
+    items = (Zob **) zmalloc(size * sizeof(Zob *));
+    if (items == NULL)
         return ZE_OUT_OF_MEMORY;
-    (*znode)->object = zob;
-    zincrefc(zob);
-    (*znode)->next = NULL; /* Security. */
+    for (i = 0; i < zlist->length; i++)
+        items[i] = ZLITEM(zlist, i);
+    zmfree(zlist->items);
+    zlist->items = items;
+    zlist->size = size;
+    zlist->head = 0;
     return ZE_OK;
 }
 
-/* Remove 'znode' from memory, unbinding its object. */
-void
-zdelnode(ZNode **znode)
-{
-    zdecrefc((*znode)->object);
-    free(*znode);
-    *znode = NULL;
-}
-
 /* Create a new ZList in 'zlist'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
@@ -61,14 +66,21 @@ zdelnode(ZNode **znode)
 ZError
 znewlist(ZList **zlist)
 {
-    *zlist = (ZList *) malloc(sizeof(ZList));
+    *zlist = (ZList *) zalloc(sizeof(ZList));
     if (*zlist == NULL)
         return ZE_OUT_OF_MEMORY;
     (*zlist)->type = T_LIST;
     (*zlist)->length = 0;
-    (*zlist)->first = NULL;
-    (*zlist)->last = NULL;
+    (*zlist)->size = 0;
+    (*zlist)->head = 0;
+    (*zlist)->items = NULL;
+    (*zlist)->share = NULL;
     (*zlist)->refc = 0;
+    if (ztrack((Zob *) *zlist) != ZE_OK) {
+        zfree(*zlist, sizeof(ZList));
+        *zlist = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
     return ZE_OK;
 }
 
@@ -76,52 +88,100 @@ znewlist(ZList **zlist)
 void
 zdellist(ZList **zlist)
 {
-    while ((*zlist)->length > 0)
-        zlremfirst(*zlist);
-    free(*zlist);
+    zuntrack((Zob *) *zlist);
+    zlempty(*zlist);
+    zmfree((*zlist)->items);
+    zfree(*zlist, sizeof(ZList));
     *zlist = NULL;
 }
 
+/* Copy the items of 'zlist' in memory to a new buffer in 'items',
+ *  of the same size, starting at its first position.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zlcopyitems(ZList *zlist, Zob ***items)
+{
+    unsigned int i;
+    ZError err;
+
+    *items = (Zob **) zmalloc(zlist->size * sizeof(Zob *));
+    if (*items == NULL)
+        return ZE_OUT_OF_MEMORY;
+    for (i = 0; i < zlist->length; i++) {
+        err = zcpyobj(ZLITEM(zlist, i), &(*items)[i]);
+        if (err != ZE_OK) {
+            while (i > 0)
+                zdecrefc((*items)[--i]);
+            zmfree(*items);
+            *items = NULL;
+            return err;
+        }
+        zincrefc((*items)[i]);
+    }
+    return ZE_OK;
+}
+
 /* Create a new copy of 'source' in 'dest'.
  * Items are duplicated in memory, i.e.,
  * items in 'dest' do not share reference with items in 'source'.
+ * That is only done by zlown(), when needed: until then, 'dest' shares
+ *  the buffer of 'source', unless zsharable() does not allow it.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 zcpylist(ZList *source, ZList **dest)
 {
-    ZNode *old = source->first;
-    ZNode *new;
-    Zob *newzob;
     ZError err;
 
     err = znewlist(dest);
-    if (err != ZE_OK)
+    if (err != ZE_OK  ||  source->length == 0)
+        return err;
+    if (zsharable((Zob *) source))
+        err = zshare((Zob *) source, (Zob *) *dest);
+    else
+        err = zlcopyitems(source, &(*dest)->items);
+    if (err != ZE_OK) {
+        zdellist(dest);
         return err;
+    }
     (*dest)->length = source->length;
-    if (old == NULL)
+    (*dest)->size = source->size;
+    if ((*dest)->share == NULL)
+        (*dest)->head = 0;
+    else {
+        (*dest)->head = source->head;
+        (*dest)->items = source->items;
+    }
+    return ZE_OK;
+}
+
+/* Give 'zlist' a buffer of its own, if it shares one with copies,
+ *  duplicating the items in memory as zcpylist() promises.
+ * Call it before changing 'zlist' or giving away one of its items.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zlown(ZList *zlist)
+{
+    Zob **items;
+    ZError err;
+
+    if (zlist->share == NULL)
         return ZE_OK;
-    err = zcpyobj(old->object, &newzob);
-    if (err != ZE_OK)
-        return err;
-    err = znewnode(newzob, &new);
+    if (zlist->share->count == 1) {
+        (void) zunshare((Zob *) zlist);
+        return ZE_OK;
+    }
+    err = zlcopyitems(zlist, &items);
     if (err != ZE_OK)
         return err;
-    (*dest)->first = new;
-    old = old->next;
-    while (old != NULL) {
-        err = zcpyobj(old->object, &newzob);
-        if (err != ZE_OK)
-            return err;
-        err = znewnode(newzob, &new->next);
-        if (err != ZE_OK)
-            return err;
-        new = new->next;
-        old = old->next;
-    }
-    (*dest)->last = new;
-    new->next = NULL;
+    (void) zunshare((Zob *) zlist);
+    zlist->items = items;
+    zlist->head = 0;
     return ZE_OK;
 }
 
@@ -145,45 +205,49 @@ ztstlist(ZList *zlist)
 int
 zcmplist(ZList *zlist, ZList *other)
 {
-    ZNode *item, *oitem;
+    unsigned int i;
 
     if (zlist->length != other->length)
         return 1;
-    item = zlist->first;
-    oitem = other->first;
-    while (item != NULL) {
-        if (zcmpobj(item->object, oitem->object))
+    for (i = 0; i < zlist->length; i++)
+        if (zcmpobj(ZLITEM(zlist, i), ZLITEM(other, i)))
             return 1;
-        item = item->next;
-        oitem = oitem->next;
-    }
     return 0;
 }
 
+/* Return the hash of 'zlist', combining the hashes of its items. */
+unsigned int
+zhashlist(ZList *zlist)
+{
+    unsigned int hash = zlist->length;
+    unsigned int i;
+
+    for (i = 0; i < zlist->length; i++)
+        hash = hash * 31 + zhashobj(ZLITEM(zlist, i));
+    return hash;
+}
+
 /* Print the textual representation of 'zlist' on 'buffer'.
  * Return the number of bytes writen.
  */
 int
 zreplist(char *buffer, size_t size, ZList *zlist)
 {
-    if (zlist->first == NULL)
+    if (zlist->length == 0)
         return snprintf(buffer, size, "<Empty List>");
     else {
         char nodebff[256];
-        ZNode *cur = zlist->first;
+        unsigned int i;
         /* buffer length to return */
         int blen = 1;
 
         *buffer = '[';
-        while (1) {
-            if (cur->next == NULL) {
-                zrepobj(nodebff, 256, cur->object);
-                blen += snprintf(buffer + blen, size, "%s]", nodebff);
-                break;
-            }
-            zrepobj(nodebff, 256, cur->object);
-            blen += snprintf(buffer + blen, size, "%s ", nodebff);
-            cur = cur->next;
+        for (i = 0; i < zlist->length; i++) {
+            zrepobj(nodebff, 256, ZLITEM(zlist, i));
+            blen += snprintf(buffer + blen,
+                             size,
+                             (i == zlist->length - 1) ? "%s]" : "%s ",
+                             nodebff);
         }
         return blen;
     }
@@ -203,52 +267,50 @@ zllength(ZList *zlist)
 ZError
 zlpush(ZList *zlist, Zob *zob)
 {
-    ZNode *first;
     ZError err;
 
-    err = znewnode(zob, &first);
+    err = zlown(zlist);
+    if (err == ZE_OK)
+        err = zlreserve(zlist, zlist->length + 1);
     if (err != ZE_OK)
         return err;
-    first->next = zlist->first;
-    zlist->first = first;
-    if (zlist->length == 0)
-        zlist->last = first;
+    zlist->head = (zlist->head - 1) & (zlist->size - 1);
+    zlist->items[zlist->head] = zob;
+    zincrefc(zob);
     zlist->length++;
     return ZE_OK;
 }
 
 /* If 'zlist' is empty, return EMPTY.
+ * If there is not enough memory to give the first item away,
+ *  return NULL.
  * Otherwise, return the first item in 'zlist'. */
 Zob *
 zlpeek(ZList *zlist)
 {
-    if (zlist->first == NULL)
+    if (zlist->length == 0)
         return EMPTY;
-    return zlist->first->object;
+    if (ZISMUTABLE(ZLITEM(zlist, 0))  &&  zlown(zlist) != ZE_OK)
+        return NULL;
+    return ZLITEM(zlist, 0);
 }
 
-/* Remove the first item from 'zlist' and return it. */
+/* Remove the first item from 'zlist' and return it.
+ * The reference held by 'zlist' is passed to the caller.
+ * If 'zlist' is empty, return EMPTY.
+ * If there is not enough memory, return NULL.
+ */
 Zob *
 zlpop(ZList *zlist)
 {
     Zob *item;
 
-    if (zlist->first == NULL)
+    if (zlist->length == 0)
         return EMPTY;
-    item = zlist->first->object;
-    zincrefc(item);
-    if (zlist->first == zlist->last) {
-        zdelnode(&zlist->first);
-        zlist->first = NULL;
-        zlist->last = NULL;
-    }
-    else {
-        ZNode *second;
-
-        second = zlist->first->next;
-        zdelnode(&zlist->first);
-        zlist->first = second;
-    }
+    if (zlown(zlist) != ZE_OK)
+        return NULL;
+    item = ZLITEM(zlist, 0);
+    zlist->head = (zlist->head + 1) & (zlist->size - 1);
     zlist->length--;
     return item;
 }
@@ -260,18 +322,15 @@ zlpop(ZList *zlist)
 ZError
 zlappend(ZList *zlist, Zob *zob)
 {
-    ZNode *item;
     ZError err;
 
-    err = znewnode(zob, &item);
+    err = zlown(zlist);
+    if (err == ZE_OK)
+        err = zlreserve(zlist, zlist->length + 1);
     if (err != ZE_OK)
         return err;
-    item->next = NULL;
-    if (zlist->first == NULL)
-        zlist->first = item;
-    else
-        zlist->last->next = item;
-    zlist->last = item;
+    ZLITEM(zlist, zlist->length) = zob;
+    zincrefc(zob);
     zlist->length++;
     return ZE_OK;
 }
@@ -279,58 +338,57 @@ zlappend(ZList *zlist, Zob *zob)
 /* Replace the 'index'-th item of 'zlist' by 'zob'.
  * If 'index' is negative, use zllength('zlist') + 'index'.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 zlset(ZList *zlist, int index, Zob *zob)
 {
+    Zob *old;
+    ZError err;
+
     if (index < 0)
         index += zlist->length;
     if (index < 0 || index >= (int) zlist->length)
         return ZE_INDEX_OUT_OF_RANGE;
-    else {
-        int curidx = 0;
-        ZNode *cur = zlist->first;
-
-        while (curidx < index) {
-            cur = cur->next;
-            curidx++;
-        }
-        zdecrefc(cur->object);
-        cur->object = zob;
-        zincrefc(zob);
-    }
+    err = zlown(zlist);
+    if (err != ZE_OK)
+        return err;
+    old = ZLITEM(zlist, index);
+    ZLITEM(zlist, index) = zob;
+    zincrefc(zob);
+    zdecrefc(old);
     return ZE_OK;
 }
 
 /* Copy the 'index'-th item of 'zlist' to 'zob'.
  * If 'index' is negative, use zllength('zlist') + 'index'.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 zlget(ZList *zlist, int index, Zob **zob)
 {
+    ZError err;
+
     if (index < 0)
         index += zlist->length;
     if (index < 0 || index >= (int) zlist->length)
         return ZE_INDEX_OUT_OF_RANGE;
-    else {
-        int curidx = 0;
-        ZNode *cur = zlist->first;
-
-        while (curidx < index) {
-            cur = cur->next;
-            curidx++;
-        }
-        *zob = cur->object;
+    if (ZISMUTABLE(ZLITEM(zlist, index))) {
+        err = zlown(zlist);
+        if (err != ZE_OK)
+            return err;
     }
+    *zob = ZLITEM(zlist, index);
     return ZE_OK;
 }
 
 /* Insert 'zob' before 'index'-th position in 'zlist'.
  * If 'index' == 'length', append 'zob'.
  * If 'index' is negative, use zllength('zlist') + 'index'.
+ * Items on the shorter side of 'index' are moved.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
@@ -338,6 +396,9 @@ zlget(ZList *zlist, int index, Zob **zob)
 ZError
 zlinsert(ZList *zlist, int index, Zob *zob)
 {
+    unsigned int i;
+    ZError err;
+
     if (index < 0)
         index += zlist->length;
     if (index < 0 || index > (int) zlist->length)
@@ -346,29 +407,29 @@ zlinsert(ZList *zlist, int index, Zob *zob)
         return zlpush(zlist, zob);
     else if (index == (int) zlist->length)
         return zlappend(zlist, zob);
+    err = zlown(zlist);
+    if (err == ZE_OK)
+        err = zlreserve(zlist, zlist->length + 1);
+    if (err != ZE_OK)
+        return err;
+    if ((unsigned int) index < zlist->length / 2) {
+        zlist->head = (zlist->head - 1) & (zlist->size - 1);
+        for (i = 0; i < (unsigned int) index; i++)
+            ZLITEM(zlist, i) = ZLITEM(zlist, i + 1);
+    }
     else {
-        int curidx = 0;
-        ZNode *prev = zlist->first;
-        ZNode *next;
-        ZError err;
-
-        while (curidx < index - 1) {
-            prev = prev->next;
-            curidx++;
-        }
-        next = prev->next;
-        err = znewnode(zob, &prev->next);
-        if (err != ZE_OK)
-            return err;
-        prev->next->next = next;
+        for (i = zlist->length; i > (unsigned int) index; i--)
+            ZLITEM(zlist, i) = ZLITEM(zlist, i - 1);
     }
+    ZLITEM(zlist, index) = zob;
+    zincrefc(zob);
     zlist->length++;
     return ZE_OK;
 }
 
 /* Concatenate 'other' to 'zlist'.
  * The same pointer can be passed to both args to double 'zlist'.
- * (The local vars 'count' and 'length' prevents an infinite loop
+ * (The local var 'length' prevents an infinite loop
  * when doubling 'zlist').
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
@@ -376,70 +437,100 @@ zlinsert(ZList *zlist, int index, Zob *zob)
 ZError
 zlextend(ZList *zlist, ZList *other)
 {
-    unsigned int count = 0;
     unsigned int length = other->length;
-    ZNode *ecur = other->first;
+    unsigned int i;
     ZError err;
 
-    if (zlist->length == 0) {
-        err = znewnode(ecur->object, &zlist->first);
-        if (err != ZE_OK)
-            return err;
-        zlist->last = zlist->first;
-        zlist->length++;
-        count++;
-        ecur = ecur->next;
-    }
-    for (; count < length; count++) {
-        err = znewnode(ecur->object, &zlist->last->next);
+    err = zlown(zlist);
+    if (err == ZE_OK)
+        err = zlown(other);
+    if (err == ZE_OK)
+        err = zlreserve(zlist, zlist->length + length);
+    if (err != ZE_OK)
+        return err;
+    for (i = 0; i < length; i++) {
+        err = zlappend(zlist, ZLITEM(other, i));
         if (err != ZE_OK)
             return err;
-        zlist->last = zlist->last->next;
-        zlist->length++;
-        ecur = ecur->next;
     }
     return ZE_OK;
 }
 
 /* Remove 'index'-th item from 'zlist'.
  * If 'index' is negative, use zllength('zlist') + 'index'.
+ * Items on the shorter side of 'index' are moved.
  * If 'index' is out of range, return ZE_INDEX_OUT_OF_RANGE.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
 zlremove(ZList *zlist, int index)
 {
+    Zob *item;
+    unsigned int i;
+    ZError err;
+
     if (index < 0)
         index += zlist->length;
     if (index < 0 || index >= (int) zlist->length)
         return ZE_INDEX_OUT_OF_RANGE;
-    if (index == 0)
-        zlremfirst(zlist);
+    err = zlown(zlist);
+    if (err != ZE_OK)
+        return err;
+    item = ZLITEM(zlist, index);
+    if ((unsigned int) index < zlist->length / 2) {
+        for (i = (unsigned int) index; i > 0; i--)
+            ZLITEM(zlist, i) = ZLITEM(zlist, i - 1);
+        zlist->head = (zlist->head + 1) & (zlist->size - 1);
+    }
     else {
-        int curidx = 0;
-        ZNode *prev = zlist->first;
-        ZNode *next;
-
-        while (curidx < index - 1) {
-            prev = prev->next;
-            curidx++;
-        }
-        next = prev->next->next;
-        zdelnode(&prev->next);
-        prev->next = next;
-        zlist->length--;
+        for (i = (unsigned int) index; i < zlist->length - 1; i++)
+            ZLITEM(zlist, i) = ZLITEM(zlist, i + 1);
     }
+    zlist->length--;
+    zdecrefc(item);
     return ZE_OK;
 }
 
 /* Remove all items from 'zlist'.
- * Used by temp lists to minimize malloc() & free() calls.
+ * The buffer is kept, so temp lists can be reused
+ *  without further malloc() & free() calls.
+ * A shared buffer is left to the copies.
  */
 void
 zlempty(ZList *zlist)
 {
+    if (zunshare((Zob *) zlist)) {
+        zlist->items = NULL;
+        zlist->size = 0;
+        zlist->length = 0;
+    }
     while (zlist->length > 0)
         zlremfirst(zlist);
+    zlist->head = 0;
+}
+
+/* Release the items of 'zlist', from the last one, while '*budget'
+ *  lasts, and decrease it by the number released.
+ * Return nonzero once 'zlist' is empty.
+ */
+int
+zldrain(ZList *zlist, unsigned int *budget)
+{
+    Zob *item;
+
+    if (zunshare((Zob *) zlist)) {
+        zlist->items = NULL;
+        zlist->size = 0;
+        zlist->length = 0;
+    }
+    while (zlist->length > 0  &&  *budget > 0) {
+        item = ZLITEM(zlist, zlist->length - 1);
+        zlist->length--;
+        zdecrefc(item);
+        (*budget)--;
+    }
+    return zlist->length == 0;
 }
 
 /* If 'zob' is in 'zlist', return nonzero.
@@ -448,33 +539,26 @@ zlempty(ZList *zlist)
 int
 zlhasitem(ZList *zlist, Zob *zob)
 {
-    ZNode *item = zlist->first;
+    unsigned int i;
 
-    while (item != NULL) {
-        if (zcmpobj(item->object, zob) == 0)
+    for (i = 0; i < zlist->length; i++)
+        if (zcmpobj(ZLITEM(zlist, i), zob) == 0)
             return 1;
-        item = item->next;
-    }
     return 0;
 }
 
-/* Remove the first item from 'zlist'. */
+/* Remove the first item from 'zlist'.
+ * If there is not enough memory to do it, nothing is done.
+ */
 void
 zlremfirst(ZList *zlist)
 {
-    if (zlist->first == NULL)
-        return;
-    if (zlist->first == zlist->last) {
-        zdelnode(&zlist->first);
-        zlist->first = NULL;
-        zlist->last = NULL;
-    }
-    else {
-        ZNode *second;
+    Zob *item;
 
-        second = zlist->first->next;
-        zdelnode(&zlist->first);
-        zlist->first = second;
-    }
+    if (zlist->length == 0  ||  zlown(zlist) != ZE_OK)
+        return;
+    item = ZLITEM(zlist, 0);
+    zlist->head = (zlist->head + 1) & (zlist->size - 1);
     zlist->length--;
+    zdecrefc(item);
 }
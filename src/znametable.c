@@ -21,21 +21,50 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef ZSKIPLIST
 #include <time.h>
+#endif
 
 #include "ztypes.h"
 #include "zerr.h"
 #include "zgc.h"
+#include "zalloc.h"
+#include "zslab.h"
 
+#include "zatom.h"
 #include "znametable.h"
 
 #include "zobject.h"
 
-/* Return a pseudo-random number x, such that 0 <= x < 1. */
+#ifdef ZSKIPLIST
+
+/* Seed of the next table, from which each table seeds its own
+ *  generator, so that the clock is only read once.
+ */
+static unsigned int zseed = 0;
+
+/* Return the next number of the xorshift generator in 'state',
+ *  which must not be zero.
+ */
+static unsigned int
+zxorshift(unsigned int *state)
+{
+    unsigned int x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Return a pseudo-random number x, such that 0 <= x < 1,
+ *  from the generator of 'znable'.
+ */
 double
-zrandom()
+zrandom(ZNameTable *znable)
 {
-    return rand() / ((double) RAND_MAX + 1);
+    return (zxorshift(&znable->seed) >> 8) / 16777216.0;
 }
 
 /* Return a random level for a new entry in a skip list. */
@@ -50,33 +79,30 @@ ztrndlevel(ZNameTable *znable)
     else
         /* Dirty Hack. */
         max = znable->level + 1;
-    while (zrandom() < SLPROB && level < max)
+    while (zrandom(znable) < SLPROB && level < max)
         level++;
     return level;
 }
 
-/* Create a new ZEntry in 'zentry', with 'name' referencing 'value'.
+/* Create a new ZEntry in 'zentry', with 'atom' referencing 'value'.
  * 'level' is the level of this entry in the skip list. It should
  *  be determined by ztrndlevel() and, optionally, by the dirty hack.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-znewentry(int level, char *name, Zob *value, ZEntry **zentry)
+znewentry(int level, ZAtom *atom, Zob *value, ZEntry **zentry)
 {
     int i;
 
-    *zentry = (ZEntry *) malloc(sizeof(ZEntry));
+    *zentry = (ZEntry *) zalloc(sizeof(ZEntry));
     if (*zentry == NULL)
         return ZE_OUT_OF_MEMORY;
-    (*zentry)->name = (char *) malloc((strlen(name) + 1) * sizeof(char));
-    if ((*zentry)->name == NULL)
-        return ZE_OUT_OF_MEMORY;
-    strcpy((*zentry)->name, name);
+    (*zentry)->atom = atom;
     (*zentry)->value = value;
     if (value != EMPTY)
         zincrefc(value);
-    (*zentry)->next = (ZEntry **) malloc((level + 1) * sizeof(ZEntry *));
+    (*zentry)->next = (ZEntry **) zmalloc((level + 1) * sizeof(ZEntry *));
     if ((*zentry)->next == NULL)
         return ZE_OUT_OF_MEMORY;
     for (i = 0; i <= level; i++)
@@ -90,9 +116,8 @@ zdelentry(ZEntry **zentry)
 {
     if ((*zentry)->value != EMPTY)
         zdecrefc((*zentry)->value);
-    free((*zentry)->name);
-    free((*zentry)->next);
-    free(*zentry);
+    zmfree((*zentry)->next);
+    zfree(*zentry, sizeof(ZEntry));
     *zentry = NULL;
 }
 
@@ -103,16 +128,23 @@ zdelentry(ZEntry **zentry)
 ZError
 znewnable(ZNameTable **znable)
 {
-    /* [Re]Initialize pseudo-random number generator. */
-    srand(time(NULL));
-
-    *znable = (ZNameTable *) malloc(sizeof(ZNameTable));
+    *znable = (ZNameTable *) zalloc(sizeof(ZNameTable));
     if (*znable == NULL)
         return ZE_OUT_OF_MEMORY;
+    if (zseed == 0)
+        zseed = (unsigned int) time(NULL) | 1;
+    (*znable)->seed = zxorshift(&zseed);
     (*znable)->type = T_NMTB;
     (*znable)->refc = 0;
     (*znable)->level = 0;
-    return znewentry(SLHEIGHT - 1, "", EMPTY, &(*znable)->header);
+    (*znable)->version = 0;
+    (*znable)->share = NULL;
+    if (ztrack((Zob *) *znable) != ZE_OK) {
+        zfree(*znable, sizeof(ZNameTable));
+        *znable = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
+    return znewentry(SLHEIGHT - 1, NULL, EMPTY, &(*znable)->header);
 }
 
 /* Remove 'znable' from memory. */
@@ -121,120 +153,18 @@ zdelnable(ZNameTable **znable)
 {
     ZEntry *a, *b;
 
+    zuntrack((Zob *) *znable);
     a = (*znable)->header;
     do {
         b = a->next[0];
         zdelentry(&a);
         a = b;
     } while (a != NULL);
-    free(*znable);
+    zfree(*znable, sizeof(ZNameTable));
     *znable = NULL;
 }
 
-/* Create a new copy of 'source' in 'dest'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-zcpynable(ZNameTable *source, ZNameTable **dest)
-{
-    ZError err;
-    ZEntry *zentry;
-
-    err = znewnable(dest);
-    if (err != ZE_OK)
-        return err;
-    zentry = source->header->next[0];
-    while (zentry != NULL) {
-        err = ztset(*dest, zentry->name, zentry->value);
-        if (err != ZE_OK)
-            return err;
-        zentry = zentry->next[0];
-    }
-    return ZE_OK;
-}
-
-/* Test the truth value of 'znable'.
- * If 'znable' is empty, return zero.
- * Otherwise, return nonzero.
- */
-int
-ztstnable(ZNameTable *znable)
-{
-    if (znable->header->next[0] != NULL)
-        return 1;
-    else
-        return 0;
-}
-
-/* Compare 'znable' and 'other'.
- * If they are equal, return zero.
- * Otherwise, return nonzero.
- */
-int
-zcmpnable(ZNameTable *znable, ZNameTable *other)
-{
-    ZEntry *zentry_a;
-    ZEntry *zentry_b;
-
-    zentry_a = znable->header->next[0];
-    zentry_b = other->header->next[0];
-    while (zentry_a != NULL && zentry_b != NULL) {
-        if (strcmp(zentry_a->name, zentry_b->name) != 0)
-            return 1;
-        if (zcmpobj(zentry_a->value, zentry_b->value) != 0)
-            return 1;
-        zentry_a = zentry_a->next[0];
-        zentry_b = zentry_b->next[0];
-    }
-    if (zentry_a != NULL || zentry_b != NULL)
-        return 1;
-    return 0;
-}
-
-/* Print the textual representation of 'znable' on 'buffer'.
- * Return the number of bytes writen.
- */
-int
-zrepnable(char *buffer, size_t size, ZNameTable *znable)
-{
-    if (znable->header->next[0] == NULL)
-        return snprintf(buffer, size, "<Empty NameTable>");
-    else {
-        char nodebff[256];
-        ZEntry *cur = znable->header->next[0];
-        /* buffer length to return */
-        int blen = 1;
-
-        *buffer = '{';
-        while (1) {
-            if (cur->next[0] == NULL) {
-                blen += snprintf(buffer + blen,
-                                 size,
-                                 "%s:",
-                                 cur->name);
-                zrepobj(nodebff, 256, cur->value);
-                blen += snprintf(buffer + blen,
-                                 size,
-                                 "%s}",
-                                 nodebff);
-                break;
-            }
-            blen += snprintf(buffer + blen,
-                             size,
-                             "%s:",
-                             cur->name);
-            zrepobj(nodebff, 256, cur->value);
-            blen += snprintf(buffer + blen,
-                             size,
-                             "%s ",
-                             nodebff);
-            cur = cur->next[0];
-        }
-        return blen;
-    }
-}
-
+/* Print the structure of 'znable', for debugging. */
 void
 zrepnable_detail(ZNameTable *znable)
 {
@@ -271,6 +201,20 @@ zrepnable_detail(ZNameTable *znable)
     puts("");
 }
 
+/* Return the first entry of 'znable', or NULL if it is empty. */
+ZEntry *
+ztfirst(ZNameTable *znable)
+{
+    return znable->header->next[0];
+}
+
+/* Return the entry after 'zentry' in 'znable', or NULL if there is none. */
+ZEntry *
+ztnext(ZNameTable *znable, ZEntry *zentry)
+{
+    return zentry->next[0];
+}
+
 /* Return the number of name-value pairs in 'znable'. */
 unsigned int
 ztlength(ZNameTable *znable)
@@ -286,23 +230,23 @@ ztlength(ZNameTable *znable)
     return len;
 }
 
-/* Define or redefine 'name' in 'znable'.
+/* Define or redefine 'atom' in 'znable'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-ztset(ZNameTable *znable, char *name, Zob *value)
+ztsetatom(ZNameTable *znable, ZAtom *atom, Zob *value)
 {
     ZEntry *zentry;
     ZEntry *update[SLHEIGHT];
     int found, i;
     ZError err;
 
-    /* Seek name. */
+    /* Seek atom. */
     zentry = znable->header;
     for (i = znable->level; i >= 0; i--) {
         while (zentry->next[i] != NULL) {
-            if (strcmp(zentry->next[i]->name, name) >= 0)
+            if (zentry->next[i]->atom->id >= atom->id)
                 break;
             zentry = zentry->next[i];
         }
@@ -311,7 +255,7 @@ ztset(ZNameTable *znable, char *name, Zob *value)
     zentry = zentry->next[0];
     found = (zentry != NULL);
     if (found)
-        found = (strcmp(zentry->name, name) == 0);
+        found = (zentry->atom == atom);
     if (found) {
         /* Set value. */
         zdecrefc(zentry->value);
@@ -328,9 +272,10 @@ ztset(ZNameTable *znable, char *name, Zob *value)
             znable->level++;
             update[level] = znable->header;
         }
-        err = znewentry(level, name, value, &zentry);
+        err = znewentry(level, atom, value, &zentry);
         if (err != ZE_OK)
             return err;
+        znable->version++;
         /* Place the entry in the skip list. */
         for (i = 0; i <= level; i++) {
             zentry->next[i] = update[i]->next[i];
@@ -340,82 +285,51 @@ ztset(ZNameTable *znable, char *name, Zob *value)
     return ZE_OK;
 }
 
-/* If 'name' is in 'znable', copy its value to 'value' and return nonzero.
- * Otherwise, return zero.
- */
-int
-ztget(ZNameTable *znable, char *name, Zob **value)
+/* Return the entry of 'atom' in 'znable', or NULL if there is none. */
+static ZEntry *
+ztlookup(ZNameTable *znable, ZAtom *atom)
 {
     ZEntry *zentry;
-    int found, i;
+    int i;
 
-    /* Seek name. */
+    /* Seek atom. */
     zentry = znable->header;
     for (i = znable->level; i >= 0; i--) {
         while (zentry->next[i] != NULL) {
-            if (strcmp(zentry->next[i]->name, name) >= 0)
+            if (zentry->next[i]->atom->id >= atom->id)
                 break;
             zentry = zentry->next[i];
         }
     }
     zentry = zentry->next[0];
-    found = (zentry != NULL);
-    if (found)
-        found = (strcmp(zentry->name, name) == 0);
-    if (found) {
-        /* Get value. */
-        *value = zentry->value;
-        return 1;
-    }
+    if (zentry != NULL && zentry->atom == atom)
+        return zentry;
     /* Name not found. */
-    return 0;
-}
-
-/* Define or redefine all items from 'other' to 'znable'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-ztupdate(ZNameTable *znable, ZNameTable *other)
-{
-    ZError err;
-    ZEntry *zentry;
-
-    zentry = other->header->next[0];
-    while (zentry != NULL) {
-        err = ztset(znable, zentry->name, zentry->value);
-        if (err != ZE_OK)
-            return err;
-        zentry = zentry->next[0];
-    }
-    return ZE_OK;
+    return NULL;
 }
 
-/* If 'name' is in 'znable', remove its pair from 'znable' and return nonzero.
+/* If 'atom' is in 'znable', remove its pair from 'znable' and return nonzero.
  * Otherwise, return zero.
  */
 int
-ztremove(ZNameTable *znable, char *name)
+ztremoveatom(ZNameTable *znable, ZAtom *atom)
 {
     ZEntry *zentry;
     ZEntry *update[SLHEIGHT];
-    int found, i;
+    int i;
 
-    /* Seek name. */
+    /* Seek atom. */
     zentry = znable->header;
     for (i = znable->level; i >= 0; i--) {
         while (zentry->next[i] != NULL) {
-            if (strcmp(zentry->next[i]->name, name) >= 0)
+            if (zentry->next[i]->atom->id >= atom->id)
                 break;
             zentry = zentry->next[i];
         }
         update[i] = zentry;
     }
     zentry = zentry->next[0];
-    found = (zentry != NULL);
-    if (found)
-        found = (strcmp(zentry->name, name) == 0);
-    if (found) {
+    if (zentry != NULL && zentry->atom == atom) {
         /* Remove pair. */
         for (i = 0; i <= znable->level; i++) {
             if (update[i]->next[i] != zentry)
@@ -423,6 +337,7 @@ ztremove(ZNameTable *znable, char *name)
             update[i]->next[i] = zentry->next[i];
         }
         zdelentry(&zentry);
+        znable->version++;
         while (znable->level > 0  &&
                znable->header->next[znable->level] == NULL)
             znable->level--;
@@ -447,34 +362,602 @@ ztempty(ZNameTable *znable)
     }
     for (i = 0; i < SLHEIGHT; i++)
         znable->header->next[i] = NULL;
+    znable->version++;
 }
 
-/* If 'name' is in 'znable', return nonzero.
- * Otherwise, return zero.
+/* Delete the entries of 'znable', from the first one, while '*budget'
+ *  lasts, and decrease it by the number deleted.
+ * Only meant for a table that is being deleted: only the bottom level
+ *  of the skip list is kept linked.
+ * Return nonzero once 'znable' is empty.
  */
 int
-zthasname(ZNameTable *znable, char *name)
+ztdrain(ZNameTable *znable, unsigned int *budget)
+{
+    ZEntry *a;
+
+    while (znable->header->next[0] != NULL  &&  *budget > 0) {
+        a = znable->header->next[0];
+        znable->header->next[0] = a->next[0];
+        zdelentry(&a);
+        (*budget)--;
+    }
+    return znable->header->next[0] == NULL;
+}
+
+/* Create a new copy of 'source' in 'dest'.
+ * Skip lists do not share entries, so they are copied at once.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zcpynable(ZNameTable *source, ZNameTable **dest)
 {
+    ZError err;
     ZEntry *zentry;
-    int found, i;
 
-    /* Seek name. */
-    zentry = znable->header;
-    for (i = znable->level; i >= 0; i--) {
-        while (zentry->next[i] != NULL) {
-            if (strcmp(zentry->next[i]->name, name) >= 0)
-                break;
-            zentry = zentry->next[i];
+    err = znewnable(dest);
+    if (err != ZE_OK)
+        return err;
+    for (zentry = ztfirst(source);
+         zentry != NULL;
+         zentry = ztnext(source, zentry)) {
+        err = ztsetatom(*dest, zentry->atom, zentry->value);
+        if (err != ZE_OK)
+            return err;
+    }
+    return ZE_OK;
+}
+
+/* Skip lists never share entries. */
+static ZError
+ztown(ZNameTable *znable)
+{
+    return ZE_OK;
+}
+
+#else
+
+/* Tombstone of a removed entry. */
+static ZAtom ztomb;
+
+static ZError ztown(ZNameTable *znable);
+
+/* Return the home slot of 'atom' in a table with 'size' slots.
+ * Atom ids are consecutive, so they are scrambled first.
+ */
+static unsigned int
+zthash(ZAtom *atom, unsigned int size)
+{
+    unsigned int h = atom->id * 2654435769U;
+
+    return (h ^ (h >> 16)) & (size - 1);
+}
+
+/* Return the slot holding 'atom' in 'znable', or NULL if there is none. */
+static ZEntry *
+ztlookup(ZNameTable *znable, ZAtom *atom)
+{
+    unsigned int mask = znable->size - 1;
+    unsigned int i;
+
+    if (znable->size == 0)
+        return NULL;
+    i = zthash(atom, znable->size);
+    while (znable->slots[i].atom != NULL) {
+        if (znable->slots[i].atom == atom)
+            return &znable->slots[i];
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+/* Move the entries of 'znable' to a new array of 'size' slots,
+ *  dropping tombstones.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+ztresize(ZNameTable *znable, unsigned int size)
+{
+    ZEntry *slots;
+    unsigned int i, j;
+
+    slots = (ZEntry *) zcalloc(size, sizeof(ZEntry));
+    if (slots == NULL)
+        return ZE_OUT_OF_MEMORY;
+    for (i = 0; i < znable->size; i++) {
+        ZAtom *atom = znable->slots[i].atom;
+
+        if (atom == NULL || atom == &ztomb)
+            continue;
+        j = zthash(atom, size);
+        while (slots[j].atom != NULL)
+            j = (j + 1) & (size - 1);
+        slots[j] = znable->slots[i];
+    }
+    zmfree(znable->slots);
+    znable->slots = slots;
+    znable->size = size;
+    znable->used = znable->count;
+    znable->version++;
+    return ZE_OK;
+}
+
+/* Create a new ZNameTable in 'znable'.
+ * Slots are only allocated on the first definition.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewnable(ZNameTable **znable)
+{
+    *znable = (ZNameTable *) zalloc(sizeof(ZNameTable));
+    if (*znable == NULL)
+        return ZE_OUT_OF_MEMORY;
+    (*znable)->type = T_NMTB;
+    (*znable)->refc = 0;
+    (*znable)->size = 0;
+    (*znable)->count = 0;
+    (*znable)->used = 0;
+    (*znable)->slots = NULL;
+    (*znable)->version = 0;
+    (*znable)->share = NULL;
+    if (ztrack((Zob *) *znable) != ZE_OK) {
+        zfree(*znable, sizeof(ZNameTable));
+        *znable = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
+    return ZE_OK;
+}
+
+/* Remove 'znable' from memory. */
+void
+zdelnable(ZNameTable **znable)
+{
+    zuntrack((Zob *) *znable);
+    ztempty(*znable);
+    zmfree((*znable)->slots);
+    zfree(*znable, sizeof(ZNameTable));
+    *znable = NULL;
+}
+
+/* Print the slots of 'znable', for debugging.
+ * Free slots are shown as "-" and tombstones as "~".
+ */
+void
+zrepnable_detail(ZNameTable *znable)
+{
+    unsigned int i;
+
+    printf("%u/%u entries, %u used\n",
+           znable->count, znable->size, znable->used);
+    for (i = 0; i < znable->size; i++) {
+        ZAtom *atom = znable->slots[i].atom;
+
+        if (atom == NULL)
+            printf("%03u -\n", i);
+        else if (atom == &ztomb)
+            printf("%03u ~\n", i);
+        else
+            printf("%03u %s (home %03u)\n",
+                   i, atom->name, zthash(atom, znable->size));
+    }
+}
+
+/* Return the first entry of 'znable', or NULL if it is empty. */
+ZEntry *
+ztfirst(ZNameTable *znable)
+{
+    ZEntry *zentry = znable->slots;
+    ZEntry *end = znable->slots + znable->size;
+
+    for (; zentry < end; zentry++)
+        if (zentry->atom != NULL && zentry->atom != &ztomb)
+            return zentry;
+    return NULL;
+}
+
+/* Return the entry after 'zentry' in 'znable', or NULL if there is none.
+ * Entries are visited in slot order.
+ */
+ZEntry *
+ztnext(ZNameTable *znable, ZEntry *zentry)
+{
+    ZEntry *end = znable->slots + znable->size;
+
+    for (zentry++; zentry < end; zentry++)
+        if (zentry->atom != NULL && zentry->atom != &ztomb)
+            return zentry;
+    return NULL;
+}
+
+/* Return the number of name-value pairs in 'znable'. */
+unsigned int
+ztlength(ZNameTable *znable)
+{
+    return znable->count;
+}
+
+/* Define or redefine 'atom' in 'znable'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+ztsetatom(ZNameTable *znable, ZAtom *atom, Zob *value)
+{
+    ZEntry *zentry, *tomb = NULL;
+    unsigned int i;
+    ZError err;
+
+    err = ztown(znable);
+    if (err != ZE_OK)
+        return err;
+    zentry = ztlookup(znable, atom);
+    if (zentry != NULL) {
+        /* Set value. */
+        zincrefc(value);
+        zdecrefc(zentry->value);
+        zentry->value = value;
+        return ZE_OK;
+    }
+    /* New entry. Keep the load (tombstones included) under 3/4. */
+    if ((znable->used + 1) * 4 > znable->size * 3) {
+        unsigned int size = NTMINSIZE;
+
+        while ((znable->count + 1) * 2 > size)
+            size *= 2;
+        err = ztresize(znable, size);
+        if (err != ZE_OK)
+            return err;
+    }
+    /* Reuse the first tombstone on the probe sequence, if any. */
+    i = zthash(atom, znable->size);
+    while (znable->slots[i].atom != NULL) {
+        if (znable->slots[i].atom == &ztomb && tomb == NULL)
+            tomb = &znable->slots[i];
+        i = (i + 1) & (znable->size - 1);
+    }
+    if (tomb != NULL)
+        zentry = tomb;
+    else {
+        zentry = &znable->slots[i];
+        znable->used++;
+    }
+    zentry->atom = atom;
+    zentry->value = value;
+    zincrefc(value);
+    znable->count++;
+    znable->version++;
+    return ZE_OK;
+}
+
+/* If 'atom' is in 'znable', remove its pair from 'znable' and return nonzero.
+ * Otherwise, or if there is not enough memory to do it, return zero.
+ */
+int
+ztremoveatom(ZNameTable *znable, ZAtom *atom)
+{
+    ZEntry *zentry = ztlookup(znable, atom);
+    Zob *value;
+
+    if (zentry == NULL  ||  ztown(znable) != ZE_OK)
+        return 0;
+    zentry = ztlookup(znable, atom);
+    value = zentry->value;
+    zentry->atom = &ztomb;
+    zentry->value = NULL;
+    znable->count--;
+    znable->version++;
+    zdecrefc(value);
+    return 1;
+}
+
+/* Delete all name-value pairs in 'znable'.
+ * Shared slots are left to the copies.
+ */
+void
+ztempty(ZNameTable *znable)
+{
+    unsigned int i;
+
+    if (zunshare((Zob *) znable)) {
+        znable->slots = NULL;
+        znable->size = 0;
+    }
+    for (i = 0; i < znable->size; i++) {
+        ZAtom *atom = znable->slots[i].atom;
+
+        if (atom != NULL && atom != &ztomb)
+            zdecrefc(znable->slots[i].value);
+        znable->slots[i].atom = NULL;
+        znable->slots[i].value = NULL;
+    }
+    znable->count = 0;
+    znable->used = 0;
+    znable->version++;
+}
+
+/* Delete the entries of 'znable', from the last slot, while '*budget'
+ *  lasts, and decrease it by the number of slots visited.
+ * Only meant for a table that is being deleted: the slots are cut off.
+ * Return nonzero once 'znable' is empty.
+ */
+int
+ztdrain(ZNameTable *znable, unsigned int *budget)
+{
+    ZEntry *zentry;
+
+    if (zunshare((Zob *) znable)) {
+        znable->slots = NULL;
+        znable->size = 0;
+        znable->count = 0;
+    }
+    while (znable->size > 0  &&  *budget > 0) {
+        zentry = &znable->slots[--znable->size];
+        if (zentry->atom != NULL  &&  zentry->atom != &ztomb) {
+            zentry->atom = NULL;
+            znable->count--;
+            zdecrefc(zentry->value);
         }
+        (*budget)--;
     }
-    zentry = zentry->next[0];
-    found = (zentry != NULL);
-    if (found)
-        found = (strcmp(zentry->name, name) == 0);
-    if (found) {
-        /* Name found. */
+    return znable->size == 0;
+}
+
+/* Create a new copy of 'source' in 'dest'.
+ * 'dest' shares the slots of 'source' until either is changed.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zcpynable(ZNameTable *source, ZNameTable **dest)
+{
+    ZError err;
+
+    err = znewnable(dest);
+    if (err != ZE_OK  ||  source->count == 0)
+        return err;
+    err = zshare((Zob *) source, (Zob *) *dest);
+    if (err != ZE_OK) {
+        zdelnable(dest);
+        return err;
+    }
+    (*dest)->size = source->size;
+    (*dest)->count = source->count;
+    (*dest)->used = source->used;
+    (*dest)->slots = source->slots;
+    return ZE_OK;
+}
+
+/* Give 'znable' slots of its own, if it shares them with copies.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+ztown(ZNameTable *znable)
+{
+    ZEntry *slots;
+    unsigned int i;
+
+    if (znable->share == NULL)
+        return ZE_OK;
+    if (znable->share->count > 1) {
+        slots = (ZEntry *) zmalloc(znable->size * sizeof(ZEntry));
+        if (slots == NULL)
+            return ZE_OUT_OF_MEMORY;
+        memcpy(slots, znable->slots, znable->size * sizeof(ZEntry));
+        for (i = 0; i < znable->size; i++)
+            if (slots[i].atom != NULL  &&  slots[i].atom != &ztomb)
+                zincrefc(slots[i].value);
+        znable->slots = slots;
+        znable->version++;
+    }
+    (void) zunshare((Zob *) znable);
+    return ZE_OK;
+}
+
+#endif
+
+/* If 'atom' is in 'znable', return its entry, to be changed in place.
+ * Otherwise, or if there is not enough memory to do it, return NULL.
+ */
+ZEntry *
+ztfindatom(ZNameTable *znable, ZAtom *atom)
+{
+    if (ztown(znable) != ZE_OK)
+        return NULL;
+    return ztlookup(znable, atom);
+}
+
+/* Test the truth value of 'znable'.
+ * If 'znable' is empty, return zero.
+ * Otherwise, return nonzero.
+ */
+int
+ztstnable(ZNameTable *znable)
+{
+    if (ztfirst(znable) != NULL)
+        return 1;
+    else
+        return 0;
+}
+
+/* Compare 'znable' and 'other'.
+ * If they are equal, return zero.
+ * Otherwise, return nonzero.
+ */
+int
+zcmpnable(ZNameTable *znable, ZNameTable *other)
+{
+    ZEntry *zentry;
+    Zob *value;
+
+    if (ztlength(znable) != ztlength(other))
         return 1;
+    for (zentry = ztfirst(znable);
+         zentry != NULL;
+         zentry = ztnext(znable, zentry)) {
+        if (!ztgetatom(other, zentry->atom, &value))
+            return 1;
+        if (zcmpobj(zentry->value, value) != 0)
+            return 1;
     }
-    /* Name not found. */
     return 0;
 }
+
+/* Return the hash of 'znable'.
+ * Entries are combined regardless of their order, as in zcmpnable().
+ */
+unsigned int
+zhashnable(ZNameTable *znable)
+{
+    ZEntry *zentry;
+    unsigned int hash = ztlength(znable);
+
+    for (zentry = ztfirst(znable);
+         zentry != NULL;
+         zentry = ztnext(znable, zentry))
+        hash += (zentry->atom->id * 2654435769U) ^ zhashobj(zentry->value);
+    return hash;
+}
+
+/* Compare the names of two entries, for qsort(). */
+static int
+zcmpentries(const void *a, const void *b)
+{
+    return strcmp((*(ZEntry **) a)->atom->name, (*(ZEntry **) b)->atom->name);
+}
+
+/* Print the textual representation of 'znable' on 'buffer'.
+ * Names are printed in alphabetical order.
+ * Return the number of bytes writen.
+ */
+int
+zrepnable(char *buffer, size_t size, ZNameTable *znable)
+{
+    if (ztfirst(znable) == NULL)
+        return snprintf(buffer, size, "<Empty NameTable>");
+    else {
+        char nodebff[256];
+        ZEntry **sorted;
+        ZEntry *cur;
+        unsigned int length, i;
+        /* buffer length to return */
+        int blen = 1;
+
+        length = ztlength(znable);
+        sorted = (ZEntry **) zmalloc(length * sizeof(ZEntry *));
+        if (sorted == NULL)
+            return snprintf(buffer, size, "<NameTable>");
+        cur = ztfirst(znable);
+        for (i = 0; i < length; i++) {
+            sorted[i] = cur;
+            cur = ztnext(znable, cur);
+        }
+        qsort(sorted, length, sizeof(ZEntry *), zcmpentries);
+        *buffer = '{';
+        for (i = 0; i < length; i++) {
+            cur = sorted[i];
+            blen += snprintf(buffer + blen,
+                             size,
+                             "%s:",
+                             cur->atom->name);
+            zrepobj(nodebff, 256, cur->value);
+            blen += snprintf(buffer + blen,
+                             size,
+                             (i == length - 1) ? "%s}" : "%s ",
+                             nodebff);
+        }
+        zmfree(sorted);
+        return blen;
+    }
+}
+
+/* Define or redefine 'name' in 'znable'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+ztset(ZNameTable *znable, char *name, Zob *value)
+{
+    ZAtom *atom;
+    ZError err;
+
+    err = zintern(name, &atom);
+    if (err != ZE_OK)
+        return err;
+    return ztsetatom(znable, atom, value);
+}
+
+/* If 'atom' is in 'znable', copy its value to 'value' and return nonzero.
+ * Otherwise, return zero.
+ */
+int
+ztgetatom(ZNameTable *znable, ZAtom *atom, Zob **value)
+{
+    ZEntry *zentry = ztlookup(znable, atom);
+
+    if (zentry == NULL)
+        return 0;
+    *value = zentry->value;
+    return 1;
+}
+
+/* If 'name' is in 'znable', copy its value to 'value' and return nonzero.
+ * Otherwise, return zero.
+ */
+int
+ztget(ZNameTable *znable, char *name, Zob **value)
+{
+    ZAtom *atom = zfindatom(name);
+
+    /* A name never interned is not in any table. */
+    if (atom == NULL)
+        return 0;
+    return ztgetatom(znable, atom, value);
+}
+
+/* Define or redefine all items from 'other' to 'znable'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+ztupdate(ZNameTable *znable, ZNameTable *other)
+{
+    ZError err;
+    ZEntry *zentry;
+
+    for (zentry = ztfirst(other);
+         zentry != NULL;
+         zentry = ztnext(other, zentry)) {
+        err = ztsetatom(znable, zentry->atom, zentry->value);
+        if (err != ZE_OK)
+            return err;
+    }
+    return ZE_OK;
+}
+
+/* If 'name' is in 'znable', remove its pair from 'znable' and return nonzero.
+ * Otherwise, return zero.
+ */
+int
+ztremove(ZNameTable *znable, char *name)
+{
+    ZAtom *atom = zfindatom(name);
+
+    if (atom == NULL)
+        return 0;
+    return ztremoveatom(znable, atom);
+}
+
+/* If 'name' is in 'znable', return nonzero.
+ * Otherwise, return zero.
+ */
+int
+zthasname(ZNameTable *znable, char *name)
+{
+    Zob *value;
+
+    return ztget(znable, name, &value);
+}
@@ -26,44 +26,11 @@
 
 #include "znone.h"
 
-/* Create a new ZNone in 'znone'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-znewnone(ZNone **znone)
-{
-    *znone = (ZNone *) malloc(sizeof(ZNone));
-    if (*znone == NULL)
-        return ZE_OUT_OF_MEMORY;
-    (*znone)->type = T_NONE;
-    (*znone)->refc = 0;
-    return ZE_OK;
-}
-
-/* Remove 'znone' from memory. */
-void
-zdelnone(ZNone **znone)
-{
-    free(*znone);
-    *znone = NULL;
-}
-
-/* Create a new copy of 'source' in 'dest'.
- * If there is not enough memory, return ZE_OUT_OF_MEMORY.
- * Otherwise, return ZE_OK.
- */
-ZError
-zcpynone(ZNone *source, ZNone **dest)
-{
-    return znewnone(dest);
-}
-
 /* Test the truth value of 'znone'.
  * Always return zero.
  */
 int
-ztstnone(ZNone *znone)
+ztstnone(Zob *znone)
 {
     return 0;
 }
@@ -72,7 +39,7 @@ ztstnone(ZNone *znone)
  * Always return zero.
  */
 int
-zcmpnone(ZNone *znone, ZNone *other)
+zcmpnone(Zob *znone, Zob *other)
 {
     return 0;
 }
@@ -81,7 +48,7 @@ zcmpnone(ZNone *znone, ZNone *other)
  * Return the number of bytes writen.
  */
 int
-zrepnone(char *buffer, size_t size, ZNone *znone)
+zrepnone(char *buffer, size_t size, Zob *znone)
 {
     return snprintf(buffer, size, "NONE");
 }
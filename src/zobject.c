@@ -27,6 +27,8 @@
 
 #include "ztypes.h"
 #include "zerr.h"
+#include "zgc.h"
+#include "zalloc.h"
 
 #include "znone.h"
 #include "zbool.h"
@@ -35,28 +37,24 @@
 #include "zbytearray.h"
 #include "zbignum.h"
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
 #include "zdict.h"
 #include "zfunc.h"
 
 #include "zobject.h"
+#include "zruntime.h"
 
 /* Remove 'zob' from memory. */
 void
 zdelobj(Zob **zob)
 {
+    /* Immediate objects are not in memory. */
+    if (ZIMMEDIATE(*zob))
+        return;
     switch (**zob) {
         case EMPTY:
             break;
-        case T_NONE:
-            zdelnone((ZNone **) zob);
-            break;
-        case T_BOOL:
-            zdelbool((ZBool **) zob);
-            break;
-        case T_BYTE:
-            zdelbyte((ZByte **) zob);
-            break;
         case T_INT:
             zdelint((ZInt **) zob);
             break;
@@ -78,6 +76,9 @@ zdelobj(Zob **zob)
         case T_FUNC:
             zdelfunc((ZFunc **) zob);
             break;
+        case T_GEN:
+            zdelgen((ZGen **) zob);
+            break;
         default:
             zraiseUnknownTypeNumber("zdelobj", **zob);
     }
@@ -91,17 +92,17 @@ zdelobj(Zob **zob)
 ZError
 zcpyobj(Zob *source, Zob **dest)
 {
-    switch (*source) {
+    switch (ZTYPE(source)) {
         case EMPTY:
             return EMPTY;
         case T_NONE:
-            return zcpynone((ZNone *) source, (ZNone **) dest);
         case T_BOOL:
-            return zcpybool((ZBool *) source, (ZBool **) dest);
         case T_BYTE:
-            return zcpybyte((ZByte *) source, (ZByte **) dest);
+            /* Immediate objects are their own copy. */
+            *dest = source;
+            return ZE_OK;
         case T_INT:
-            return zcpyint((ZInt *) source, (ZInt **) dest);
+            return zcpyint(source, dest);
         case T_YARR:
             return zcpyyarr((ZByteArray *) source, (ZByteArray **) dest);
         case T_BNUM:
@@ -114,6 +115,10 @@ zcpyobj(Zob *source, Zob **dest)
             return zcpydict((ZDict *) source, (ZDict **) dest);
         case T_FUNC:
             return zcpyfunc((ZFunc *) source, (ZFunc **) dest);
+        case T_GEN:
+            /* A suspended call cannot be duplicated. */
+            *dest = source;
+            return ZE_OK;
         default:
             return ZE_UNKNOWN_TYPE_NUMBER;
     }
@@ -137,17 +142,17 @@ zcpyobj(Zob *source, Zob **dest)
 int
 ztstobj(Zob *zob)
 {
-    switch (*zob) {
+    switch (ZTYPE(zob)) {
         case EMPTY:
             return 0;
         case T_NONE:
-            return ztstnone((ZNone *) zob);
+            return ztstnone(zob);
         case T_BOOL:
-            return ztstbool((ZBool *) zob);
+            return ztstbool(zob);
         case T_BYTE:
-            return ztstbyte((ZByte *) zob);
+            return ztstbyte(zob);
         case T_INT:
-            return ztstint((ZInt *) zob);
+            return ztstint(zob);
         case T_YARR:
             return ztstyarr((ZByteArray *) zob);
         case T_BNUM:
@@ -160,8 +165,10 @@ ztstobj(Zob *zob)
             return ztstdict((ZDict *) zob);
         case T_FUNC:
             return ztstfunc((ZFunc *) zob);
+        case T_GEN:
+            return 1;
         default:
-            zraiseUnknownTypeNumber("ztstobj", *zob);
+            zraiseUnknownTypeNumber("ztstobj", ZTYPE(zob));
     }
     return 0;
 }
@@ -173,19 +180,19 @@ ztstobj(Zob *zob)
 int
 zcmpobj(Zob *zob, Zob *other)
 {
-    if (*zob != *other)
+    if (ZTYPE(zob) != ZTYPE(other))
         return 1;
-    switch (*zob) {
+    switch (ZTYPE(zob)) {
         case EMPTY:
             return 0;
         case T_NONE:
-            return zcmpnone((ZNone *) zob, (ZNone *) other);
+            return zcmpnone(zob, other);
         case T_BOOL:
-            return zcmpbool((ZBool *) zob, (ZBool *) other);
+            return zcmpbool(zob, other);
         case T_BYTE:
-            return zcmpbyte((ZByte *) zob, (ZByte *) other);
+            return zcmpbyte(zob, other);
         case T_INT:
-            return zcmpint((ZInt *) zob, (ZInt *) other);
+            return zcmpint(zob, other);
         case T_YARR:
             return zcmpyarr((ZByteArray *) zob, (ZByteArray *) other);
         case T_BNUM:
@@ -198,29 +205,68 @@ zcmpobj(Zob *zob, Zob *other)
             return zcmpdict((ZDict *) zob, (ZDict *) other);
         case T_FUNC:
             return zcmpfunc((ZFunc *) zob, (ZFunc *) other);
+        case T_GEN:
+            /* Generators are equal only to themselves. */
+            return zob != other;
         default:
-            zraiseUnknownTypeNumber("zcmpobj", *zob);
+            zraiseUnknownTypeNumber("zcmpobj", ZTYPE(zob));
     }
     return 1;
 }
 
+/* Return the hash of 'zob'.
+ * Objects that compare equal with zcmpobj() have the same hash.
+ */
+unsigned int
+zhashobj(Zob *zob)
+{
+    switch (ZTYPE(zob)) {
+        case EMPTY:
+            return 0;
+        case T_NONE:
+        case T_BOOL:
+        case T_BYTE:
+            /* Immediate objects are equal only to themselves. */
+            return (unsigned int) ((uintptr_t) zob >> 1);
+        case T_INT:
+            return zhashint(zob);
+        case T_YARR:
+            return zhashyarr((ZByteArray *) zob);
+        case T_BNUM:
+            return zhashbnum((ZBigNum *) zob);
+        case T_LIST:
+            return zhashlist((ZList *) zob);
+        case T_NMTB:
+            return zhashnable((ZNameTable *) zob);
+        case T_DICT:
+            return zhashdict((ZDict *) zob);
+        case T_FUNC:
+            return zhashfunc((ZFunc *) zob);
+        case T_GEN:
+            return (unsigned int) ((uintptr_t) zob >> 3);
+        default:
+            zraiseUnknownTypeNumber("zhashobj", ZTYPE(zob));
+    }
+    return 0;
+}
+
 /* Print the textual representation of 'zob' on 'buffer'.
  * Return the number of bytes writen.
  */
 int
 zrepobj(char *buffer, size_t size, Zob *zob)
 {
-    switch (*zob) {
+    switch (ZTYPE(zob)) {
         case EMPTY:
             return 0;
         case T_NONE:
-            return zrepnone(buffer, size, (ZNone *) zob);
+            return zrepnone(buffer, size, zob);
         case T_BOOL:
-            return zrepbool(buffer, size, (ZBool *) zob);
+            return zrepbool(buffer, size, zob);
         case T_BYTE:
-            return zrepbyte(buffer, size, (ZByte *) zob);
+            return zrepbyte(buffer, size, zob);
         case T_INT:
-            return zrepint(buffer, size, (ZInt *) zob);
+            return zrepint(buffer, size, zob);
         case T_YARR:
             return zrepyarr(buffer, size, (ZByteArray *) zob);
         case T_BNUM:
@@ -233,8 +279,10 @@ zrepobj(char *buffer, size_t size, Zob *zob)
             return zrepdict(buffer, size, (ZDict *) zob);
         case T_FUNC:
             return zrepfunc(buffer, size, (ZFunc *) zob);
+        case T_GEN:
+            return zrepgen(buffer, size, (ZGen *) zob);
         default:
-            zraiseUnknownTypeNumber("zrepobj", *zob);
+            zraiseUnknownTypeNumber("zrepobj", ZTYPE(zob));
     }
     return 0;
 }
@@ -249,7 +297,7 @@ ztypename(Zob *zob, Zob **name)
 {
     ZError err = ZE_OK;
 
-    switch (*zob) {
+    switch (ZTYPE(zob)) {
         case EMPTY:
             err = zyarrfromstr((ZByteArray **) name, "EMPTY");
             break;
@@ -283,6 +331,9 @@ ztypename(Zob *zob, Zob **name)
         case T_FUNC:
             err = zyarrfromstr((ZByteArray **) name, "Func");
             break;
+        case T_GEN:
+            err = zyarrfromstr((ZByteArray **) name, "Generator");
+            break;
         default:
             return ZE_UNKNOWN_TYPE_NUMBER;
     }
@@ -27,10 +27,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#if defined(__unix__)  ||  defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
 #include "ztypes.h"
 #include "zerr.h"
 #include "zgc.h"
+#include "zalloc.h"
+#include "zslab.h"
 
 #include "znone.h"
 #include "zbool.h"
@@ -39,6 +44,7 @@
 #include "zbytearray.h"
 #include "zbignum.h"
 #include "zlist.h"
+#include "zatom.h"
 #include "znametable.h"
 #include "zdict.h"
 #include "zfunc.h"
@@ -46,6 +52,126 @@
 #include "zobject.h"
 
 #include "zruntime.h"
+#include "zbuiltin.h"
+#include "zvm.h"
+
+/* Empty 'pool'.
+ * Its constants are immortal and deleted along with the context.
+ */
+static void
+zdelpool(ZPool *pool)
+{
+    zmfree(pool->keys);
+    zmfree(pool->values);
+    pool->keys = NULL;
+    pool->values = NULL;
+    pool->size = pool->count = 0;
+}
+
+/* Return the index of 'key' in 'pool', or of the empty bucket where
+ *  it would be inserted.
+ */
+static unsigned int
+zpoolindex(ZPool *pool, char *key)
+{
+    unsigned int i;
+
+    i = (unsigned int) (((uintptr_t) key * 2654435761u) & (pool->size - 1));
+    while (pool->keys[i] != NULL  &&  pool->keys[i] != key)
+        i = (i + 1) & (pool->size - 1);
+    return i;
+}
+
+/* Double the number of buckets of 'pool'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zpoolgrow(ZPool *pool)
+{
+    ZPool bigger;
+    unsigned int i, j;
+
+    bigger.size = pool->size > 0 ? 2 * pool->size : 64;
+    bigger.count = pool->count;
+    bigger.keys = (char **) zcalloc(bigger.size, sizeof(char *));
+    bigger.values = (Zob **) zmalloc(bigger.size * sizeof(Zob *));
+    if (bigger.keys == NULL  ||  bigger.values == NULL) {
+        zmfree(bigger.keys);
+        zmfree(bigger.values);
+        return ZE_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < pool->size; i++) {
+        if (pool->keys[i] != NULL) {
+            j = zpoolindex(&bigger, pool->keys[i]);
+            bigger.keys[j] = pool->keys[i];
+            bigger.values[j] = pool->values[i];
+        }
+    }
+    zmfree(pool->keys);
+    zmfree(pool->values);
+    *pool = bigger;
+    return ZE_OK;
+}
+
+/* Save in 'zob' the constant for the literal pointed by 'entry',
+ *  materializing it in the pool of 'zcontext' on first use.
+ * The constant is immortal and owned by 'zcontext'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zconstant(ZContext *zcontext, char **entry, Zob **zob)
+{
+    ZPool *pool = &zcontext->pool;
+    char *key = *entry;
+    unsigned int i;
+    ZError err;
+
+    if (pool->size > 0) {
+        i = zpoolindex(pool, key);
+        if (pool->keys[i] != NULL) {
+            *zob = pool->values[i];
+            zskip_expr(entry);
+            return ZE_OK;
+        }
+    }
+    if (2 * (pool->count + 1) > pool->size) {
+        err = zpoolgrow(pool);
+        if (err != ZE_OK)
+            return err;
+    }
+    err = zliteral(entry, zob);
+    if (err != ZE_OK)
+        return err;
+    err = zkeep(zcontext, *zob);
+    if (err != ZE_OK) {
+        zdelobj(zob);
+        return err;
+    }
+    i = zpoolindex(pool, key);
+    pool->keys[i] = key;
+    pool->values[i] = *zob;
+    pool->count++;
+    return ZE_OK;
+}
+
+/* Return how many bytes of the C stack zap calls may use:
+ *  three quarters of its limit, the rest being left to the runtime
+ *  and the builtins called by the deepest one.
+ */
+static size_t
+zcstacksize()
+{
+#if defined(__unix__)  ||  defined(__APPLE__)
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_STACK, &limit) == 0  &&
+        limit.rlim_cur != RLIM_INFINITY)
+        return (size_t) limit.rlim_cur / 4 * 3;
+#endif
+    return ZCSTACKSIZE;
+}
 
 /* Create a new ZContext in 'zcontext'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
@@ -54,9 +180,99 @@
 ZError
 znewcontext(ZContext **zcontext)
 {
-    *zcontext = (ZContext *) malloc(sizeof(ZContext));
+    unsigned int i;
+
+    *zcontext = (ZContext *) zmalloc(sizeof(ZContext));
     if (*zcontext == NULL)
         return ZE_OUT_OF_MEMORY;
+    (*zcontext)->frame = NULL;
+    (*zcontext)->depth = 0;
+    (*zcontext)->maxdepth = ZMAXDEPTH;
+    (*zcontext)->cstack = 0;
+    (*zcontext)->cstacksize = zcstacksize();
+    (*zcontext)->callers = NULL;
+    (*zcontext)->callersize = 0;
+    (*zcontext)->ncallers = 0;
+    for (i = 0; i < NFRAMECLASSES; i++) {
+        (*zcontext)->spare[i] = NULL;
+        (*zcontext)->nspare[i] = 0;
+    }
+    (*zcontext)->stack = NULL;
+    (*zcontext)->stacksize = 0;
+    (*zcontext)->stacktop = 0;
+    (*zcontext)->pool.keys = NULL;
+    (*zcontext)->pool.values = NULL;
+    (*zcontext)->pool.size = 0;
+    (*zcontext)->pool.count = 0;
+    (*zcontext)->nopool = 0;
+    (*zcontext)->tailcall = NULL;
+    (*zcontext)->nret = 0;
+    (*zcontext)->bodies = NULL;
+    (*zcontext)->temps = NULL;
+    (*zcontext)->tempsize = 0;
+    (*zcontext)->ntemps = 0;
+    (*zcontext)->immortals = NULL;
+    (*zcontext)->immortalsize = 0;
+    (*zcontext)->nimmortals = 0;
+    (*zcontext)->allocator = zgetallocator();
+    (*zcontext)->outer = NULL;
+    return ZE_OK;
+}
+
+/* Create a new ZContext in 'zcontext', allocating it and everything
+ *  it runs from a new arena.
+ * The arena is the current allocator until the context is removed,
+ *  which frees all of it at once.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewarenacontext(ZContext **zcontext)
+{
+    ZAllocator *arena, *outer;
+    ZError err;
+
+    err = znewarena(&arena);
+    if (err != ZE_OK)
+        return err;
+    outer = zgetallocator();
+    zsetallocator(arena);
+    err = znewcontext(zcontext);
+    if (err != ZE_OK) {
+        zsetallocator(outer);
+        zdelarena(&arena);
+        return err;
+    }
+    (*zcontext)->outer = outer;
+    return ZE_OK;
+}
+
+/* Make 'zob' immortal and owned by 'zcontext', which deletes it when
+ *  it is removed itself.
+ * Immediate objects are not counted, so they are not kept.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zkeep(ZContext *zcontext, Zob *zob)
+{
+    if (ZUNCOUNTED(zob))
+        return ZE_OK;
+    if (zcontext->nimmortals == zcontext->immortalsize) {
+        unsigned int newsize;
+        Zob **immortals;
+
+        newsize = zcontext->immortalsize > 0 ? 2 * zcontext->immortalsize
+                                             : 64;
+        immortals = (Zob **) zrealloc(zcontext->immortals,
+                                      newsize * sizeof(Zob *));
+        if (immortals == NULL)
+            return ZE_OUT_OF_MEMORY;
+        zcontext->immortals = immortals;
+        zcontext->immortalsize = newsize;
+    }
+    ((RefC *) zob)->refc = ZIMMORTAL;
+    zcontext->immortals[zcontext->nimmortals++] = zob;
     return ZE_OK;
 }
 
@@ -64,49 +280,273 @@ znewcontext(ZContext **zcontext)
 void
 zdelcontext(ZContext **zcontext)
 {
+    ZAllocator *za, *outer;
+    unsigned int i;
+
+    za = (*zcontext)->allocator;
+    outer = (*zcontext)->outer;
+    if (outer != NULL) {
+        /* Nothing allocated in the arena may outlive it. */
+        zsetallocator(outer);
+        zdelarena(&za);
+        *zcontext = NULL;
+        return;
+    }
+    outer = zgetallocator();
+    zsetallocator(za);
+    zrelease(*zcontext, 0);
+    zmfree((*zcontext)->temps);
     zdelnable(&(*zcontext)->global);
-    zdellist(&(*zcontext)->local);
-    free(*zcontext);
+    while ((*zcontext)->frame != NULL)
+        zdropframe(*zcontext);
+    for (i = 0; i < NFRAMECLASSES; i++) {
+        while ((*zcontext)->spare[i] != NULL) {
+            ZFrame *frame = (*zcontext)->spare[i];
+
+            (*zcontext)->spare[i] = frame->prev;
+            zfree(frame, sizeof(ZFrame) + frame->size * sizeof(Zob *));
+        }
+    }
+    zmfree((*zcontext)->stack);
+    zmfree((*zcontext)->callers);
+    zdelcode(&(*zcontext)->bodies);
+    zdelpool(&(*zcontext)->pool);
+    /* Cycles left behind by the program. */
+    zdrain(ZDRAINALL);
+    (void) zcollect();
+    zdrain(ZDRAINALL);
+    /* Nothing counts references to immortals, so they go last. */
+    while ((*zcontext)->nimmortals > 0)
+        zdelobj(&(*zcontext)->immortals[--(*zcontext)->nimmortals]);
+    zdrain(ZDRAINALL);
+    zmfree((*zcontext)->immortals);
+    zmfree(*zcontext);
     *zcontext = NULL;
+    zsetallocator(outer);
+}
+
+/* Check that one more zap call can start in 'zcontext'.
+ * If there are 'maxdepth' calls running already, or if they have used
+ *  'cstacksize' bytes of the C stack, return ZE_CALL_TOO_DEEP.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zcheckdepth(ZContext *zcontext)
+{
+    char here;
+    size_t used;
+
+    if (zcontext->depth == 0) {
+        zcontext->cstack = (size_t) &here;
+        return ZE_OK;
+    }
+    if (zcontext->depth >= zcontext->maxdepth)
+        return ZE_CALL_TOO_DEEP;
+    /* The C stack may grow either way. */
+    if ((size_t) &here < zcontext->cstack)
+        used = zcontext->cstack - (size_t) &here;
+    else
+        used = (size_t) &here - zcontext->cstack;
+    if (used >= zcontext->cstacksize)
+        return ZE_CALL_TOO_DEEP;
+    return ZE_OK;
 }
 
-/* Push a new namespace to 'zcontext'.
+/* Push a new frame with 'nslots' unbound slots to 'zcontext'.
+ * A spare frame of the right size is reused if there is one.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-zpushlocal(ZContext *zcontext)
+zpushframe(ZContext *zcontext, unsigned int nslots)
 {
-    ZNameTable *znable;
-    ZError err;
+    unsigned int class = (nslots + FRAMESTEP - 1) / FRAMESTEP;
+    unsigned int size = class * FRAMESTEP;
+    ZFrame *frame = zcontext->spare[class];
+    unsigned int i;
+
+    if (frame != NULL) {
+        zcontext->spare[class] = frame->prev;
+        zcontext->nspare[class]--;
+    }
+    else {
+        /* The slots are allocated along with the frame. */
+        frame = (ZFrame *) zalloc(sizeof(ZFrame) + size * sizeof(Zob *));
+        if (frame == NULL)
+            return ZE_OUT_OF_MEMORY;
+        frame->slots = (Zob **) (frame + 1);
+        frame->size = size;
+        for (i = 0; i < size; i++)
+            frame->slots[i] = NULL;
+    }
+    frame->nslots = nslots;
+    frame->names = NULL;
+    frame->want = 0;
+    frame->ret = NULL;
+    frame->prev = zcontext->frame;
+    zcontext->frame = frame;
+    return ZE_OK;
+}
 
-    err = znewnable(&znable);
-    if (err != ZE_OK)
-        return err;
-    return zlpush(zcontext->local, (Zob *) znable);
+/* Pop the current frame from 'zcontext', clear it and keep it for reuse,
+ *  or remove it from memory if there are enough spare frames already.
+ */
+void
+zdropframe(ZContext *zcontext)
+{
+    ZFrame *frame = zcontext->frame;
+    unsigned int class = frame->size / FRAMESTEP;
+    unsigned int i;
+
+    zcontext->frame = frame->prev;
+    for (i = 0; i < frame->nslots; i++) {
+        if (frame->slots[i] != NULL) {
+            zdecrefc(frame->slots[i]);
+            frame->slots[i] = NULL;
+        }
+    }
+    if (frame->names != NULL)
+        zdecrefc((Zob *) frame->names);
+    if (frame->ret != NULL)
+        zdecrefc(frame->ret);
+    if (zcontext->nspare[class] < FRAMEPOOL) {
+        frame->prev = zcontext->spare[class];
+        zcontext->spare[class] = frame;
+        zcontext->nspare[class]++;
+    }
+    else
+        zfree(frame, sizeof(ZFrame) + frame->size * sizeof(Zob *));
 }
 
-/* Pop a namespace from 'zcontext' and save its "_ret_" value in 'ret'.
+/* Pop the current frame from 'zcontext' and save its return value in 'ret'.
  * If there is not enough memory, return ZE_OUT_OF_MEMORY.
  * Otherwise, return ZE_OK.
  */
 ZError
-zpoplocal(ZContext *zcontext, Zob **ret)
+zpopframe(ZContext *zcontext, Zob **ret)
 {
-    ZNameTable *poped;
-    ZError err;
+    if (zcontext->frame->ret == NULL)
+        *ret = ZNONE;
+    else
+        *ret = zcontext->frame->ret;
+    zdropframe(zcontext);
+    return ZE_OK;
+}
+
+/* Bind 'slot' of 'frame' to 'value'. */
+void
+zsetslot(ZFrame *frame, unsigned int slot, Zob *value)
+{
+    Zob *old = frame->slots[slot];
+
+    zincrefc(value);
+    frame->slots[slot] = value;
+    if (old != NULL)
+        zdecrefc(old);
+}
+
+/* Return the value bound to the first component of 'name', a local name
+ *  past the slots of 'frame', or NULL if it is not bound yet.
+ */
+Zob *
+zgetspilled(ZFrame *frame, char *name)
+{
+    ZAtom *atom;
+    Zob *value;
+    char *dot;
+
+    if (frame->names == NULL)
+        return NULL;
+    dot = strchr(name, '.');
+    atom = zfindatomn(name, dot == NULL ? strlen(name) : dot - name);
+    if (atom == NULL  ||  ztgetatom(frame->names, atom, &value) == 0)
+        return NULL;
+    return value;
+}
 
-    poped = (ZNameTable *) zlpop(zcontext->local);
-    if (ztget(poped, "_ret_", ret) == 0) {
-        ZNone *znone;
+/* Bind 'name', a local name past the slots of 'frame', to 'value'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zsetspilled(ZFrame *frame, char *name, Zob *value)
+{
+    ZError err;
 
-        err = znewnone(&znone);
+    if (frame->names == NULL) {
+        err = znewnable(&frame->names);
         if (err != ZE_OK)
             return err;
-        *ret = (Zob *) znone;
+        zincrefc((Zob *) frame->names);
     }
-    zdelnable(&poped);
-    return ZE_OK;
+    return ztset(frame->names, name, value);
+}
+
+/* Define or redefine the last of the 'length' atoms of 'path',
+ *  found by walking the previous ones from 'head'.
+ * If a name in the way is missing, return ZE_NAME_NOT_DEFINED.
+ * If an object in the way is not a ZNameTable, return ZE_NOT_A_NODE.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zsetpath(Zob *head, ZAtom **path, unsigned int length, Zob *value)
+{
+    for (; length > 1; length--, path++) {
+        if (ZTYPE(head) != T_NMTB)
+            return ZE_NOT_A_NODE;
+        if (ztgetatom((ZNameTable *) head, *path, &head) == 0)
+            return ZE_NAME_NOT_DEFINED;
+    }
+    if (ZTYPE(head) != T_NMTB)
+        return ZE_NOT_A_NODE;
+    return ztsetatom((ZNameTable *) head, *path, value);
+}
+
+/* If the 'length' atoms of 'path' can be walked from 'head',
+ *  copy the value found to 'value', set 'self' as the last node
+ *  (ZNameTable) visited and return nonzero.
+ * Otherwise, return zero.
+ */
+int
+zgetpath(Zob *head,
+         ZAtom **path,
+         unsigned int length,
+         ZNameTable **self,
+         Zob **pvalue)
+{
+    for (; length > 0; length--, path++) {
+        if (ZTYPE(head) != T_NMTB)
+            return 0;
+        *self = (ZNameTable *) head;
+        if (ztgetatom(*self, *path, &head) == 0)
+            return 0;
+    }
+    *pvalue = head;
+    return 1;
+}
+
+/* Define or redefine 'path' in 'nable'.
+ * 'path' is a name, possibly preceded by dotted node names.
+ */
+static ZError
+zsetinnode(ZNameTable *nable, char *path, Zob *value)
+{
+    ZAtom *atom;
+    Zob *node;
+    char *dot;
+
+    /* Names of nodes in the way must already exist. */
+    while ((dot = strchr(path, '.')) != NULL) {
+        atom = zfindatomn(path, dot - path);
+        if (atom == NULL || ztgetatom(nable, atom, &node) == 0)
+            return ZE_NAME_NOT_DEFINED;
+        if (ZTYPE(node) != T_NMTB)
+            return ZE_NOT_A_NODE;
+        nable = (ZNameTable *) node;
+        path = dot + 1;
+    }
+    return ztset(nable, path, value);
 }
 
 /* Define or redefine 'name' in 'zcontext'.
@@ -118,39 +558,53 @@ zpoplocal(ZContext *zcontext, Zob **ret)
 ZError
 zsetincontext(ZContext *zcontext, char *name, Zob *value)
 {
-    ZNameTable *nable, **pnable;
-    char *oldtoken, *newtoken;
-    char *lastname = NULL;
-    int nulls = 0;
-
-    if (zcontext->local->length > 0)
-        nable = (ZNameTable *) zlpeek(zcontext->local);
-    else
-        nable = zcontext->global;
-    pnable = &nable;
-    if (strchr(name, '.') != NULL) {
-        oldtoken = strtok(name, ".");
-        while (lastname == NULL) {
-            if ((newtoken = strtok(NULL, ".")) == NULL)
-                lastname = oldtoken;
-            else {
-                if (ztget(nable, oldtoken, (Zob **) pnable) == 0)
-                    return ZE_NAME_NOT_DEFINED;
-                if (nable->type != T_NMTB)
-                    return ZE_NOT_A_NODE;
-                nulls++;
-                oldtoken = newtoken;
-            }
+    if (*name == LOCAL) {
+        Zob *head = LOCALHEAD(zcontext->frame, name);
+        char *dot;
+
+        name += 2;
+        dot = strchr(name, '.');
+        if (dot == NULL  &&  SLOT(name - 2) == SPILL)
+            return zsetspilled(zcontext->frame, name, value);
+        if (dot == NULL) {
+            zsetslot(zcontext->frame, SLOT(name - 2), value);
+            return ZE_OK;
         }
-        /* Replace null characters -- placed by strtok() calls -- 
-         *  by the original dots.
-         */
-        for (; nulls > 0; nulls--)
-            name[strlen(name)] = '.';
+        if (head == NULL)
+            return ZE_NAME_NOT_DEFINED;
+        if (ZTYPE(head) != T_NMTB)
+            return ZE_NOT_A_NODE;
+        return zsetinnode((ZNameTable *) head, dot + 1, value);
     }
-    else
-        lastname = name;
-    return ztset(nable, lastname, value);
+    return zsetinnode(zcontext->global, name, value);
+}
+
+/* If 'path' is in 'nable', copy its value to 'value' and return nonzero.
+ * Otherwise, return zero.
+ * In both cases, set 'self' as the last node (ZNameTable) visited.
+ */
+static int
+zgetinnode(ZNameTable *nable,
+           char *path,
+           ZNameTable **self,
+           Zob **pvalue)
+{
+    ZAtom *atom;
+    Zob *node;
+    char *dot;
+
+    *self = nable;
+    while ((dot = strchr(path, '.')) != NULL) {
+        atom = zfindatomn(path, dot - path);
+        if (atom == NULL || ztgetatom(nable, atom, &node) == 0)
+            return 0;
+        if (ZTYPE(node) != T_NMTB)
+            return 0;
+        nable = (ZNameTable *) node;
+        *self = nable;
+        path = dot + 1;
+    }
+    return ztget(nable, path, pvalue);
 }
 
 /* If 'name' is in 'zcontext':
@@ -160,6 +614,7 @@ zsetincontext(ZContext *zcontext, char *name, Zob *value)
  * Otherwise:
  *  * set 'self' as the last node (ZNameTable) visited;
  *  * return zero.
+ * A local name that is not bound yet is searched in globals.
  */
 int
 zgetincontext(ZContext *zcontext,
@@ -167,62 +622,24 @@ zgetincontext(ZContext *zcontext,
               ZNameTable **self,
               Zob **pvalue)
 {
-    Zob *value = *pvalue;
-    ZNameTable *nable, **pnable, *local = NULL;
-    char *oldtoken, *newtoken;
-    char *lastname = NULL;
-    int nulls = 0;
-    int ok = 0;
-    int head = 1;
-
-    if (zcontext->local->length > 0)
-        local = (ZNameTable *) zlpeek(zcontext->local);
-    else
-        head = 0;
-    nable = zcontext->global;
-    pnable = &nable;
-    oldtoken = strtok(name, ".");
-    while (lastname == NULL) {
-        if ((newtoken = strtok(NULL, ".")) == NULL)
-            lastname = oldtoken;
-        else {
-            if (head) {
-                /* The first name should be searched in locals and globals. */
-                if (ztget(local, oldtoken, (Zob **) pnable) == 0)
-                    if (ztget(nable, oldtoken, (Zob **) pnable) == 0)
-                        return 0;
-                head = 0;
-            }
-            else {
-                if (ztget(nable, oldtoken, (Zob **) pnable) == 0)
-                    return 0;
+    if (*name == LOCAL) {
+        Zob *head = LOCALHEAD(zcontext->frame, name);
+        char *dot;
+
+        name += 2;
+        if (head != NULL) {
+            dot = strchr(name, '.');
+            if (dot == NULL) {
+                *self = zcontext->global;
+                *pvalue = head;
+                return 1;
             }
-            if (nable->type != T_NMTB)
-                return 0;
-            nulls++;
-            oldtoken = newtoken;
-        }
-    }
-    *self = nable;
-    if (head) {
-        /* The first name should be searched in locals and globals. */
-        if (ztget(local, lastname, (Zob **) &value) == 0) {
-            if (ztget(nable, lastname, (Zob **) &value) == 0)
+            if (ZTYPE(head) != T_NMTB)
                 return 0;
+            return zgetinnode((ZNameTable *) head, dot + 1, self, pvalue);
         }
-        else
-            *self = local;
-        ok = 1;
     }
-    else
-        ok = ztget(nable, lastname, &value);
-    *pvalue = value;
-    /* Replace null characters -- placed by strtok() calls -- 
-     *  by the original dots.
-     */
-    for (; nulls > 0; nulls--)
-        name[strlen(name)] = '.';
-    return ok;
+    return zgetinnode(zcontext->global, name, self, pvalue);
 }
 
 /* If 'name' is in 'zcontext',
@@ -232,12 +649,21 @@ zgetincontext(ZContext *zcontext,
 int
 zremincontext(ZContext *zcontext, char *name)
 {
-    if (zcontext->local->length > 0) {
-        ZNameTable *local;
+    if (*name == LOCAL  &&  SLOT(name) == SPILL) {
+        if (zcontext->frame->names != NULL  &&
+            ztremove(zcontext->frame->names, name + 2))
+            return 1;
+        name += 2;
+    }
+    else if (*name == LOCAL) {
+        Zob **slot = &zcontext->frame->slots[SLOT(name)];
 
-        local = (ZNameTable *) zlpeek(zcontext->local);
-        if (ztremove(local, name) != 0)
+        if (*slot != NULL) {
+            zdecrefc(*slot);
+            *slot = NULL;
             return 1;
+        }
+        name += 2;
     }
     return ztremove(zcontext->global, name);
 }
@@ -248,16 +674,12 @@ zremincontext(ZContext *zcontext, char *name)
 int
 zhasincontext(ZContext *zcontext, char *name)
 {
-    if (zcontext->local->length > 0) {
-        ZNameTable *local;
-
-        local = (ZNameTable *) zlpeek(zcontext->local);
-        if (zthasname(local, name))
+    if (*name == LOCAL) {
+        if (LOCALHEAD(zcontext->frame, name) != NULL)
             return 1;
+        name += 2;
     }
-    if (zthasname(zcontext->global, name))
-        return 1;
-    return 0;
+    return zthasname(zcontext->global, name);
 }
 
 unsigned int
@@ -310,6 +732,59 @@ zskip_svlv(char **entry)
     *entry = cursor;
 }
 
+/* Materialize the Int, ByteArray or BigNum literal pointed by 'entry'
+ *  in 'zob', as an object that must not be changed in place.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zliteral(char **entry, Zob **zob)
+{
+    char *cursor = *entry;
+    ZError err = ZE_OK;
+
+    switch (*cursor) {
+        case T_INT:
+            cursor++;
+            err = zmkint(zob, zread_svlv(&cursor));
+            break;
+        case T_YARR:
+            {
+                ZByteArray *zbytearray;
+                unsigned int length;
+
+                cursor++;
+                length = zreadword(&cursor);
+                err = znewyarr(&zbytearray, length);
+                if (err != ZE_OK)
+                    return err;
+                memcpy(zbytearray->bytes, cursor, length);
+                cursor += length;
+                *zob = (Zob *) zbytearray;
+            }
+            break;
+        case T_BNUM:
+            {
+                ZBigNum *zbignum;
+                unsigned int wordlen, index;
+
+                cursor++;
+                wordlen = zreadword(&cursor);
+                err = znewbnum(&zbignum, (unsigned int) (wordlen * WL));
+                if (err != ZE_OK)
+                    return err;
+                for (index = 0; index < wordlen; index++)
+                    zbignum->words[index] = zreadword(&cursor);
+                *zob = (Zob *) zbignum;
+            }
+            break;
+        default:
+            return ZE_UNKNOWN_TYPE_NUMBER;
+    }
+    *entry = cursor;
+    return err;
+}
+
 void
 zskip_expr(char **entry)
 {
@@ -382,7 +857,7 @@ zskip_expr(char **entry)
  * Otherwise, return ZE_OK.
  */
 ZError
-zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
+zeval(ZContext *zcontext, char **entry, Zob **pzob)
 {
     char *cursor = *entry;
     Zob *zob = *pzob;
@@ -390,87 +865,48 @@ zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
 
     switch (*cursor) {
         case T_NONE:
-            {
-                ZNone *znone;
-
-                err = znewnone(&znone);
-                if (err != ZE_OK)
-                    return err;
-                cursor++;
-                zob = (Zob *) znone;
-            }
+            cursor++;
+            zob = ZNONE;
             break;
         case T_BOOL:
-            {
-                ZBool *zbool;
-
-                err = znewbool(&zbool);
-                if (err != ZE_OK)
-                    return err;
-                cursor++;
-                zbool->value = (int) *cursor;
-                cursor++;
-                zob = (Zob *) zbool;
-            }
+            cursor++;
+            zob = ZBOOL(*cursor);
+            cursor++;
             break;
         case T_BYTE:
-            {
-                ZByte *zbyte;
-
-                err = znewbyte(&zbyte);
-                if (err != ZE_OK)
-                    return err;
-                cursor++;
-                zbyte->value = (unsigned char) *cursor;
-                cursor++;
-                zob = (Zob *) zbyte;
-            }
+            cursor++;
+            zob = ZBYTE(*cursor);
+            cursor++;
             break;
         case T_INT:
-            {
-                ZInt *zint;
-
-                err = znewint(&zint);
+            cursor++;
+            err = zmkint(&zob, zread_svlv(&cursor));
+            if (err != ZE_OK)
+                return err;
+            break;
+        case T_YARR:
+        case T_BNUM:
+            if (zcontext->nopool) {
+                /* The bytecode is not kept: build a new literal. */
+                err = zliteral(&cursor, &zob);
                 if (err != ZE_OK)
                     return err;
-                cursor++;
-                zint->value = zread_svlv(&cursor);
-                zob = (Zob *) zint;
+                break;
             }
-            break;
-        case T_YARR:
-            {
+            err = zconstant(zcontext, &cursor, &zob);
+            if (err != ZE_OK)
+                return err;
+            if (ZTYPE(zob) == T_YARR) {
                 ZByteArray *zbytearray;
-                unsigned int length, index;
 
-                cursor++;
-                length = zreadword(&cursor);
-                err = znewyarr(&zbytearray, length);
+                /* Each evaluation is a new array, sharing the bytes. */
+                err = zshareyarr((ZByteArray *) zob, &zbytearray);
                 if (err != ZE_OK)
                     return err;
-                for (index = 0; index < length; index++) {
-                    zbytearray->bytes[index] = (unsigned char) *cursor;
-                    cursor++;
-                }
                 zob = (Zob *) zbytearray;
             }
             break;
-        case T_BNUM:
-            {
-                ZBigNum *zbignum;
-                unsigned int wordlen, index;
-
-                cursor++;
-                wordlen = zreadword(&cursor);
-                err = znewbnum(&zbignum, (unsigned int) (wordlen * WL));
-                if (err != ZE_OK)
-                    return err;
-                for (index = 0; index < wordlen; index++)
-                    zbignum->words[index] = zreadword(&cursor);
-                zob = (Zob *) zbignum;
-            }
-            break;
-        case T_LIST:
+        case T_LIST:
             {
                 ZList *zlist;
 
@@ -481,7 +917,7 @@ zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
                 while (*cursor != '\0') {
                     Zob *item;
 
-                    err = zeval(zcontext, tmp, &cursor, &item);
+                    err = zeval(zcontext, &cursor, &item);
                     if (err != ZE_OK)
                         return err;
                     err = zlappend(zlist, item);
@@ -504,10 +940,10 @@ zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
                     return err;
                 cursor++;
                 while (*cursor != '\0') {
-                    err = zeval(zcontext, tmp, &cursor, &key);
+                    err = zeval(zcontext, &cursor, &key);
                     if (err != ZE_OK)
                         return err;
-                    err = zeval(zcontext, tmp, &cursor, &value);
+                    err = zeval(zcontext, &cursor, &value);
                     if (err != ZE_OK)
                         return err;
                     err = zdset(zdict, key, value);
@@ -521,7 +957,7 @@ zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
         case CALLSTART:
             /* Function Call. */
             cursor++;
-            err = zfeval(zcontext, tmp, &cursor, &zob);
+            err = zfeval(zcontext, &cursor, &zob);
             if (err != ZE_OK)
                 return err;
             cursor++; /* Skip CALL_END. */
@@ -534,7 +970,7 @@ zeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pzob)
     }
     *entry = cursor;
     *pzob = zob;
-    return zlappend(tmp, *pzob);
+    return ztemp(zcontext, *pzob);
 }
 
 ZError
@@ -552,14 +988,209 @@ znameval(ZContext *zcontext, char **entry, Zob **pzob)
     return ZE_OK;
 }
 
+/* Make room for 'size' values in the operand stack of 'zcontext'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zreserve(ZContext *zcontext, unsigned int size)
+{
+    Zob **stack;
+    unsigned int newsize;
+
+    if (size <= zcontext->stacksize)
+        return ZE_OK;
+    newsize = zcontext->stacksize > 0 ? zcontext->stacksize : 64;
+    while (newsize < size)
+        newsize *= 2;
+    stack = (Zob **) zrealloc(zcontext->stack, newsize * sizeof(Zob *));
+    if (stack == NULL)
+        return ZE_OUT_OF_MEMORY;
+    zcontext->stack = stack;
+    zcontext->stacksize = newsize;
+    return ZE_OK;
+}
+
+/* Pop the operand stack of 'zcontext' down to 'base'. */
+static void
+zunwind(ZContext *zcontext, unsigned int base)
+{
+    while (zcontext->stacktop > base)
+        zdecrefc(zcontext->stack[--zcontext->stacktop]);
+}
+
+/* Reference 'zob' as a temporary of 'zcontext', keeping it alive until
+ *  the temporaries are released down to a mark below it.
+ * Immediate and immortal objects are not counted, so they are not kept.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+ztemp(ZContext *zcontext, Zob *zob)
+{
+    if (ZUNCOUNTED(zob))
+        return ZE_OK;
+    if (zcontext->ntemps == zcontext->tempsize) {
+        unsigned int newsize;
+        Zob **temps;
+
+        newsize = zcontext->tempsize > 0 ? 2 * zcontext->tempsize : 64;
+        temps = (Zob **) zrealloc(zcontext->temps, newsize * sizeof(Zob *));
+        if (temps == NULL)
+            return ZE_OUT_OF_MEMORY;
+        zcontext->temps = temps;
+        zcontext->tempsize = newsize;
+    }
+    zincrefc(zob);
+    zcontext->temps[zcontext->ntemps++] = zob;
+    return ZE_OK;
+}
+
+/* Release the temporaries of 'zcontext' above 'mark',
+ *  a previous value of 'zcontext->ntemps'.
+ */
+void
+zrelease(ZContext *zcontext, unsigned int mark)
+{
+    while (zcontext->ntemps > mark)
+        zdecrefc(zcontext->temps[--zcontext->ntemps]);
+}
+
+/* Push the arguments of the call pointed by 'entry' to the operand
+ *  stack of 'zcontext', up to CALL_END.
+ * They are referenced there, since the temporaries of a nested call
+ *  may be released before this one is done.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by an argument or ZE_OK.
+ */
+static ZError
+zpushargs(ZContext *zcontext, char **entry)
+{
+    char *cursor = *entry;
+    unsigned int base = zcontext->stacktop;
+    ZError err;
+
+    while (*cursor != CALLEND) {
+        Zob *arg;
+
+        err = zeval(zcontext, &cursor, &arg);
+        if (err == ZE_OK)
+            err = zreserve(zcontext, zcontext->stacktop + 1);
+        if (err != ZE_OK) {
+            zunwind(zcontext, base);
+            return err;
+        }
+        zincrefc(arg);
+        zcontext->stack[zcontext->stacktop++] = arg;
+    }
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Bind the 'argc' arguments in 'argv' to the current frame of 'zcontext',
+ *  for a call to 'zhighfunc' found in 'self'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
 ZError
-zfeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pret)
+zbindargs(ZContext *zcontext,
+          ZHighFunc *zhighfunc,
+          ZNameTable *self,
+          Zob **argv,
+          int argc)
+{
+    int slot;
+    ZError err;
+
+    /* Parameters take the first slots: a header line is too short to
+     *  name more parameters than there are slots.
+     */
+    for (slot = 0; slot < argc; slot++)
+        zsetslot(zcontext->frame, slot, argv[slot]);
+    if (self == zcontext->global  ||  zhighfunc->self < 0)
+        return ZE_OK;
+    /* Set the instance reference. */
+    if (zhighfunc->self == SPILL) {
+        err = zsetspilled(zcontext->frame, "@", (Zob *) self);
+        if (err != ZE_OK)
+            return err;
+    }
+    else
+        zsetslot(zcontext->frame, zhighfunc->self, (Zob *) self);
+    return ZE_OK;
+}
+
+/* Turn the current frame of 'zcontext' into a frame for the zap function
+ *  'zfunc' found in 'self', bound to the 'argc' arguments on top of the
+ *  operand stack, which are popped.
+ * This is how a tail call reuses the frame of its caller.
+ * The caller must hold a reference to 'zfunc'.
+ * If 'argc' is not the arity of 'zfunc', return ZE_ARITY_ERROR.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zreframe(ZContext *zcontext, ZFunc *zfunc, ZNameTable *self, int argc)
+{
+    ZHighFunc *zhighfunc = (ZHighFunc *) zfunc->fimp;
+    ZFrame *frame = zcontext->frame;
+    unsigned int i, base;
+    ZError err = ZE_OK;
+
+    base = zcontext->stacktop - (unsigned int) argc;
+    if (argc != (int) zfunc->arity) {
+        zunwind(zcontext, base);
+        return ZE_ARITY_ERROR;
+    }
+    /* "@" may be bound only in the frame being dropped.
+     * The global table is not counted: it belongs to 'zcontext'.
+     */
+    if (self != zcontext->global)
+        zincrefc((Zob *) self);
+    if (frame->size >= zhighfunc->nslots) {
+        for (i = 0; i < frame->nslots; i++) {
+            if (frame->slots[i] != NULL) {
+                zdecrefc(frame->slots[i]);
+                frame->slots[i] = NULL;
+            }
+        }
+        frame->nslots = zhighfunc->nslots;
+        if (frame->names != NULL) {
+            zdecrefc((Zob *) frame->names);
+            frame->names = NULL;
+        }
+    }
+    else {
+        /* Replace the frame, keeping the current one on failure. */
+        err = zpushframe(zcontext, zhighfunc->nslots);
+        if (err == ZE_OK) {
+            ZFrame *top = zcontext->frame;
+
+            zcontext->frame = frame;
+            zdropframe(zcontext);
+            top->prev = zcontext->frame;
+            zcontext->frame = top;
+        }
+    }
+    if (err == ZE_OK)
+        err = zbindargs(zcontext, zhighfunc, self, zcontext->stack + base,
+                        argc);
+    if (self != zcontext->global)
+        zdecrefc((Zob *) self);
+    zunwind(zcontext, base);
+    return err;
+}
+
+ZError
+zfeval(ZContext *zcontext, char **entry, Zob **pret)
 {
     Zob *zfunc;
-    ZList *args;
+    Zob **argv;
     char *cursor = *entry;
     Zob *ret = *pret;
     ZNameTable *self;
+    unsigned int base;
+    int argc;
     ZError err;
 
     /* Get zfunc. */
@@ -568,85 +1199,145 @@ zfeval(ZContext *zcontext, ZList *tmp, char **entry, Zob **pret)
     }
     cursor += strlen(cursor) + 1; /* Skip STRING_END. */
 
-    /* Get arg list. */
-    err = znewlist(&args);
+    base = zcontext->stacktop;
+    err = zpushargs(zcontext, &cursor);
     if (err != ZE_OK)
         return err;
-    while (*cursor != CALLEND) {
-        Zob *arg;
-
-        err = zeval(zcontext, tmp, &cursor, &arg);
-        if (err != ZE_OK) {
-            zdellist(&args);
-            return err;
-        }
-        err = zlappend(args, arg);
-        if (err != ZE_OK) {
-            zdellist(&args);
-            return err;
-        }
-    }
     *entry = cursor;
-    if (args->length != ((ZFunc *) zfunc)->arity) {
-        zdellist(&args);
+    argc = (int) (zcontext->stacktop - base);
+    argv = zcontext->stack + base;
+    if (argc != ((ZFunc *) zfunc)->arity) {
+        zunwind(zcontext, base);
         return ZE_ARITY_ERROR;
     }
-    if (*(((ZFunc *) zfunc)->fimp)) {
+    if (*(((ZFunc *) zfunc)->fimp)  &&
+        ((ZHighFunc *) ((ZFunc *) zfunc)->fimp)->generator) {
+        /* The body waits for the generator to be resumed. */
+        err = znewgen(zcontext,
+                      (ZHighFunc *) ((ZFunc *) zfunc)->fimp,
+                      self,
+                      argv,
+                      argc,
+                      (ZGen **) &ret);
+        zunwind(zcontext, base);
+        if (err != ZE_OK)
+            return err;
+    }
+    else if (*(((ZFunc *) zfunc)->fimp)) {
+        ZHighFunc *zhighfunc = (ZHighFunc *) ((ZFunc *) zfunc)->fimp;
+        Zob *callee = NULL;
         char *zapfunc;
-        ZNode *item;
+        unsigned int mark;
         unsigned char be;
 
         /* Call zap function. */
-        err = zpushlocal(zcontext);
+        err = zcheckdepth(zcontext);
         if (err != ZE_OK) {
-            zdellist(&args);
+            zunwind(zcontext, base);
             return err;
         }
-        if (self != zcontext->global) {
-            /* Set the instance reference. */
-            err = zsetincontext(zcontext, "@", (Zob *) self);
-            if (err != ZE_OK) {
-                zdellist(&args);
-                return err;
-            }
-        }
-        zapfunc = ((ZHighFunc *) ((ZFunc *) zfunc)->fimp)->func;
-        item = args->first;
-        while (*zapfunc != '\0') {
-            err = zsetincontext(zcontext, zapfunc, item->object);
-            if (err != ZE_OK) {
-                zdellist(&args);
-                return err;
-            }
-            zapfunc += strlen(zapfunc) + 1;
-            item = item->next;
-        }
-        zapfunc++;
-        be = 0;
-        err = zrun_block(zcontext, tmp, 0, &zapfunc, &be);
+        err = zpushframe(zcontext, zhighfunc->nslots);
         if (err != ZE_OK) {
-            zdellist(&args);
+            zunwind(zcontext, base);
             return err;
         }
-        err = zpoplocal(zcontext, &ret);
+        err = zbindargs(zcontext, zhighfunc, self, argv, argc);
+        zunwind(zcontext, base);
         if (err != ZE_OK) {
-            zdellist(&args);
+            zdropframe(zcontext);
             return err;
         }
+        zcontext->depth++;
+        mark = zcontext->ntemps;
+        for (;;) {
+            zapfunc = zhighfunc->func;
+            be = 0;
+            err = zrun_block(zcontext, 0, &zapfunc, &be);
+            if (err != ZE_OK  ||  zcontext->tailcall == NULL)
+                break;
+            /* A tail call has rebound this frame: run its callee here.
+             * Its arguments are bound, so the temporaries of the
+             *  previous callee can go.
+             */
+            zrelease(zcontext, mark);
+            if (callee != NULL)
+                zdecrefc(callee);
+            callee = zcontext->tailcall;
+            zcontext->tailcall = NULL;
+            zhighfunc = (ZHighFunc *) ((ZFunc *) callee)->fimp;
+        }
+        zcontext->depth--;
+        if (err == ZE_OK)
+            err = zpopframe(zcontext, &ret);
+        else
+            zdropframe(zcontext);
+        if (callee != NULL)
+            zdecrefc(callee);
+        if (err != ZE_OK)
+            return err;
     }
     else {
         /* Call C function. */
-        err = ((ZLowFunc *) ((ZFunc *) zfunc)->fimp)->func(args, &ret);
-        if (err != ZE_OK) {
-            zdellist(&args);
+        err = zcall_low((ZLowFunc *) ((ZFunc *) zfunc)->fimp,
+                        argv,
+                        argc,
+                        &ret);
+        zunwind(zcontext, base);
+        if (err != ZE_OK)
             return err;
-        }
     }
-    zdellist(&args);
     *pret = ret;
     return ZE_OK;
 }
 
+/* If the return expression pointed by 'entry' is a call to a zap
+ *  function, rebind the current frame of 'zcontext' for it and leave
+ *  the call pending in 'zcontext', so that it does not nest.
+ * Set 'pending' to nonzero if so, leaving 'entry' after the call.
+ * Otherwise, set 'pending' to zero and leave 'entry' untouched.
+ * Return the error raised by the arguments or by zreframe(), or ZE_OK.
+ */
+static ZError
+ztailcall(ZContext *zcontext, char **entry, int *pending)
+{
+    char *cursor = *entry;
+    ZNameTable *self;
+    Zob *zfunc;
+    unsigned int base;
+    ZError err;
+
+    *pending = 0;
+    if (*cursor != CALLSTART  ||  zcontext->frame == NULL)
+        return ZE_OK;
+    cursor++;
+    if (zgetincontext(zcontext, cursor, &self, &zfunc) == 0  ||
+        !*((ZFunc *) zfunc)->fimp  ||
+        ((ZHighFunc *) ((ZFunc *) zfunc)->fimp)->generator)
+        /* Let zeval() report the error, call the C function
+         *  or make the generator.
+         */
+        return ZE_OK;
+    cursor += strlen(cursor) + 1; /* Skip STRING_END. */
+    base = zcontext->stacktop;
+    err = zpushargs(zcontext, &cursor);
+    if (err != ZE_OK)
+        return err;
+    cursor++; /* Skip CALL_END. */
+    zincrefc(zfunc);
+    err = zreframe(zcontext,
+                   (ZFunc *) zfunc,
+                   self,
+                   (int) (zcontext->stacktop - base));
+    if (err != ZE_OK) {
+        zdecrefc(zfunc);
+        return err;
+    }
+    zcontext->tailcall = zfunc;
+    *pending = 1;
+    *entry = cursor;
+    return ZE_OK;
+}
+
 void
 zskip_assign(char **entry)
 {
@@ -678,15 +1369,13 @@ zassign(ZContext *zcontext, Zob *value, char **entry)
 {
     char *cursor = *entry;
     ZError err;
-    ZNode *deepnode;
 
     while (*cursor != '\0') {
         if (*cursor == ASGNOPEN) {
             cursor++;
-            if (*value != T_LIST)
+            if (ZTYPE(value) != T_LIST)
                 return ZE_ASSIGN_ERROR;
-            deepnode = ((ZList *) value)->first;
-            err = zdeepassign(zcontext, deepnode, &cursor);
+            err = zdeepassign(zcontext, (ZList *) value, &cursor);
             if (err != ZE_OK)
                 return err;
         }
@@ -703,124 +1392,684 @@ zassign(ZContext *zcontext, Zob *value, char **entry)
 }
 
 ZError
-zdeepassign(ZContext *zcontext, ZNode *node, char **entry)
+zdeepassign(ZContext *zcontext, ZList *zlist, char **entry)
 {
     char *cursor = *entry;
     ZError err;
-    ZNode *deepnode;
+    unsigned int i = 0;
 
+    /* Its items are bound to names. */
+    err = zlown(zlist);
+    if (err != ZE_OK)
+        return err;
     while (*cursor != ASGNCLOSE) {
-        if (node == NULL)
+        if (i == zlist->length)
             return ZE_ASSIGN_ERROR;
         if (*cursor == ASGNOPEN) {
             cursor++;
-            if (*node->object != T_LIST)
+            if (ZTYPE(ZLITEM(zlist, i)) != T_LIST)
                 return ZE_ASSIGN_ERROR;
-            deepnode = ((ZList *) node->object)->first;
-            err = zdeepassign(zcontext, deepnode, &cursor);
+            err = zdeepassign(zcontext, (ZList *) ZLITEM(zlist, i), &cursor);
             if (err != ZE_OK)
                 return err;
         }
         else {
-            err = zsetincontext(zcontext, cursor, node->object);
+            err = zsetincontext(zcontext, cursor, ZLITEM(zlist, i));
             if (err != ZE_OK)
                 return err;
             cursor += strlen(cursor) + 1; /* Skip NAME_END. */
         }
-        node = node->next;
+        i++;
     }
-    if (node != NULL)
+    if (i != zlist->length)
         return ZE_ASSIGN_ERROR;
     cursor++;
     *entry = cursor;
     return ZE_OK;
 }
 
+/* Match the list pattern pointed by 'target' with the list literal
+ *  pointed by 'expr', moving both past their ends.
+ * Return the number of names in the pattern, or -1 if the literal
+ *  does not have the shape of the pattern.
+ */
+static int
+zmatchpattern(char **expr, char **target)
+{
+    char *cursor = *expr + 1, *name = *target + 1;
+    int count = 0, inner;
+
+    while (*name != ASGNCLOSE) {
+        if (*cursor == '\0')
+            return -1;
+        if (*name == ASGNOPEN) {
+            if (*cursor != T_LIST)
+                return -1;
+            inner = zmatchpattern(&cursor, &name);
+            if (inner < 0)
+                return -1;
+            count += inner;
+        }
+        else {
+            zskip_expr(&cursor);
+            name += strlen(name) + 1; /* Skip NAME_END. */
+            count++;
+        }
+    }
+    if (*cursor != '\0')
+        return -1;
+    *expr = cursor + 1; /* Skip LIST_END. */
+    *target = name + 1;
+    return count;
+}
+
+/* If the assignment pointed by 'target' is a single list pattern and
+ *  the expression pointed by 'expr' a list literal of the same shape,
+ *  return the number of names in the pattern: their values can be
+ *  bound without building the list.
+ * Otherwise, return -1.
+ */
+int
+zunpackable(char *expr, char *target)
+{
+    int count;
+
+    if (*expr != T_LIST  ||  *target != ASGNOPEN)
+        return -1;
+    count = zmatchpattern(&expr, &target);
+    if (*target != '\0')
+        return -1;
+    return count;
+}
+
+/* Bind the names of the assignment pointed by 'target', in order,
+ *  to 'values', ignoring the structure of list patterns.
+ * If a name cannot be set, return its error.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zbindpattern(ZContext *zcontext, char *target, Zob **values)
+{
+    ZError err;
+
+    while (*target != '\0') {
+        if (*target == ASGNOPEN  ||  *target == ASGNCLOSE) {
+            target++;
+            continue;
+        }
+        err = zsetincontext(zcontext, target, *values++);
+        if (err != ZE_OK)
+            return err;
+        target += strlen(target) + 1; /* Skip NAME_END. */
+    }
+    return ZE_OK;
+}
+
+/* Push the items of the list literal pointed by 'entry' to the operand
+ *  stack, along the list pattern pointed by 'target', which matches it.
+ * Items matched by inner patterns are pushed in turn.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by an item or ZE_OK.
+ */
+static ZError
+zpushpattern(ZContext *zcontext, char **entry, char **target)
+{
+    char *cursor = *entry + 1, *name = *target + 1;
+    Zob *item;
+    ZError err;
+
+    while (*name != ASGNCLOSE) {
+        if (*name == ASGNOPEN) {
+            err = zpushpattern(zcontext, &cursor, &name);
+            if (err != ZE_OK)
+                return err;
+            continue;
+        }
+        err = zeval(zcontext, &cursor, &item);
+        if (err == ZE_OK)
+            err = zreserve(zcontext, zcontext->stacktop + 1);
+        if (err != ZE_OK)
+            return err;
+        zincrefc(item);
+        zcontext->stack[zcontext->stacktop++] = item;
+        name += strlen(name) + 1; /* Skip NAME_END. */
+    }
+    *entry = cursor + 1; /* Skip LIST_END. */
+    *target = name + 1;
+    return ZE_OK;
+}
+
 ZError
-zrunstatement(ZContext *zcontext, ZList *tmp, char **entry)
+zrunstatement(ZContext *zcontext, char **entry)
 {
     Zob *value;
     ZError err;
 
-    err = zeval(zcontext, tmp, &(*entry), &value);
+    if (**entry == T_LIST) {
+        char *cursor = *entry, *target = *entry;
+
+        zskip_expr(&target);
+        if (zunpackable(cursor, target) >= 0) {
+            /* Bind the items at once, without building the list. */
+            unsigned int base = zcontext->stacktop;
+            char *pattern = target;
+
+            err = zpushpattern(zcontext, &cursor, &target);
+            if (err == ZE_OK)
+                err = zbindpattern(zcontext,
+                                   pattern,
+                                   zcontext->stack + base);
+            zunwind(zcontext, base);
+            if (err != ZE_OK)
+                return err;
+            *entry = target + 1; /* Skip ASSIGN_END. */
+            return ZE_OK;
+        }
+    }
+    err = zeval(zcontext, &(*entry), &value);
     if (err != ZE_OK)
         return err;
     return zassign(zcontext, value, &(*entry));
 }
 
-void
-zskip_block(char **entry)
+/* The state of a \for loop is FORSTATE referenced values.
+ * Over a list, a byte array, the keys of a dict or the values of
+ *  a generator, they are the source, the position of the next item
+ *  (an Int) and NONE.
+ * Over a range() that is not built, they are the step and the next value
+ *  (Ints) and the end, whose type is that of the items.
+ */
+
+/* Set 'state' to walk the items of 'source'.
+ * If 'source' cannot be walked, return ZE_INVALID_ARGUMENT.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zforstart(Zob *source, Zob **state)
 {
-    char *cursor = *entry;
+    switch (ZTYPE(source)) {
+        case T_LIST:
+        case T_YARR:
+        case T_DICT:
+        case T_GEN:
+            break;
+        default:
+            return ZE_INVALID_ARGUMENT;
+    }
+    zincrefc(source);
+    state[0] = source;
+    state[1] = ZIMM(T_INT, 0);
+    state[2] = ZNONE;
+    return ZE_OK;
+}
 
-    while (*cursor != BLOCKEXIT  ||
-           *(cursor + 1) != END) {
-        if (*cursor == BLOCKEXIT) {
-            cursor++;
-            if (*cursor == BREAK ||
-                *cursor == CONTINUE)
-                cursor += 2;
-            else if (*cursor == RETURN) {
-                cursor++;
-                zskip_expr(&cursor);
-            }
+/* Set 'state' to count through the values of range(), whose start,
+ *  end and step are in 'argv', without building them.
+ * If the arguments are not taken by range(), return ZE_INVALID_ARGUMENT.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zforrange(Zob **argv, Zob **state)
+{
+    int start, step;
+    ZError err;
+
+    if (ZTYPE(argv[0]) != ZTYPE(argv[1])  ||
+        ZTYPE(argv[0]) != ZTYPE(argv[2]))
+        return ZE_INVALID_ARGUMENT;
+    switch (ZTYPE(argv[0])) {
+        case T_BYTE:
+            start = (int) ZBYTEVALUE(argv[0]);
+            step = (int) ZBYTEVALUE(argv[2]);
+            break;
+        case T_INT:
+            start = ZINTVALUE(argv[0]);
+            step = ZINTVALUE(argv[2]);
+            break;
+        default:
+            return ZE_INVALID_ARGUMENT;
+    }
+    err = zmkint(&state[0], step);
+    if (err != ZE_OK)
+        return err;
+    zincrefc(state[0]);
+    err = zmkint(&state[1], start);
+    if (err != ZE_OK) {
+        zdecrefc(state[0]);
+        return err;
+    }
+    zincrefc(state[1]);
+    zincrefc(argv[1]);
+    state[2] = argv[1];
+    return ZE_OK;
+}
+
+/* Advance the \for loop in 'state'.
+ * On success, 'pitem' holds a new reference to the next item,
+ *  or NULL past the last one.
+ * A generator is resumed, which may move the operand stack: 'state'
+ *  must not be used afterwards if it lives there.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by a generator or ZE_OK.
+ */
+ZError
+zfornext(Zob **state, Zob **pitem)
+{
+    Zob *source = state[0], *next;
+    int at = ZINTVALUE(state[1]);
+    ZError err;
+
+    *pitem = NULL;
+    if (ZTYPE(source) == T_GEN)
+        return zresume((ZGen *) source, pitem);
+    if (state[2] != ZNONE) {
+        /* Range: the sign of the step tells the direction. */
+        int step = ZINTVALUE(source), end, sign;
+
+        if (ZTYPE(state[2]) == T_BYTE) {
+            /* A Byte can only store positive values. */
+            end = (int) ZBYTEVALUE(state[2]);
+            sign = 1;
         }
-        else if (*cursor == DELETE) {
-            cursor++;
-            while (*cursor != '\0')
-                cursor += strlen(cursor) + 1;
-            cursor++;
+        else {
+            end = ZINTVALUE(state[2]);
+            sign = step < 0 ? -1 : 1;
         }
-        else if (*cursor == BLOCK) {
-            cursor++;
-            if (*cursor == IF) {
-                cursor++;
-                zskip_expr(&cursor);
-                zskip_block(&cursor);
-            }
-            while (*cursor == BLOCK  &&
-                   *(cursor + 1) == ELIF) {
-                cursor += 2;
-                zskip_expr(&cursor);
-                zskip_block(&cursor);
-            }
-            if (*cursor == BLOCK  &&
-                *(cursor + 1) == ELSE) {
-                cursor += 2;
-                zskip_block(&cursor);
-            }
-            else if (*cursor == WHILE) {
-                cursor++;
-                zskip_expr(&cursor);
-                zskip_block(&cursor);
-            }
-            else if (*cursor == DEF) {
-                cursor++;
-                cursor += strlen(cursor) + 1;
-                while (*cursor != '\0')
-                    cursor += strlen(cursor) + 1;
-                cursor++;
-                zskip_block(&cursor);
-            }
+        if (at * sign >= end * sign)
+            return ZE_OK;
+        err = zmkint(&next, at + step);
+        if (err != ZE_OK)
+            return err;
+        zincrefc(next);
+        if (ZTYPE(state[2]) == T_BYTE) {
+            *pitem = ZBYTE(at);
+            zdecrefc(state[1]);
         }
-        else {
-            /* Statement. */
-            zskip_expr(&cursor);
-            zskip_assign(&cursor);
+        else
+            /* The reference of the state goes to the item. */
+            *pitem = state[1];
+        state[1] = next;
+        return ZE_OK;
+    }
+    switch (ZTYPE(source)) {
+        case T_LIST:
+            if (at >= (int) ((ZList *) source)->length)
+                return ZE_OK;
+            err = zlget((ZList *) source, at, pitem);
+            if (err != ZE_OK)
+                return err;
+            at++;
+            break;
+        case T_YARR:
+            if (at >= (int) ((ZByteArray *) source)->length)
+                return ZE_OK;
+            *pitem = ZBYTE(((ZByteArray *) source)->bytes[at]);
+            at++;
+            break;
+        default:
+            {
+                ZDict *zdict = (ZDict *) source;
+
+                /* Removed pairs have no key. */
+                while (at < (int) zdict->npairs  &&
+                       zdict->pairs[at].key == NULL)
+                    at++;
+                if (at >= (int) zdict->npairs)
+                    return ZE_OK;
+                if (ZISMUTABLE(zdict->pairs[at].key)) {
+                    /* Changing the key itself would corrupt 'zdict'. */
+                    err = zcpyobj(zdict->pairs[at].key, pitem);
+                    if (err != ZE_OK) {
+                        *pitem = NULL;
+                        return err;
+                    }
+                }
+                else
+                    *pitem = zdict->pairs[at].key;
+                at++;
+            }
+    }
+    err = zmkint(&next, at);
+    if (err != ZE_OK) {
+        if (ZTYPE(source) == T_DICT  &&  ZISMUTABLE(*pitem))
+            /* A copy of the key. */
+            zdelobj(pitem);
+        *pitem = NULL;
+        return err;
+    }
+    zincrefc(*pitem);
+    zincrefc(next);
+    zdecrefc(state[1]);
+    state[1] = next;
+    return ZE_OK;
+}
+
+/* Drop the references held by the \for loop in 'state'. */
+void
+zforend(Zob **state)
+{
+    int i;
+
+    for (i = 0; i < FORSTATE; i++)
+        zdecrefc(state[i]);
+}
+
+/* Create in 'zgen' a new generator for a call to 'zhighfunc',
+ *  found in 'self', with the 'argc' arguments in 'argv'.
+ * The body is translated for the threaded code engine, if it is not yet.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewgen(ZContext *zcontext,
+        ZHighFunc *zhighfunc,
+        ZNameTable *self,
+        Zob **argv,
+        int argc,
+        ZGen **zgen)
+{
+    ZError err;
+
+    if (zhighfunc->code == NULL) {
+        /* Defined by the reference engine. */
+        err = zbodycode(zcontext, zhighfunc);
+        if (err != ZE_OK)
+            return err;
+    }
+    *zgen = (ZGen *) zalloc(sizeof(ZGen));
+    if (*zgen == NULL)
+        return ZE_OUT_OF_MEMORY;
+    (*zgen)->stack = (Zob **) zmalloc((zhighfunc->code->maxstack + 1) *
+                                      sizeof(Zob *));
+    if ((*zgen)->stack == NULL) {
+        zfree(*zgen, sizeof(ZGen));
+        *zgen = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
+    err = zpushframe(zcontext, zhighfunc->nslots);
+    if (err == ZE_OK) {
+        err = ztrack((Zob *) *zgen);
+        if (err != ZE_OK)
+            zdropframe(zcontext);
+    }
+    if (err != ZE_OK) {
+        zmfree((*zgen)->stack);
+        zfree(*zgen, sizeof(ZGen));
+        *zgen = NULL;
+        return err;
+    }
+    err = zbindargs(zcontext, zhighfunc, self, argv, argc);
+    if (err != ZE_OK) {
+        zuntrack((Zob *) *zgen);
+        zdropframe(zcontext);
+        zmfree((*zgen)->stack);
+        zfree(*zgen, sizeof(ZGen));
+        *zgen = NULL;
+        return err;
+    }
+    /* The frame waits apart until the body is resumed. */
+    (*zgen)->frame = zcontext->frame;
+    zcontext->frame = (*zgen)->frame->prev;
+    (*zgen)->type = (Zob) T_GEN;
+    (*zgen)->refc = 0;
+    (*zgen)->share = NULL;
+    (*zgen)->zcontext = zcontext;
+    (*zgen)->code = zhighfunc->code;
+    (*zgen)->resume = 0;
+    (*zgen)->depth = 0;
+    (*zgen)->running = 0;
+    return ZE_OK;
+}
+
+/* Remove 'zgen' from memory, along with its suspended call, if any. */
+void
+zdelgen(ZGen **zgen)
+{
+    ZFrame *frame = (*zgen)->frame;
+    unsigned int i;
+
+    zuntrack((Zob *) *zgen);
+    if (frame != NULL) {
+        /* The frame may outlive the spare frames of the context. */
+        for (i = 0; i < frame->nslots; i++)
+            if (frame->slots[i] != NULL)
+                zdecrefc(frame->slots[i]);
+        if (frame->names != NULL)
+            zdecrefc((Zob *) frame->names);
+        if (frame->ret != NULL)
+            zdecrefc(frame->ret);
+        zfree(frame, sizeof(ZFrame) + frame->size * sizeof(Zob *));
+    }
+    for (i = 0; i < (*zgen)->depth; i++)
+        zdecrefc((*zgen)->stack[i]);
+    zmfree((*zgen)->stack);
+    zfree(*zgen, sizeof(ZGen));
+    *zgen = NULL;
+}
+
+/* Release the values kept by 'zgen', from the last one, while '*budget'
+ *  lasts, and decrease it by the number of positions visited.
+ * Only meant for a generator that is being deleted: it cannot be
+ *  resumed anymore.
+ * Return nonzero once 'zgen' keeps no value.
+ */
+int
+zgdrain(ZGen *zgen, unsigned int *budget)
+{
+    ZFrame *frame = zgen->frame;
+
+    while (zgen->depth > 0  &&  *budget > 0) {
+        zdecrefc(zgen->stack[--zgen->depth]);
+        (*budget)--;
+    }
+    if (frame == NULL)
+        return zgen->depth == 0;
+    if (frame->ret != NULL  &&  *budget > 0) {
+        zdecrefc(frame->ret);
+        frame->ret = NULL;
+        (*budget)--;
+    }
+    if (frame->names != NULL  &&  *budget > 0) {
+        zdecrefc((Zob *) frame->names);
+        frame->names = NULL;
+        (*budget)--;
+    }
+    while (frame->nslots > 0  &&  *budget > 0) {
+        Zob **slot = &frame->slots[--frame->nslots];
+
+        if (*slot != NULL) {
+            zdecrefc(*slot);
+            *slot = NULL;
         }
+        (*budget)--;
     }
-    cursor += 2;
+    return zgen->depth == 0  &&  frame->ret == NULL  &&
+           frame->names == NULL  &&  frame->nslots == 0;
+}
+
+/* Release all the values kept by 'zgen', which cannot be resumed
+ *  anymore.
+ */
+void
+zgempty(ZGen *zgen)
+{
+    unsigned int budget = ZDRAINALL;
+
+    (void) zgdrain(zgen, &budget);
+}
+
+int
+zrepgen(char *buffer, size_t size, ZGen *zgen)
+{
+    (void) zgen;
+    return snprintf(buffer, size, "<generator>");
+}
+
+/* Run 'zgen' up to its next yield.
+ * On success, 'pitem' holds a new reference to the value yielded,
+ *  or NULL once the body has returned.
+ * If the body of 'zgen' is already running, return ZE_GENERATOR_RUNNING.
+ * If no more calls can run, return ZE_CALL_TOO_DEEP.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by the body or ZE_OK.
+ */
+ZError
+zresume(ZGen *zgen, Zob **pitem)
+{
+    ZContext *zcontext = zgen->zcontext;
+    ZFrame *frame = zgen->frame;
+    Zob *ret;
+    ZError err;
+
+    *pitem = NULL;
+    if (frame == NULL)
+        return ZE_OK;
+    if (zgen->running)
+        return ZE_GENERATOR_RUNNING;
+    err = zcheckdepth(zcontext);
+    if (err != ZE_OK)
+        return err;
+    zgen->running = 1;
+    frame->prev = zcontext->frame;
+    zcontext->frame = frame;
+    zcontext->depth++;
+    err = zrun_gen(zcontext, zgen, &ret);
+    zcontext->depth--;
+    if (err == ZE_OK  &&  !zgen->running) {
+        /* Suspended at a yield. */
+        zcontext->frame = frame->prev;
+        *pitem = ret;
+        return ZE_OK;
+    }
+    /* The body is done: what it returns is not a value of 'zgen'. */
+    if (err == ZE_OK)
+        zdecrefc(ret);
+    zdropframe(zcontext);
+    zgen->frame = NULL;
+    zgen->running = 0;
+    return err;
+}
+
+/* Evaluate the source of the \for loop pointed by 'entry' and set
+ *  'state' to walk it.
+ * A call to the builtin range() is not made: its values are counted
+ *  as the loop goes.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by the source or ZE_OK.
+ */
+static ZError
+zforsource(ZContext *zcontext, char **entry, Zob **state)
+{
+    char *cursor = *entry;
+    ZNameTable *self;
+    Zob *source;
+    ZError err;
+
+    if (*cursor == CALLSTART  &&
+        zgetincontext(zcontext, cursor + 1, &self, &source)  &&
+        zisrange(source)) {
+        unsigned int base = zcontext->stacktop;
+
+        cursor++;
+        cursor += strlen(cursor) + 1; /* Skip STRING_END. */
+        err = zpushargs(zcontext, &cursor);
+        if (err != ZE_OK)
+            return err;
+        cursor++; /* Skip CALL_END. */
+        if (zcontext->stacktop - base != 3)
+            err = ZE_ARITY_ERROR;
+        else
+            err = zforrange(zcontext->stack + base, state);
+        zunwind(zcontext, base);
+        *entry = cursor;
+        return err;
+    }
+    err = zeval(zcontext, &cursor, &source);
+    if (err != ZE_OK)
+        return err;
     *entry = cursor;
+    return zforstart(source, state);
+}
+
+/* Run the \for block whose source is pointed by 'entry',
+ *  inside 'looplev' loops.
+ * Leave in 'be' only the exits that go past this loop.
+ */
+static ZError
+zrun_for(ZContext *zcontext,
+         char looplev,
+         char **entry,
+         unsigned char *be)
+{
+    char *cursor = *entry, *target, *block, *b;
+    unsigned int mark = zcontext->ntemps;
+    Zob *state[FORSTATE], *item;
+    ZError err;
+
+    err = zforsource(zcontext, &cursor, state);
+    zrelease(zcontext, mark);
+    if (err != ZE_OK)
+        return err;
+    target = cursor;
+    zskip_assign(&cursor);
+    block = cursor;
+    *be = BE_END;
+    for (;;) {
+        err = zfornext(state, &item);
+        if (err != ZE_OK  ||  item == NULL)
+            break;
+        b = target;
+        err = zassign(zcontext, item, &b);
+        zdecrefc(item);
+        if (err != ZE_OK)
+            break;
+        b = block;
+        err = zrun_block(zcontext, looplev + 1, &b, be);
+        if (err != ZE_OK  ||  (*be & BE_RETURN))
+            break;
+        if (*be & BE_BREAK) {
+            if (*be - BE_BREAK > 0)
+                /* Propagate. */
+                (*be)--;
+            else
+                *be = BE_END;
+            break;
+        }
+        if (*be & BE_CONTINUE) {
+            if (*be - BE_CONTINUE > 0) {
+                /* Propagate. */
+                (*be)--;
+                break;
+            }
+            *be = BE_END;
+        }
+    }
+    zforend(state);
+    return err;
+}
+
+/* Skip the block whose header is pointed by 'entry'. */
+void
+zskip_block(char **entry)
+{
+    char *cursor = *entry;
+    unsigned int length;
+
+    cursor += 2; /* Skip BLOCK and block kind. */
+    length = zreadword(&cursor);
+    *entry = cursor + length;
 }
 
 ZError
 zrun_block(ZContext *zcontext,
-          ZList *tmp,
           char looplev,
           char **entry,
           unsigned char *be)
 {
     char *cursor = *entry;
+    /* Temporaries below this mark belong to the caller. */
+    unsigned int mark = zcontext->ntemps;
     int truth;
     ZError err;
 
@@ -834,90 +2083,105 @@ zrun_block(ZContext *zcontext,
             }
             cursor++;
         }
+        else if (*cursor == YIELD) {
+            /* Generator bodies are only run by the threaded engine. */
+            return ZE_YIELD_WITHOUT_GENERATOR;
+        }
         else if (*cursor == BLOCK) {
+            char *end;
+            unsigned int length;
+
             cursor++;
             if (*cursor == IF) {
                 int ok = 0;
                 Zob *zob;
 
                 cursor++;
-                err = zeval(zcontext, tmp, &cursor, &zob);
+                length = zreadword(&cursor);
+                end = cursor + length;
+                err = zeval(zcontext, &cursor, &zob);
                 if (err != ZE_OK)
                     return err;
                 truth = ztstobj(zob);
+                zrelease(zcontext, mark);
                 if (err != ZE_OK)
                     return err;
                 if (truth) {
-                    err = zrun_block(zcontext, tmp, looplev, &cursor, be);
+                    err = zrun_block(zcontext, looplev, &cursor, be);
                     if (err != ZE_OK)
                         return err;
                     if (*be & (BE_BREAK | BE_CONTINUE | BE_RETURN))
                         return ZE_OK;
                     ok = 1;
                 }
-                else
-                    zskip_block(&cursor);
+                cursor = end;
                 while (*cursor == BLOCK  &&
                        *(cursor + 1) == ELIF) {
-                    cursor += 2;
                     if (ok) {
-                        zskip_expr(&cursor);
                         zskip_block(&cursor);
+                        continue;
                     }
-                    else {
-                        err = zeval(zcontext, tmp, &cursor, &zob);
-                        if (err != ZE_OK)
-                            return err;
-                        truth = ztstobj(zob);
+                    cursor += 2;
+                    length = zreadword(&cursor);
+                    end = cursor + length;
+                    err = zeval(zcontext, &cursor, &zob);
+                    if (err != ZE_OK)
+                        return err;
+                    truth = ztstobj(zob);
+                    zrelease(zcontext, mark);
+                    if (err != ZE_OK)
+                        return err;
+                    if (truth) {
+                        err = zrun_block(zcontext, looplev,
+                                         &cursor, be);
                         if (err != ZE_OK)
                             return err;
-                        if (truth) {
-                            err = zrun_block(zcontext, tmp, looplev,
-                                             &cursor, be);
-                            if (err != ZE_OK)
-                                return err;
-                            if (*be & (BE_BREAK | BE_CONTINUE | BE_RETURN))
-                                return ZE_OK;
-                            ok = 1;
-                        }
-                        else
-                            zskip_block(&cursor);
+                        if (*be & (BE_BREAK | BE_CONTINUE | BE_RETURN))
+                            return ZE_OK;
+                        ok = 1;
                     }
+                    cursor = end;
                 }
                 if (*cursor == BLOCK  &&
                     *(cursor + 1) == ELSE) {
-                    cursor += 2;
                     if (ok)
                         zskip_block(&cursor);
                     else {
-                        err = zrun_block(zcontext, tmp, looplev,
+                        cursor += 2;
+                        length = zreadword(&cursor);
+                        end = cursor + length;
+                        err = zrun_block(zcontext, looplev,
                                          &cursor, be);
                         if (err != ZE_OK)
                             return err;
                         if (*be & (BE_BREAK | BE_CONTINUE | BE_RETURN))
                             return ZE_OK;
+                        cursor = end;
                     }
                 }
             }
             else if (*cursor == WHILE) {
-                char *cond, *block, *blockend = NULL;
+                char *cond, *block;
                 char *b, *c;
                 Zob *zob;
 
                 cursor++;
+                length = zreadword(&cursor);
+                end = cursor + length;
                 cond = cursor;
                 zskip_expr(&cursor);
                 block = cursor;
                 c = cond;
-                err = zeval(zcontext, tmp, &c, &zob);
+                err = zeval(zcontext, &c, &zob);
                 if (err != ZE_OK)
                     return err;
                 truth = ztstobj(zob);
+                zrelease(zcontext, mark);
                 if (err != ZE_OK)
                     return err;
                 while (truth) {
                     b = block;
-                    err = zrun_block(zcontext, tmp, looplev + 1, &b, be);
+                    err = zrun_block(zcontext, looplev + 1, &b, be);
                     if (err != ZE_OK)
                         return err;
                     if (*be & BE_RETURN)
@@ -930,49 +2194,66 @@ zrun_block(ZContext *zcontext,
                         }
                         break;
                     }
-                    blockend = b;
+                    if (*be & BE_CONTINUE) {
+                        if (*be - BE_CONTINUE > 0) {
+                            /* Propagate. */
+                            (*be)--;
+                            return ZE_OK;
+                        }
+                    }
                     c = cond;
-                    err = zeval(zcontext, tmp, &c, &zob);
+                    err = zeval(zcontext, &c, &zob);
                     if (err != ZE_OK)
                         return err;
                     truth = ztstobj(zob);
+                    zrelease(zcontext, mark);
                     if (err != ZE_OK)
                         return err;
-                    if (*be & BE_CONTINUE)
-                        if (!truth)
-                            if (*be - BE_CONTINUE > 0) {
-                                /* Propagate. */
-                                (*be)--;
-                                return ZE_OK;
-                            }
                 }
-                if (blockend == NULL)
-                    zskip_block(&cursor);
-                else
-                    cursor = blockend;
+                cursor = end;
+            }
+            else if (*cursor == FOR) {
+                cursor++;
+                length = zreadword(&cursor);
+                end = cursor + length;
+                err = zrun_for(zcontext, looplev, &cursor, be);
+                if (err != ZE_OK)
+                    return err;
+                if (*be & (BE_BREAK | BE_CONTINUE | BE_RETURN))
+                    return ZE_OK;
+                cursor = end;
             }
-            else if (*cursor == DEF) {
+            else if (*cursor == DEF  ||  *cursor == GEN) {
                 /* Function definition. */
                 char *name;
-                char *zapfunc;
                 unsigned char arity = 0;
                 ZFunc *zfunc;
                 ZHighFunc *zhighfunc;
+                int generator = (*cursor == GEN);
 
                 cursor++;
+                length = zreadword(&cursor);
+                end = cursor + length;
                 name = cursor;
                 cursor += strlen(name) + 1;
-                zapfunc = cursor;
                 while (*cursor != '\0') {
                     arity++;
                     cursor += strlen(cursor) + 1;
                 }
                 cursor++;
-                zskip_block(&cursor);
                 err = znewhighfunc(&zhighfunc);
                 if (err != ZE_OK)
                     return err;
-                zhighfunc->func = zapfunc;
+                zhighfunc->nslots = (unsigned char) *cursor;
+                cursor++;
+                if (*cursor == NOSELF)
+                    zhighfunc->self = -1;
+                else
+                    zhighfunc->self = (unsigned char) *cursor;
+                cursor++;
+                zhighfunc->func = cursor;
+                zhighfunc->generator = generator;
+                cursor = end;
                 err = znewfunc(&zfunc, (FImp *) zhighfunc, arity);
                 if (err != ZE_OK)
                     return err;
@@ -983,11 +2264,12 @@ zrun_block(ZContext *zcontext,
         }
         else {
             /* Statement. */
-            err = zrunstatement(zcontext, tmp, &cursor);
+            err = zrunstatement(zcontext, &cursor);
             if (err != ZE_OK)
                 return err;
             /* Garbage Collection. */
-            zlempty(tmp);
+            zrelease(zcontext, mark);
+            zautocollect();
         }
     }
     cursor++;
@@ -1019,16 +2301,25 @@ zrun_block(ZContext *zcontext,
     }
     if (*cursor == RETURN) {
         Zob *ret;
+        int pending;
 
         /* Function Return. */
         cursor++;
-        err = zeval(zcontext, tmp, &cursor, &ret);
+        err = ztailcall(zcontext, &cursor, &pending);
         if (err != ZE_OK)
             return err;
-        err = zsetincontext(zcontext, "_ret_", ret);
+        if (pending) {
+            *be = BE_RETURN;
+            return ZE_OK;
+        }
+        err = zeval(zcontext, &cursor, &ret);
         if (err != ZE_OK)
             return err;
-        *be = 0;
+        if (zcontext->frame != NULL) {
+            zincrefc(ret);
+            zcontext->frame->ret = ret;
+        }
+        *be = BE_RETURN;
         return ZE_OK;
     }
     return ZE_OK;
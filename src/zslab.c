@@ -0,0 +1,215 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Slab Allocator */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "zerr.h"
+#include "zalloc.h"
+#include "zslab.h"
+
+/* A free object holds the next one of its class. */
+typedef struct ZFree {
+    struct ZFree *next;
+} ZFree;
+
+/* Slabs are chained through their first word, to be freed at exit. */
+typedef struct ZSlab {
+    struct ZSlab *next;
+} ZSlab;
+
+typedef struct {
+    ZFree *free;
+    /* Uncarved part of the last slab of this class. */
+    char *cursor;
+    char *end;
+    /* Allocations, those served by the free list, and frees. */
+    unsigned long allocs;
+    unsigned long hits;
+    unsigned long frees;
+    unsigned int nslabs;
+} ZClass;
+
+/* Free lists of one allocator, which the slabs come from. */
+typedef struct {
+    ZClass classes[SLABCLASSES];
+    ZSlab *slabs;
+    unsigned long bigallocs;
+} ZSlabs;
+
+/* Return the class index for objects of 'size' bytes. */
+#define SLABCLASS(size) (((size) - 1) / SLABGRAIN)
+
+/* Return the free lists of 'za', creating them on first use,
+ *  or NULL if there is not enough memory.
+ */
+static ZSlabs *
+zgetslabs(ZAllocator *za)
+{
+    ZSlabs *zslabs;
+
+    if (za->slabs == NULL) {
+        zslabs = (ZSlabs *) za->alloc(za, sizeof(ZSlabs));
+        if (zslabs == NULL)
+            return NULL;
+        memset(zslabs, 0, sizeof(ZSlabs));
+        za->slabs = zslabs;
+    }
+    return (ZSlabs *) za->slabs;
+}
+
+/* Return a block of at least 'size' bytes, or NULL if there is not
+ *  enough memory.
+ * It must be released with zfree() and the same 'size'.
+ */
+void *
+zalloc(size_t size)
+{
+#ifdef ZNOSLAB
+    return zmalloc(size);
+#else
+    ZAllocator *za = zgetallocator();
+    ZSlabs *zslabs;
+    ZClass *class;
+    void *ptr;
+
+    if (za->noslab)
+        return za->alloc(za, size);
+    zslabs = zgetslabs(za);
+    if (zslabs == NULL)
+        return NULL;
+    if (size == 0  ||  size > SLABMAX) {
+        zslabs->bigallocs++;
+        return za->alloc(za, size);
+    }
+    class = &zslabs->classes[SLABCLASS(size)];
+    class->allocs++;
+    if (class->free != NULL) {
+        class->hits++;
+        ptr = class->free;
+        class->free = class->free->next;
+        return ptr;
+    }
+    if (class->cursor == class->end) {
+        ZSlab *slab = (ZSlab *) za->alloc(za, SLABSIZE);
+
+        if (slab == NULL) {
+            class->allocs--;
+            return NULL;
+        }
+        slab->next = zslabs->slabs;
+        zslabs->slabs = slab;
+        class->nslabs++;
+        /* Keep objects aligned on the grain past the chain link. */
+        class->cursor = (char *) slab + SLABGRAIN;
+        class->end = class->cursor +
+                     (SLABSIZE - SLABGRAIN) /
+                     ((SLABCLASS(size) + 1) * SLABGRAIN) *
+                     ((SLABCLASS(size) + 1) * SLABGRAIN);
+    }
+    ptr = class->cursor;
+    class->cursor += (SLABCLASS(size) + 1) * SLABGRAIN;
+    return ptr;
+#endif
+}
+
+/* Release 'ptr', a block of 'size' bytes returned by zalloc(). */
+void
+zfree(void *ptr, size_t size)
+{
+#ifdef ZNOSLAB
+    zmfree(ptr);
+#else
+    ZAllocator *za = zgetallocator();
+    ZClass *class;
+
+    if (ptr == NULL)
+        return;
+    if (za->noslab  ||  size == 0  ||  size > SLABMAX) {
+        za->release(za, ptr);
+        return;
+    }
+    class = &((ZSlabs *) za->slabs)->classes[SLABCLASS(size)];
+    class->frees++;
+    ((ZFree *) ptr)->next = class->free;
+    class->free = (ZFree *) ptr;
+#endif
+}
+
+/* Print allocation counts and free list hit rates per class
+ *  of the current allocator on stderr.
+ */
+void
+zslabstats()
+{
+    ZSlabs *zslabs = (ZSlabs *) zgetallocator()->slabs;
+    unsigned long allocs = 0, hits = 0;
+    int i;
+
+    if (zslabs == NULL) {
+        fprintf(stderr, "no slabs in use\n");
+        return;
+    }
+    fprintf(stderr, "class    allocs      hits   hit%%      live  slabs\n");
+    for (i = 0; i < SLABCLASSES; i++) {
+        ZClass *class = &zslabs->classes[i];
+
+        if (class->allocs == 0)
+            continue;
+        fprintf(stderr,
+                "%5d %9lu %9lu %5.1f%% %9lu %6u\n",
+                (i + 1) * SLABGRAIN,
+                class->allocs,
+                class->hits,
+                100.0 * class->hits / class->allocs,
+                class->allocs - class->frees,
+                class->nslabs);
+        allocs += class->allocs;
+        hits += class->hits;
+    }
+    if (allocs > 0)
+        fprintf(stderr, "total %9lu %9lu %5.1f%%\n",
+                allocs, hits, 100.0 * hits / allocs);
+    fprintf(stderr, "%lu allocation(s) larger than %d bytes\n",
+            zslabs->bigallocs, SLABMAX);
+}
+
+/* Give the slabs of the current allocator back to it.
+ * Every object carved from them is gone after this.
+ */
+void
+zdelslabs()
+{
+    ZAllocator *za = zgetallocator();
+    ZSlabs *zslabs = (ZSlabs *) za->slabs;
+    ZSlab *next;
+
+    if (zslabs == NULL)
+        return;
+    while (zslabs->slabs != NULL) {
+        next = zslabs->slabs->next;
+        za->release(za, zslabs->slabs);
+        zslabs->slabs = next;
+    }
+    za->release(za, zslabs);
+    za->slabs = NULL;
+}
@@ -0,0 +1,1845 @@
+/* Copyright 2010-2011 by Marcel Rodrigues <marcelgmr@gmail.com>
+ *
+ * This file is part of zap.
+ *
+ * zap is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * zap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with zap.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Threaded Code Engine */
+
+/* In This File:
+ * - Translation of bytecode into pre-decoded instructions.
+ * - Execution of pre-decoded instructions.
+ */
+
+/* The bytecode is decoded only once, when a module is loaded.
+ * Literals, names and jump targets are stored in the instructions,
+ *  so running a loop body does not parse any byte again.
+ * With GCC, each instruction also holds the address of its handler
+ *  (threaded code). Other compilers dispatch through a switch.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ztypes.h"
+#include "zerr.h"
+#include "zgc.h"
+#include "zalloc.h"
+
+#include "znone.h"
+#include "zbool.h"
+#include "zbyte.h"
+#include "zint.h"
+#include "zbytearray.h"
+#include "zbignum.h"
+#include "zlist.h"
+#include "zatom.h"
+#include "znametable.h"
+#include "zdict.h"
+#include "zfunc.h"
+
+#include "zobject.h"
+
+#include "zruntime.h"
+#include "zbuiltin.h"
+#include "zvm.h"
+
+#if defined(__GNUC__) && !defined(ZVM_NO_THREADING)
+#define ZTHREADED 1
+#else
+#define ZTHREADED 0
+#endif
+
+/* A loop being translated. */
+typedef struct ZLoop {
+    /* Instruction that evaluates the loop condition. */
+    unsigned int cond;
+    /* Chain of jumps to the end of the loop. */
+    int breaks;
+    /* Depth of the operand stack in the loop body. */
+    unsigned int depth;
+    struct ZLoop *outer;
+} ZLoop;
+
+/* Translation state. */
+typedef struct {
+    /* Context that owns the constants. */
+    ZContext *zcontext;
+    /* Module code, which owns all function bodies. */
+    ZCode *root;
+    /* Code being emitted. */
+    ZCode *zcode;
+    /* Current depth of the operand stack. */
+    unsigned int depth;
+    ZLoop *loop;
+    /* Nonzero in the body of a generator. */
+    int generator;
+} ZTrans;
+
+static ZError ztr_block(ZTrans *tr, char **entry);
+static ZError ztr_assign(ZTrans *tr, char **entry);
+
+/* Create a new empty ZCode in 'zcode'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zallocode(ZCode **zcode)
+{
+    *zcode = (ZCode *) zmalloc(sizeof(ZCode));
+    if (*zcode == NULL)
+        return ZE_OUT_OF_MEMORY;
+    (*zcode)->size = 16;
+    (*zcode)->instrs = (ZInstr *) zmalloc((*zcode)->size * sizeof(ZInstr));
+    if ((*zcode)->instrs == NULL) {
+        zmfree(*zcode);
+        *zcode = NULL;
+        return ZE_OUT_OF_MEMORY;
+    }
+    (*zcode)->length = 0;
+    (*zcode)->maxstack = 0;
+    (*zcode)->nslots = 0;
+    (*zcode)->self = -1;
+    (*zcode)->generator = 0;
+    (*zcode)->threaded = 0;
+    (*zcode)->next = NULL;
+    return ZE_OK;
+}
+
+/* Append an instruction with opcode 'op' to the code being emitted.
+ * Save its index in 'at', if 'at' is not NULL.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zemit(ZTrans *tr, int op, unsigned int *at)
+{
+    ZCode *zcode = tr->zcode;
+    ZInstr *instr;
+
+    if (zcode->length == zcode->size) {
+        instr = (ZInstr *) zrealloc(zcode->instrs,
+                                   2 * zcode->size * sizeof(ZInstr));
+        if (instr == NULL)
+            return ZE_OUT_OF_MEMORY;
+        zcode->instrs = instr;
+        zcode->size *= 2;
+    }
+    instr = zcode->instrs + zcode->length;
+    instr->label = NULL;
+    instr->op = op;
+    instr->n = 0;
+    instr->s = NULL;
+    instr->zob = NULL;
+    instr->atom = NULL;
+    instr->path = NULL;
+    instr->npath = 0;
+    instr->entry = NULL;
+    instr->version = 0;
+    instr->code = NULL;
+    if (at != NULL)
+        *at = zcode->length;
+    zcode->length++;
+    return ZE_OK;
+}
+
+/* Return the last instruction emitted. */
+static ZInstr *
+zlast(ZTrans *tr)
+{
+    return tr->zcode->instrs + tr->zcode->length - 1;
+}
+
+/* Account for 'n' values pushed to (n > 0) or popped from (n < 0)
+ *  the operand stack.
+ */
+static void
+zdepth(ZTrans *tr, int n)
+{
+    tr->depth += n;
+    if (tr->depth > tr->zcode->maxstack)
+        tr->zcode->maxstack = tr->depth;
+}
+
+/* Emit a jump and link it to 'chain'. */
+static ZError
+zjump(ZTrans *tr, int op, int *chain)
+{
+    unsigned int at;
+    ZError err;
+
+    err = zemit(tr, op, &at);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = *chain;
+    *chain = (int) at;
+    return ZE_OK;
+}
+
+/* Split 'name' into atoms for the last instruction emitted:
+ *  the first component goes to 'atom', the others (if any) to 'path'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zatomof(ZTrans *tr, char *name)
+{
+    ZInstr *instr = zlast(tr);
+    char *dot;
+    unsigned int i;
+    ZError err;
+
+    if (*name == LOCAL)
+        name += 2;
+    dot = strchr(name, '.');
+    if (dot == NULL)
+        return zintern(name, &instr->atom);
+    err = zinternn(name, dot - name, &instr->atom);
+    if (err != ZE_OK)
+        return err;
+    for (instr->npath = 1, name = dot + 1; *name != '\0'; name++)
+        if (*name == '.')
+            instr->npath++;
+    instr->path = (ZAtom **) zmalloc(instr->npath * sizeof(ZAtom *));
+    if (instr->path == NULL) {
+        instr->npath = 0;
+        return ZE_OUT_OF_MEMORY;
+    }
+    name = dot + 1;
+    for (i = 0; i < instr->npath; i++) {
+        dot = strchr(name, '.');
+        if (dot == NULL)
+            dot = name + strlen(name);
+        err = zinternn(name, dot - name, &instr->path[i]);
+        if (err != ZE_OK)
+            return err;
+        name = dot + 1;
+    }
+    return ZE_OK;
+}
+
+/* Make all jumps in 'chain' target 'target'. */
+static void
+zpatch(ZTrans *tr, int chain, unsigned int target)
+{
+    ZInstr *instrs = tr->zcode->instrs;
+    int next;
+
+    while (chain >= 0) {
+        next = instrs[chain].n;
+        instrs[chain].n = (int) target;
+        chain = next;
+    }
+}
+
+/* Translate the bytecode expression pointed by 'entry'. */
+static ZError
+ztr_expr(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    ZError err;
+
+    switch (*cursor) {
+        case T_NONE:
+            err = zemit(tr, ZOP_NONE, NULL);
+            if (err != ZE_OK)
+                return err;
+            cursor++;
+            break;
+        case T_BOOL:
+            err = zemit(tr, ZOP_BOOL, NULL);
+            if (err != ZE_OK)
+                return err;
+            cursor++;
+            zlast(tr)->n = (int) *cursor;
+            cursor++;
+            break;
+        case T_BYTE:
+            err = zemit(tr, ZOP_BYTE, NULL);
+            if (err != ZE_OK)
+                return err;
+            cursor++;
+            zlast(tr)->n = (int) (unsigned char) *cursor;
+            cursor++;
+            break;
+        case T_INT:
+        case T_YARR:
+        case T_BNUM:
+            /* Taken from the constant pool of the context.
+             * Byte arrays are mutable: each evaluation makes a new one.
+             */
+            err = zemit(tr, *cursor == T_YARR ? ZOP_YARR : ZOP_CONST, NULL);
+            if (err != ZE_OK)
+                return err;
+            err = zconstant(tr->zcontext, &cursor, &zlast(tr)->zob);
+            if (err != ZE_OK)
+                return err;
+            break;
+        case T_LIST:
+            {
+                int count = 0;
+
+                cursor++;
+                while (*cursor != '\0') {
+                    err = ztr_expr(tr, &cursor);
+                    if (err != ZE_OK)
+                        return err;
+                    count++;
+                }
+                cursor++; /* Skip LIST_END. */
+                err = zemit(tr, ZOP_LIST, NULL);
+                if (err != ZE_OK)
+                    return err;
+                zlast(tr)->n = count;
+                zdepth(tr, -count);
+            }
+            break;
+        case T_DICT:
+            {
+                int count = 0;
+
+                cursor++;
+                while (*cursor != '\0') {
+                    err = ztr_expr(tr, &cursor);  /* Key. */
+                    if (err != ZE_OK)
+                        return err;
+                    err = ztr_expr(tr, &cursor);  /* Value. */
+                    if (err != ZE_OK)
+                        return err;
+                    count++;
+                }
+                cursor++; /* Skip DICT_END. */
+                err = zemit(tr, ZOP_DICT, NULL);
+                if (err != ZE_OK)
+                    return err;
+                zlast(tr)->n = count;
+                zdepth(tr, -2 * count);
+            }
+            break;
+        case CALLSTART:
+            {
+                char *name;
+                int count = 0;
+
+                cursor++;
+                name = cursor;
+                cursor += strlen(cursor) + 1; /* Skip STRING_END. */
+                while (*cursor != CALLEND) {
+                    err = ztr_expr(tr, &cursor);
+                    if (err != ZE_OK)
+                        return err;
+                    count++;
+                }
+                cursor++; /* Skip CALL_END. */
+                err = zemit(tr, ZOP_CALL, NULL);
+                if (err != ZE_OK)
+                    return err;
+                zlast(tr)->n = count;
+                zlast(tr)->s = name;
+                err = zatomof(tr, name);
+                if (err != ZE_OK)
+                    return err;
+                zdepth(tr, -count);
+            }
+            break;
+        default:
+            /* Name. */
+            if (*cursor == LOCAL  &&  SLOT(cursor) != SPILL  &&
+                strchr(cursor + 2, '.') == NULL) {
+                err = zemit(tr, ZOP_LOCAL, NULL);
+                if (err != ZE_OK)
+                    return err;
+                zlast(tr)->n = (int) SLOT(cursor);
+            }
+            else {
+                err = zemit(tr, ZOP_NAME, NULL);
+                if (err != ZE_OK)
+                    return err;
+            }
+            zlast(tr)->s = cursor;
+            err = zatomof(tr, cursor);
+            if (err != ZE_OK)
+                return err;
+            cursor += strlen(cursor) + 1; /* Skip STRING_END. */
+    }
+    zdepth(tr, 1);
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate the items of the list literal pointed by 'entry' along the
+ *  list pattern pointed by 'target', which matches it (zunpackable()).
+ * Items matched by inner patterns are translated in turn, so that each
+ *  name gets a value on the operand stack.
+ */
+static ZError
+ztr_pattern(ZTrans *tr, char **entry, char **target)
+{
+    char *cursor = *entry + 1, *name = *target + 1;
+    ZError err;
+
+    while (*name != ASGNCLOSE) {
+        if (*name == ASGNOPEN)
+            err = ztr_pattern(tr, &cursor, &name);
+        else {
+            err = ztr_expr(tr, &cursor);
+            name += strlen(name) + 1; /* Skip NAME_END. */
+        }
+        if (err != ZE_OK)
+            return err;
+    }
+    *entry = cursor + 1; /* Skip LIST_END. */
+    *target = name + 1;
+    return ZE_OK;
+}
+
+/* If the assignment pointed by 'target' is a single list pattern
+ *  of names only, return the number of names.
+ * Otherwise, return zero.
+ */
+static int
+zflatpattern(char *target)
+{
+    int count = 0;
+
+    if (*target != ASGNOPEN)
+        return 0;
+    for (target++; *target != ASGNCLOSE; count++) {
+        if (*target == ASGNOPEN)
+            return 0;
+        target += strlen(target) + 1; /* Skip NAME_END. */
+    }
+    return *(target + 1) == '\0' ? count : 0;
+}
+
+/* Translate the statement pointed by 'entry'.
+ * A list literal destructured by the assignment is not built: its items
+ *  are bound from the operand stack. So are those of a list returned by
+ *  a call destructured into names, if the callee returns a list literal
+ *  of the right length.
+ */
+static ZError
+ztr_statement(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry, *target = *entry;
+    int count;
+    ZError err;
+
+    zskip_expr(&target);
+    count = zunpackable(cursor, target);
+    if (count >= 0) {
+        char *pattern = target;
+
+        err = ztr_pattern(tr, &cursor, &target);
+        if (err == ZE_OK)
+            err = zemit(tr, ZOP_UNPACK, NULL);
+        if (err != ZE_OK)
+            return err;
+        zlast(tr)->n = count;
+        zlast(tr)->s = pattern;
+        zdepth(tr, -count);
+        *entry = target + 1; /* Skip ASSIGN_END. */
+        return ZE_OK;
+    }
+    count = zflatpattern(target);
+    if (*cursor == CALLSTART  &&  count > 0) {
+        err = ztr_expr(tr, &cursor);
+        if (err == ZE_OK)
+            err = zemit(tr, ZOP_RECEIVE, NULL);
+        if (err != ZE_OK)
+            return err;
+        zlast(tr)->n = count;
+        zlast(tr)->s = target;
+        /* The call may leave 'count' items instead of its result. */
+        zdepth(tr, count - 1);
+        zdepth(tr, -count);
+        zskip_assign(&target);
+        *entry = target;
+        return ZE_OK;
+    }
+    err = ztr_expr(tr, &cursor);
+    if (err == ZE_OK)
+        err = ztr_assign(tr, &cursor);
+    *entry = cursor;
+    return err;
+}
+
+/* Translate the assignment pointed by 'entry',
+ *  which consumes the value on top of the operand stack.
+ */
+static ZError
+ztr_assign(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    ZError err;
+
+    if (*cursor == '\0') {
+        /* Expression statement. */
+        err = zemit(tr, ZOP_POP, NULL);
+        cursor++;
+    }
+    else if (*cursor != ASGNOPEN  &&
+             *(cursor + strlen(cursor) + 1) == '\0') {
+        /* Single name. */
+        if (*cursor == LOCAL  &&  SLOT(cursor) != SPILL  &&
+            strchr(cursor + 2, '.') == NULL) {
+            err = zemit(tr, ZOP_SETLOCAL, NULL);
+            if (err != ZE_OK)
+                return err;
+            zlast(tr)->n = (int) SLOT(cursor);
+        }
+        else {
+            err = zemit(tr, ZOP_SETNAME, NULL);
+            if (err != ZE_OK)
+                return err;
+        }
+        zlast(tr)->s = cursor;
+        err = zatomof(tr, cursor);
+        cursor += strlen(cursor) + 2;
+    }
+    else {
+        err = zemit(tr, ZOP_ASSIGN, NULL);
+        if (err != ZE_OK)
+            return err;
+        zlast(tr)->s = cursor;
+        zskip_assign(&cursor);
+    }
+    zdepth(tr, -1);
+    *entry = cursor;
+    return err;
+}
+
+/* Translate an if block and its elif and else blocks.
+ * 'entry' points to the condition of the if block.
+ */
+static ZError
+ztr_if(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    int next = -1, done = -1;
+    ZError err;
+
+    err = ztr_expr(tr, &cursor);
+    if (err != ZE_OK)
+        return err;
+    err = zjump(tr, ZOP_JUMPIFNOT, &next);
+    if (err != ZE_OK)
+        return err;
+    zdepth(tr, -1);
+    err = ztr_block(tr, &cursor);
+    if (err != ZE_OK)
+        return err;
+    while (*cursor == BLOCK  &&
+           *(cursor + 1) == ELIF) {
+        cursor += 2;
+        (void) zreadword(&cursor); /* Skip block length. */
+        err = zjump(tr, ZOP_JUMP, &done);
+        if (err != ZE_OK)
+            return err;
+        zpatch(tr, next, tr->zcode->length);
+        next = -1;
+        err = ztr_expr(tr, &cursor);
+        if (err != ZE_OK)
+            return err;
+        err = zjump(tr, ZOP_JUMPIFNOT, &next);
+        if (err != ZE_OK)
+            return err;
+        zdepth(tr, -1);
+        err = ztr_block(tr, &cursor);
+        if (err != ZE_OK)
+            return err;
+    }
+    if (*cursor == BLOCK  &&
+        *(cursor + 1) == ELSE) {
+        cursor += 2;
+        (void) zreadword(&cursor); /* Skip block length. */
+        err = zjump(tr, ZOP_JUMP, &done);
+        if (err != ZE_OK)
+            return err;
+        zpatch(tr, next, tr->zcode->length);
+        next = -1;
+        err = ztr_block(tr, &cursor);
+        if (err != ZE_OK)
+            return err;
+    }
+    zpatch(tr, next, tr->zcode->length);
+    zpatch(tr, done, tr->zcode->length);
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate a while block.
+ * 'entry' points to the loop condition.
+ */
+static ZError
+ztr_while(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    ZLoop loop;
+    ZError err;
+
+    loop.cond = tr->zcode->length;
+    loop.breaks = -1;
+    loop.depth = tr->depth;
+    loop.outer = tr->loop;
+    err = ztr_expr(tr, &cursor);
+    if (err != ZE_OK)
+        return err;
+    err = zjump(tr, ZOP_JUMPIFNOT, &loop.breaks);
+    if (err != ZE_OK)
+        return err;
+    zdepth(tr, -1);
+    tr->loop = &loop;
+    err = ztr_block(tr, &cursor);
+    tr->loop = loop.outer;
+    if (err != ZE_OK)
+        return err;
+    err = zemit(tr, ZOP_JUMP, NULL);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = (int) loop.cond;
+    zpatch(tr, loop.breaks, tr->zcode->length);
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate a for block.
+ * 'entry' points to the source of the loop, followed by its assignment.
+ * The state of the loop stays on the operand stack while the body runs.
+ */
+static ZError
+ztr_for(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    int call = (*cursor == CALLSTART);
+    ZLoop loop;
+    ZError err;
+
+    err = ztr_expr(tr, &cursor);
+    if (err != ZE_OK)
+        return err;
+    if (call  &&  zlast(tr)->n == 3)
+        /* Possibly range(), whose values need not be built. */
+        zlast(tr)->op = ZOP_RANGE;
+    else {
+        err = zemit(tr, ZOP_ITER, NULL);
+        if (err != ZE_OK)
+            return err;
+    }
+    zdepth(tr, FORSTATE - 1);
+    loop.cond = tr->zcode->length;
+    loop.breaks = -1;
+    loop.depth = tr->depth;
+    loop.outer = tr->loop;
+    err = zjump(tr, ZOP_NEXT, &loop.breaks);
+    if (err != ZE_OK)
+        return err;
+    zdepth(tr, 1);
+    err = ztr_assign(tr, &cursor);
+    if (err != ZE_OK)
+        return err;
+    tr->loop = &loop;
+    err = ztr_block(tr, &cursor);
+    tr->loop = loop.outer;
+    if (err != ZE_OK)
+        return err;
+    err = zemit(tr, ZOP_JUMP, NULL);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = (int) loop.cond;
+    zpatch(tr, loop.breaks, tr->zcode->length);
+    err = zemit(tr, ZOP_DROP, NULL);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = FORSTATE;
+    zdepth(tr, -FORSTATE);
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate a function definition into a new ZCode.
+ * 'entry' points to the function name.
+ * A generator function ('generator' nonzero) may yield.
+ */
+static ZError
+ztr_def(ZTrans *tr, char **entry, int generator)
+{
+    char *cursor = *entry;
+    char *name;
+    int arity = 0;
+    ZCode *body, *outer;
+    ZLoop *loop;
+    unsigned int depth;
+    int yields;
+    ZError err;
+
+    name = cursor;
+    cursor += strlen(cursor) + 1;
+    while (*cursor != '\0') {
+        arity++;
+        cursor += strlen(cursor) + 1;
+    }
+    cursor++;
+    err = zallocode(&body);
+    if (err != ZE_OK)
+        return err;
+    body->nslots = (unsigned char) *cursor;
+    cursor++;
+    body->self = (*cursor == NOSELF) ? -1 : (unsigned char) *cursor;
+    cursor++;
+    body->generator = generator;
+    body->next = tr->root->next;
+    tr->root->next = body;
+    /* Loops do not cross function boundaries. */
+    outer = tr->zcode;
+    loop = tr->loop;
+    depth = tr->depth;
+    yields = tr->generator;
+    tr->zcode = body;
+    tr->loop = NULL;
+    tr->depth = 0;
+    tr->generator = generator;
+    err = ztr_block(tr, &cursor);
+    if (err == ZE_OK)
+        err = zemit(tr, ZOP_END, NULL);
+    tr->zcode = outer;
+    tr->loop = loop;
+    tr->depth = depth;
+    tr->generator = yields;
+    if (err != ZE_OK)
+        return err;
+    err = zemit(tr, ZOP_DEF, NULL);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = arity;
+    zlast(tr)->s = name;
+    zlast(tr)->code = body;
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate a break ('kind' == BREAK) or continue ('kind' == CONTINUE)
+ *  statement that leaves 'lev' enclosing loops.
+ */
+static ZError
+ztr_leave(ZTrans *tr, char kind, char lev)
+{
+    ZLoop *loop = tr->loop;
+    ZError err;
+
+    for (; loop != NULL && lev > 0; lev--)
+        loop = loop->outer;
+    if (loop == NULL) {
+        /* Fail only if the statement is reached. */
+        err = zemit(tr, ZOP_ERROR, NULL);
+        if (err != ZE_OK)
+            return err;
+        if (kind == BREAK)
+            zlast(tr)->n = ZE_BREAK_WITHOUT_LOOP;
+        else
+            zlast(tr)->n = ZE_CONTINUE_WITHOUT_LOOP;
+        return ZE_OK;
+    }
+    if (tr->depth > loop->depth) {
+        /* Drop the state of the inner loops left. */
+        err = zemit(tr, ZOP_DROP, NULL);
+        if (err != ZE_OK)
+            return err;
+        zlast(tr)->n = (int) (tr->depth - loop->depth);
+    }
+    if (kind == BREAK)
+        return zjump(tr, ZOP_JUMP, &loop->breaks);
+    err = zemit(tr, ZOP_JUMP, NULL);
+    if (err != ZE_OK)
+        return err;
+    zlast(tr)->n = (int) loop->cond;
+    return ZE_OK;
+}
+
+/* Translate the block pointed by 'entry', up to its END. */
+static ZError
+ztr_block(ZTrans *tr, char **entry)
+{
+    char *cursor = *entry;
+    ZError err = ZE_OK;
+
+    while (*cursor != BLOCKEXIT  ||
+           *(cursor + 1) != END) {
+        if (*cursor == BLOCKEXIT) {
+            cursor++;
+            if (*cursor == BREAK ||
+                *cursor == CONTINUE) {
+                err = ztr_leave(tr, *cursor, *(cursor + 1));
+                cursor += 2;
+            }
+            else if (*cursor == RETURN) {
+                int call, list;
+
+                cursor++;
+                /* A generator is not resumed by its caller. */
+                call = (*cursor == CALLSTART)  &&  !tr->generator;
+                list = (*cursor == T_LIST)  &&  !tr->generator;
+                err = ztr_expr(tr, &cursor);
+                if (err != ZE_OK)
+                    return err;
+                if (call  &&  tr->zcode != tr->root)
+                    /* Calls returned by functions do not nest. */
+                    zlast(tr)->op = ZOP_TAILCALL;
+                else if (list  &&  tr->zcode != tr->root)
+                    /* The caller may take the items as they are. */
+                    zlast(tr)->op = ZOP_RETLIST;
+                else
+                    err = zemit(tr, ZOP_RETURN, NULL);
+                zdepth(tr, -1);
+            }
+        }
+        else if (*cursor == DELETE) {
+            cursor++;
+            err = zemit(tr, ZOP_DELETE, NULL);
+            if (err != ZE_OK)
+                return err;
+            zlast(tr)->s = cursor;
+            while (*cursor != '\0')
+                cursor += strlen(cursor) + 1;
+            cursor++;
+        }
+        else if (*cursor == YIELD) {
+            cursor++;
+            err = ztr_expr(tr, &cursor);
+            if (err != ZE_OK)
+                return err;
+            if (tr->generator)
+                err = zemit(tr, ZOP_YIELD, NULL);
+            else {
+                /* Fail only if the statement is reached. */
+                err = zemit(tr, ZOP_ERROR, NULL);
+                if (err == ZE_OK)
+                    zlast(tr)->n = ZE_YIELD_WITHOUT_GENERATOR;
+            }
+            zdepth(tr, -1);
+        }
+        else if (*cursor == BLOCK) {
+            char kind;
+
+            cursor++;
+            kind = *cursor;
+            cursor++;
+            (void) zreadword(&cursor); /* Skip block length. */
+            if (kind == IF)
+                err = ztr_if(tr, &cursor);
+            else if (kind == WHILE)
+                err = ztr_while(tr, &cursor);
+            else if (kind == FOR)
+                err = ztr_for(tr, &cursor);
+            else if (kind == DEF  ||  kind == GEN)
+                err = ztr_def(tr, &cursor, kind == GEN);
+        }
+        else
+            err = ztr_statement(tr, &cursor);
+        if (err != ZE_OK)
+            return err;
+    }
+    cursor += 2;
+    *entry = cursor;
+    return ZE_OK;
+}
+
+/* Translate the module bytecode pointed by 'entry' into 'zcode',
+ *  to be run in 'zcontext'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+znewcode(ZContext *zcontext, ZCode **zcode, char *entry)
+{
+    ZTrans tr;
+    ZError err;
+
+    err = zallocode(zcode);
+    if (err != ZE_OK)
+        return err;
+    tr.zcontext = zcontext;
+    tr.root = *zcode;
+    tr.zcode = *zcode;
+    tr.depth = 0;
+    tr.loop = NULL;
+    tr.generator = 0;
+    err = ztr_block(&tr, &entry);
+    if (err == ZE_OK)
+        err = zemit(&tr, ZOP_END, NULL);
+    if (err != ZE_OK)
+        zdelcode(zcode);
+    return err;
+}
+
+/* Translate the body of 'zhighfunc', defined by the reference engine,
+ *  into a ZCode owned by 'zcontext'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+ZError
+zbodycode(ZContext *zcontext, ZHighFunc *zhighfunc)
+{
+    ZCode *body;
+    ZTrans tr;
+    char *cursor = zhighfunc->func;
+    ZError err;
+
+    err = zallocode(&body);
+    if (err != ZE_OK)
+        return err;
+    body->nslots = zhighfunc->nslots;
+    body->self = zhighfunc->self;
+    body->generator = zhighfunc->generator;
+    /* Bodies of nested definitions are linked after this one. */
+    body->next = zcontext->bodies;
+    zcontext->bodies = body;
+    tr.zcontext = zcontext;
+    tr.root = body;
+    tr.zcode = body;
+    tr.depth = 0;
+    tr.loop = NULL;
+    tr.generator = zhighfunc->generator;
+    err = ztr_block(&tr, &cursor);
+    if (err == ZE_OK)
+        err = zemit(&tr, ZOP_END, NULL);
+    if (err != ZE_OK)
+        return err;
+    zhighfunc->code = body;
+    return ZE_OK;
+}
+
+/* Remove 'zcode' and all function bodies it owns from memory. */
+void
+zdelcode(ZCode **zcode)
+{
+    ZCode *a, *b;
+    unsigned int i;
+
+    a = *zcode;
+    while (a != NULL) {
+        b = a->next;
+        for (i = 0; i < a->length; i++)
+            zmfree(a->instrs[i].path);
+        zmfree(a->instrs);
+        zmfree(a);
+        a = b;
+    }
+    *zcode = NULL;
+}
+
+static ZError zexec(ZContext *zcontext,
+                    ZCode *zcode,
+                    ZGen *zgen,
+                    Zob **pret);
+
+/* Push a frame to 'zcontext' for a call to 'zhighfunc', found in 'self',
+ *  with the 'argc' arguments in 'argv'. The caller destructures the
+ *  result into 'want' names, or none if 'want' is zero.
+ * The body is translated, if it was defined by the reference engine.
+ * If no more calls can run, return ZE_CALL_TOO_DEEP.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zenter(ZContext *zcontext,
+       ZHighFunc *zhighfunc,
+       ZNameTable *self,
+       Zob **argv,
+       int argc,
+       unsigned int want)
+{
+    ZError err;
+
+    err = zcheckdepth(zcontext);
+    if (err != ZE_OK)
+        return err;
+    if (zhighfunc->code == NULL) {
+        err = zbodycode(zcontext, zhighfunc);
+        if (err != ZE_OK)
+            return err;
+    }
+    err = zpushframe(zcontext, zhighfunc->nslots);
+    if (err != ZE_OK)
+        return err;
+    zcontext->frame->want = want;
+    err = zbindargs(zcontext, zhighfunc, self, argv, argc);
+    if (err != ZE_OK) {
+        zdropframe(zcontext);
+        return err;
+    }
+    zcontext->depth++;
+    return ZE_OK;
+}
+
+/* Pop the frame of the call that is returning. */
+static void
+zleave(ZContext *zcontext)
+{
+    zdropframe(zcontext);
+    zcontext->depth--;
+}
+
+/* Save a caller at instruction 'pc' of 'zcode', whose values start at
+ *  'bottom' in the operand stack and whose last tail call was 'callee'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zpushcaller(ZContext *zcontext,
+            ZCode *zcode,
+            unsigned int pc,
+            unsigned int bottom,
+            Zob *callee)
+{
+    ZCaller *caller;
+
+    if (zcontext->ncallers == zcontext->callersize) {
+        unsigned int size = zcontext->callersize > 0 ?
+                            2 * zcontext->callersize : 16;
+
+        caller = (ZCaller *) zrealloc(zcontext->callers,
+                                      size * sizeof(ZCaller));
+        if (caller == NULL)
+            return ZE_OUT_OF_MEMORY;
+        zcontext->callers = caller;
+        zcontext->callersize = size;
+    }
+    caller = &zcontext->callers[zcontext->ncallers++];
+    caller->zcode = zcode;
+    caller->pc = pc;
+    caller->bottom = bottom;
+    caller->callee = callee;
+    return ZE_OK;
+}
+
+/* Call 'zfunc' with the 'argc' arguments in 'argv'.
+ * 'self' is the node where 'zfunc' was found.
+ * Calling a generator function returns a new generator.
+ * On success, 'ret' holds a new reference to the returned value.
+ */
+static ZError
+zcall(ZContext *zcontext,
+      ZFunc *zfunc,
+      ZNameTable *self,
+      Zob **argv,
+      int argc,
+      unsigned int want,
+      Zob **pret)
+{
+    ZError err;
+
+    if (argc != (int) zfunc->arity)
+        return ZE_ARITY_ERROR;
+    if (*zfunc->fimp) {
+        ZHighFunc *zhighfunc = (ZHighFunc *) zfunc->fimp;
+
+        if (zhighfunc->generator) {
+            err = znewgen(zcontext, zhighfunc, self, argv, argc,
+                          (ZGen **) pret);
+            if (err == ZE_OK)
+                zincrefc(*pret);
+            return err;
+        }
+        /* Call zap function. */
+        err = zenter(zcontext, zhighfunc, self, argv, argc, want);
+        if (err != ZE_OK)
+            return err;
+        err = zrun_code(zcontext, zhighfunc->code, pret);
+        zleave(zcontext);
+        return err;
+    }
+    else {
+        /* Call C function. */
+        err = zcall_low((ZLowFunc *) zfunc->fimp, argv, argc, pret);
+        /* The result may be one of the arguments. */
+        if (err == ZE_OK)
+            zincrefc(*pret);
+        return err;
+    }
+}
+
+/* Create in 'zlist' a new list of the 'count' values in 'items'.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return ZE_OK.
+ */
+static ZError
+zpacklist(Zob **items, int count, ZList **zlist)
+{
+    ZError err;
+    int i;
+
+    err = znewlist(zlist);
+    if (err != ZE_OK)
+        return err;
+    for (i = 0; i < count; i++) {
+        err = zlappend(*zlist, items[i]);
+        if (err != ZE_OK) {
+            zdellist(zlist);
+            return err;
+        }
+    }
+    return ZE_OK;
+}
+
+/* Return the global entry of the name in 'ip', or NULL if not defined.
+ * The entry is cached in 'ip' until a global name is added or removed.
+ */
+static ZEntry *
+zglobal(ZContext *zcontext, ZInstr *ip)
+{
+    ZNameTable *global = zcontext->global;
+
+    if (ip->entry == NULL  ||
+        ip->version != global->version) {
+        ip->entry = ztfindatom(global, ip->atom);
+        ip->version = global->version;
+    }
+    return ip->entry;
+}
+
+/* Find the value of the (possibly dotted) name in 'ip'.
+ * The first component is a local slot, if bound, or a global;
+ *  the others are walked through nodes.
+ * If found, copy the value to 'value', set 'self' as the last node
+ *  (ZNameTable) visited and return nonzero.
+ * Otherwise, return zero.
+ */
+static int
+zresolve(ZContext *zcontext, ZInstr *ip, ZNameTable **self, Zob **pvalue)
+{
+    Zob *head = NULL;
+
+    if (*ip->s == LOCAL)
+        head = LOCALHEAD(zcontext->frame, ip->s);
+    if (head == NULL) {
+        ZEntry *zentry = zglobal(zcontext, ip);
+
+        if (zentry == NULL)
+            return 0;
+        head = zentry->value;
+    }
+    *self = zcontext->global;
+    return zgetpath(head, ip->path, ip->npath, self, pvalue);
+}
+
+#if ZTHREADED
+#define ZCASE(op)   op##_handler:
+#define ZNEXT       goto *ip->label
+#define ZDISPATCH   ZNEXT;
+#define ZDISPATCHEND
+#else
+#define ZCASE(op)   case op:
+#define ZNEXT       goto dispatch
+#define ZDISPATCH   dispatch: switch (ip->op) {
+#define ZDISPATCHEND }
+#endif
+
+/* Push 'zob' to the operand stack. */
+#define ZPUSH(zob)  do { *sp = (Zob *) (zob); zincrefc(*sp); sp++; } while (0)
+
+/* Run 'zcode' in 'zcontext'.
+ * On success, 'ret' holds a new reference to the returned value.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by the code or ZE_OK.
+ */
+ZError
+zrun_code(ZContext *zcontext, ZCode *zcode, Zob **pret)
+{
+    return zexec(zcontext, zcode, NULL, pret);
+}
+
+/* Resume the body of 'zgen' in 'zcontext', whose current frame must be
+ *  the frame of 'zgen'.
+ * On success, 'ret' holds a new reference to the value yielded, or to
+ *  the value returned, and 'zgen' is left running only in the latter case.
+ * If there is not enough memory, return ZE_OUT_OF_MEMORY.
+ * Otherwise, return the error raised by the code or ZE_OK.
+ */
+ZError
+zrun_gen(ZContext *zcontext, ZGen *zgen, Zob **pret)
+{
+    return zexec(zcontext, zgen->code, zgen, pret);
+}
+
+/* Run 'zcode' in 'zcontext', from the start or, if 'zgen' is not NULL,
+ *  from where 'zgen' was suspended.
+ */
+static ZError
+zexec(ZContext *zcontext, ZCode *zcode, ZGen *zgen, Zob **pret)
+{
+#if ZTHREADED
+    /* Same order as the opcodes. */
+    static const void *labels[] = {
+        &&ZOP_NONE_handler, &&ZOP_BOOL_handler, &&ZOP_BYTE_handler,
+        &&ZOP_CONST_handler, &&ZOP_LIST_handler, &&ZOP_DICT_handler,
+        &&ZOP_NAME_handler, &&ZOP_CALL_handler, &&ZOP_POP_handler,
+        &&ZOP_SETNAME_handler, &&ZOP_ASSIGN_handler, &&ZOP_DELETE_handler,
+        &&ZOP_JUMP_handler, &&ZOP_JUMPIFNOT_handler, &&ZOP_DEF_handler,
+        &&ZOP_RETURN_handler, &&ZOP_ERROR_handler, &&ZOP_END_handler,
+        &&ZOP_LOCAL_handler, &&ZOP_SETLOCAL_handler, &&ZOP_TAILCALL_handler,
+        &&ZOP_UNPACK_handler, &&ZOP_RECEIVE_handler, &&ZOP_RETLIST_handler,
+        &&ZOP_ITER_handler, &&ZOP_RANGE_handler, &&ZOP_NEXT_handler,
+        &&ZOP_DROP_handler, &&ZOP_YIELD_handler, &&ZOP_YARR_handler
+    };
+#endif
+    ZInstr *ip;
+    Zob **sp, **base;
+    unsigned int bottom;
+    /* Callers below this mark belong to an outer run. */
+    unsigned int floor = zcontext->ncallers;
+    /* Callee of the last tail call of the running function, if any. */
+    Zob *callee = NULL;
+    Zob *ret;
+    ZCaller *caller;
+    ZError err;
+
+    bottom = zcontext->stacktop;
+
+enter:
+    /* Start 'zcode' with its values from 'bottom'. */
+#if ZTHREADED
+    if (!zcode->threaded) {
+        unsigned int i;
+
+        for (i = 0; i < zcode->length; i++)
+            zcode->instrs[i].label = labels[zcode->instrs[i].op];
+        zcode->threaded = 1;
+    }
+#endif
+    err = zreserve(zcontext, bottom + zcode->maxstack);
+    base = zcontext->stack + bottom;
+    sp = base;
+    if (err != ZE_OK)
+        goto fail;
+    ip = zcode->instrs;
+    if (zgen != NULL  &&  zcontext->ncallers == floor) {
+        /* Restore the loops the body was suspended in. */
+        memcpy(base, zgen->stack, zgen->depth * sizeof(Zob *));
+        sp = base + zgen->depth;
+        zgen->depth = 0;
+        ip += zgen->resume;
+    }
+
+    ZDISPATCH
+
+    ZCASE(ZOP_NONE)
+    {
+        *sp++ = ZNONE;
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_BOOL)
+    {
+        *sp++ = ZBOOL(ip->n);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_BYTE)
+    {
+        *sp++ = ZBYTE(ip->n);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_CONST)
+    {
+        ZPUSH(ip->zob);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_YARR)
+    {
+        ZByteArray *zbytearray;
+
+        /* The bytes of the constant are copied on the first change. */
+        err = zshareyarr((ZByteArray *) ip->zob, &zbytearray);
+        if (err != ZE_OK)
+            goto fail;
+        ZPUSH(zbytearray);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_LIST)
+    {
+        ZList *zlist;
+        Zob **item;
+
+        err = zpacklist(sp - ip->n, ip->n, &zlist);
+        if (err != ZE_OK)
+            goto fail;
+        for (item = sp - ip->n; sp > item; )
+            zdecrefc(*--sp);
+        ZPUSH(zlist);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_DICT)
+    {
+        ZDict *zdict;
+        Zob **item;
+
+        err = znewdict(&zdict);
+        if (err != ZE_OK)
+            goto fail;
+        for (item = sp - 2 * ip->n; item < sp; item += 2) {
+            err = zdset(zdict, *item, *(item + 1));
+            if (err != ZE_OK) {
+                zdeldict(&zdict);
+                goto fail;
+            }
+        }
+        for (item = sp - 2 * ip->n; sp > item; )
+            zdecrefc(*--sp);
+        ZPUSH(zdict);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_NAME)
+    {
+        Zob *zob;
+        ZNameTable *self;
+        int found;
+
+        found = zresolve(zcontext, ip, &self, &zob);
+        if (!found) {
+            err = ZE_NAME_NOT_DEFINED;
+            goto fail;
+        }
+        ZPUSH(zob);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_LOCAL)
+    {
+        Zob *zob = zcontext->frame->slots[ip->n];
+
+        if (zob == NULL) {
+            /* An unbound local may still name a global. */
+            ZEntry *zentry = zglobal(zcontext, ip);
+
+            if (zentry == NULL) {
+                err = ZE_NAME_NOT_DEFINED;
+                goto fail;
+            }
+            zob = zentry->value;
+        }
+        ZPUSH(zob);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_CALL)
+    {
+        Zob *zfunc;
+        ZHighFunc *zhighfunc;
+        ZNameTable *self;
+        int argc = ip->n;
+        /* Names the result is destructured into, if any. */
+        unsigned int want = (ip + 1)->op == ZOP_RECEIVE ? (ip + 1)->n : 0;
+
+        if (zresolve(zcontext, ip, &self, &zfunc) == 0) {
+            err = ZE_FUNCTION_NAME_NOT_DEFINED;
+            goto fail;
+        }
+        zcontext->stacktop = (unsigned int) (sp - zcontext->stack);
+        zhighfunc = (ZHighFunc *) ((ZFunc *) zfunc)->fimp;
+        if (!*((ZFunc *) zfunc)->fimp  ||
+            zhighfunc->generator  ||
+            argc != (int) ((ZFunc *) zfunc)->arity) {
+            /* Let zcall() make the generator or call the C function. */
+            err = zcall(zcontext, (ZFunc *) zfunc, self, sp - argc, argc,
+                        want, &ret);
+            if (err != ZE_OK) {
+                /* A generator resumed by the C function may have moved
+                 *  the stack.
+                 */
+                base = zcontext->stack + bottom;
+                sp = zcontext->stack + zcontext->stacktop;
+                goto fail;
+            }
+            goto returned;
+        }
+        /* Save this function and run the callee in its place. */
+        err = zpushcaller(zcontext, zcode, (unsigned int) (ip - zcode->instrs),
+                          bottom, callee);
+        if (err != ZE_OK)
+            goto fail;
+        err = zenter(zcontext, zhighfunc, self, sp - argc, argc, want);
+        if (err != ZE_OK) {
+            zcontext->ncallers--;
+            goto fail;
+        }
+        zcode = zhighfunc->code;
+        bottom = zcontext->stacktop;
+        callee = NULL;
+        goto enter;
+    }
+
+    ZCASE(ZOP_TAILCALL)
+    {
+        Zob *zfunc;
+        ZHighFunc *zhighfunc;
+        ZNameTable *self;
+        int argc = ip->n;
+
+        if (zresolve(zcontext, ip, &self, &zfunc) == 0) {
+            err = ZE_FUNCTION_NAME_NOT_DEFINED;
+            goto fail;
+        }
+        zcontext->stacktop = (unsigned int) (sp - zcontext->stack);
+        zhighfunc = (ZHighFunc *) ((ZFunc *) zfunc)->fimp;
+        if (!*((ZFunc *) zfunc)->fimp  ||  zhighfunc->generator) {
+            /* A C function or a generator does not nest:
+             *  call it and return.
+             */
+            err = zcall(zcontext, (ZFunc *) zfunc, self, sp - argc, argc, 0,
+                        &ret);
+            base = zcontext->stack + bottom;
+            sp = zcontext->stack + zcontext->stacktop;
+            if (err != ZE_OK)
+                goto fail;
+            while (sp > base)
+                zdecrefc(*--sp);
+            zcontext->stacktop = bottom;
+            goto done;
+        }
+        if (zhighfunc->code == NULL) {
+            /* Defined by the reference engine. */
+            err = zbodycode(zcontext, zhighfunc);
+            if (err != ZE_OK)
+                goto fail;
+        }
+        /* Rebind this frame and run the callee in place of this function. */
+        zincrefc(zfunc);
+        err = zreframe(zcontext, (ZFunc *) zfunc, self, argc);
+        sp = zcontext->stack + zcontext->stacktop;
+        if (err != ZE_OK) {
+            zdecrefc(zfunc);
+            goto fail;
+        }
+        while (sp > base)
+            zdecrefc(*--sp);
+        zcontext->stacktop = bottom;
+        if (callee != NULL)
+            zdecrefc(callee);
+        callee = zfunc;
+        zcode = zhighfunc->code;
+        /* Tail calls may loop without ending a statement. */
+        zautocollect();
+        goto enter;
+    }
+
+    ZCASE(ZOP_ITER)
+    {
+        Zob *source = *--sp;
+
+        err = zforstart(source, sp);
+        zdecrefc(source);
+        if (err != ZE_OK)
+            goto fail;
+        sp += FORSTATE;
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_RANGE)
+    {
+        Zob *zfunc, *source;
+        Zob *state[FORSTATE];
+        ZNameTable *self;
+        int argc = ip->n, i;
+
+        if (zresolve(zcontext, ip, &self, &zfunc) == 0) {
+            err = ZE_FUNCTION_NAME_NOT_DEFINED;
+            goto fail;
+        }
+        if (zisrange(zfunc))
+            /* Count the values instead of building them. */
+            err = zforrange(sp - argc, state);
+        else {
+            zcontext->stacktop = (unsigned int) (sp - zcontext->stack);
+            err = zcall(zcontext, (ZFunc *) zfunc, self, sp - argc, argc, 0,
+                        &source);
+            base = zcontext->stack + bottom;
+            sp = zcontext->stack + zcontext->stacktop;
+            if (err == ZE_OK) {
+                err = zforstart(source, state);
+                zdecrefc(source);
+            }
+        }
+        if (err != ZE_OK)
+            goto fail;
+        for (; argc > 0; argc--)
+            zdecrefc(*--sp);
+        for (i = 0; i < FORSTATE; i++)
+            *sp++ = state[i];
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_NEXT)
+    {
+        Zob *item;
+
+        /* Resuming a generator may move the stack. */
+        zcontext->stacktop = (unsigned int) (sp - zcontext->stack);
+        err = zfornext(sp - FORSTATE, &item);
+        base = zcontext->stack + bottom;
+        sp = zcontext->stack + zcontext->stacktop;
+        if (err != ZE_OK)
+            goto fail;
+        if (item == NULL)
+            ip = zcode->instrs + ip->n;
+        else {
+            /* 'item' is already referenced by zfornext(). */
+            *sp++ = item;
+            ip++;
+        }
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_DROP)
+    {
+        Zob **item = sp - ip->n;
+
+        while (sp > item)
+            zdecrefc(*--sp);
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_POP)
+    {
+        zdecrefc(*--sp);
+        /* Statements end here or at an assignment: safe points,
+         *  as between statements of the reference engine.
+         */
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_SETNAME)
+    {
+        if (ip->path == NULL  &&  *ip->s == LOCAL)
+            /* A local name past the frame slots. */
+            err = zsetspilled(zcontext->frame, ip->s + 2, *(sp - 1));
+        else if (ip->path == NULL) {
+            ZEntry *zentry = zglobal(zcontext, ip);
+
+            if (zentry != NULL) {
+                /* Rebind in place; the entry stays valid. */
+                zincrefc(*(sp - 1));
+                zdecrefc(zentry->value);
+                zentry->value = *(sp - 1);
+                err = ZE_OK;
+            }
+            else
+                err = ztsetatom(zcontext->global, ip->atom, *(sp - 1));
+        }
+        else {
+            /* Dotted name: the nodes in the way must exist. */
+            Zob *head = NULL;
+
+            if (*ip->s == LOCAL)
+                head = LOCALHEAD(zcontext->frame, ip->s);
+            else {
+                ZEntry *zentry = zglobal(zcontext, ip);
+
+                if (zentry != NULL)
+                    head = zentry->value;
+            }
+            if (head == NULL)
+                err = ZE_NAME_NOT_DEFINED;
+            else
+                err = zsetpath(head, ip->path, ip->npath, *(sp - 1));
+        }
+        if (err != ZE_OK)
+            goto fail;
+        zdecrefc(*--sp);
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_SETLOCAL)
+    {
+        zsetslot(zcontext->frame, ip->n, *(sp - 1));
+        zdecrefc(*--sp);
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_ASSIGN)
+    {
+        char *cursor = ip->s;
+
+        err = zassign(zcontext, *(sp - 1), &cursor);
+        if (err != ZE_OK)
+            goto fail;
+        zdecrefc(*--sp);
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_UNPACK)
+    {
+        Zob **item = sp - ip->n;
+
+        /* The items of a list literal, in the order of the names. */
+        err = zbindpattern(zcontext, ip->s, item);
+        if (err != ZE_OK)
+            goto fail;
+        while (sp > item)
+            zdecrefc(*--sp);
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_RECEIVE)
+    {
+        Zob **item = sp - ip->n;
+
+        if (zcontext->nret > 0) {
+            /* The callee left one item per name. */
+            zcontext->nret = 0;
+            err = zbindpattern(zcontext, ip->s, item);
+        }
+        else {
+            /* The callee returned a single value. */
+            char *cursor = ip->s;
+
+            item = sp - 1;
+            err = zassign(zcontext, *item, &cursor);
+        }
+        if (err != ZE_OK)
+            goto fail;
+        while (sp > item)
+            zdecrefc(*--sp);
+        zautocollect();
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_DELETE)
+    {
+        char *cursor = ip->s;
+
+        while (*cursor != '\0') {
+            if (zremincontext(zcontext, cursor) == 0) {
+                err = ZE_NAME_NOT_DEFINED;
+                goto fail;
+            }
+            cursor += strlen(cursor) + 1;
+        }
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_JUMP)
+    {
+        /* Everything live is on the stack: a safe point. */
+        zautocollect();
+        ip = zcode->instrs + ip->n;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_JUMPIFNOT)
+    {
+        int truth;
+
+        sp--;
+        truth = ztstobj(*sp);
+        zdecrefc(*sp);
+        if (truth)
+            ip++;
+        else
+            ip = zcode->instrs + ip->n;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_DEF)
+    {
+        /* Function definition. */
+        ZFunc *zfunc;
+        ZHighFunc *zhighfunc;
+
+        err = znewhighfunc(&zhighfunc);
+        if (err != ZE_OK)
+            goto fail;
+        zhighfunc->nslots = ip->code->nslots;
+        zhighfunc->self = ip->code->self;
+        zhighfunc->generator = ip->code->generator;
+        zhighfunc->code = ip->code;
+        err = znewfunc(&zfunc, (FImp *) zhighfunc, (unsigned char) ip->n);
+        if (err != ZE_OK) {
+            zdelhighfunc(&zhighfunc);
+            goto fail;
+        }
+        err = zsetincontext(zcontext, ip->s, (Zob *) zfunc);
+        if (err != ZE_OK)
+            goto fail;
+        ip++;
+        ZNEXT;
+    }
+
+    ZCASE(ZOP_RETURN)
+    {
+        /* The reference on the stack is handed to the caller.
+         * Loops may have left their state below it.
+         */
+        ret = *--sp;
+        while (sp > base)
+            zdecrefc(*--sp);
+        zcontext->stacktop = bottom;
+        goto done;
+    }
+
+    ZCASE(ZOP_RETLIST)
+    {
+        ZList *zlist;
+        Zob **item;
+
+        if (ip->n > 0  &&  zcontext->frame->want == (unsigned int) ip->n) {
+            /* Hand the items to the caller, which takes them as names.
+             * Loops may have left their state below them.
+             */
+            for (item = base; item < sp - ip->n; item++)
+                zdecrefc(*item);
+            memmove(base, sp - ip->n, ip->n * sizeof(Zob *));
+            zcontext->nret = (unsigned int) ip->n;
+            zcontext->stacktop = bottom + (unsigned int) ip->n;
+            ret = NULL;
+            goto done;
+        }
+        err = zpacklist(sp - ip->n, ip->n, &zlist);
+        if (err != ZE_OK)
+            goto fail;
+        while (sp > base)
+            zdecrefc(*--sp);
+        zincrefc((Zob *) zlist);
+        zcontext->stacktop = bottom;
+        ret = (Zob *) zlist;
+        goto done;
+    }
+
+    ZCASE(ZOP_YIELD)
+    {
+        /* Keep the loops below the value until the body is resumed.
+         * The reference on the stack is handed to the caller.
+         */
+        if (zgen == NULL) {
+            err = ZE_YIELD_WITHOUT_GENERATOR;
+            goto fail;
+        }
+        *pret = *--sp;
+        zgen->depth = (unsigned int) (sp - base);
+        memcpy(zgen->stack, base, zgen->depth * sizeof(Zob *));
+        zgen->resume = (unsigned int) (ip + 1 - zcode->instrs);
+        zgen->running = 0;
+        zcontext->stacktop = bottom;
+        return ZE_OK;
+    }
+
+    ZCASE(ZOP_ERROR)
+    {
+        err = (ZError) ip->n;
+        goto fail;
+    }
+
+    ZCASE(ZOP_END)
+    {
+        zcontext->stacktop = bottom;
+        ret = ZNONE;
+        goto done;
+    }
+
+    ZDISPATCHEND
+
+done:
+    /* The running function returned 'ret', or left its items above
+     *  'bottom' if 'ret' is NULL.
+     */
+    if (callee != NULL)
+        zdecrefc(callee);
+    if (zcontext->ncallers == floor) {
+        *pret = ret;
+        return ZE_OK;
+    }
+    /* Resume its caller. */
+    zleave(zcontext);
+    caller = &zcontext->callers[--zcontext->ncallers];
+    zcode = caller->zcode;
+    ip = zcode->instrs + caller->pc;
+    bottom = caller->bottom;
+    callee = caller->callee;
+
+returned:
+    /* The call at 'ip' is done, as described for 'ret' above.
+     * The stack may have been moved by the callee.
+     */
+    base = zcontext->stack + bottom;
+    sp = zcontext->stack + zcontext->stacktop;
+    if (ret == NULL) {
+        /* The callee left its items above the arguments. */
+        Zob **items = sp - zcontext->nret, **args = items - ip->n;
+        Zob **arg;
+
+        for (arg = args; arg < items; arg++)
+            zdecrefc(*arg);
+        memmove(args, items, zcontext->nret * sizeof(Zob *));
+        sp = args + zcontext->nret;
+    }
+    else {
+        Zob **args = sp - ip->n;
+
+        while (sp > args)
+            zdecrefc(*--sp);
+        /* 'ret' is already referenced. */
+        *sp++ = ret;
+    }
+    ip++;
+    ZNEXT;
+
+fail:
+    for (;;) {
+        while (sp > base)
+            zdecrefc(*--sp);
+        zcontext->stacktop = bottom;
+        if (callee != NULL)
+            zdecrefc(callee);
+        if (zcontext->ncallers == floor)
+            return err;
+        /* Unwind the callers of this run as well. */
+        zleave(zcontext);
+        caller = &zcontext->callers[--zcontext->ncallers];
+        sp = base;
+        bottom = caller->bottom;
+        base = zcontext->stack + bottom;
+        callee = caller->callee;
+    }
+}